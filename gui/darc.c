@@ -19,15 +19,26 @@
 
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 #ifdef HAVE_LV2_1_18_6
 #include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+#include <lv2/atom/util.h>
 #include <lv2/options/options.h>
 #else
 #include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
 #include <lv2/lv2plug.in/ns/ext/options/options.h>
 #endif
 
@@ -45,11 +56,32 @@
 #define MIN(A, B) ((A) < (B)) ? (A) : (B)
 #endif
 
+#define M1RECT 350
+
+#define HIST_COLS 150     // gain history, number of columns
+#define HIST_MS 200       // gain history, time per column
+#define HIST_SCROLL_MAX 4 // columns per update to scroll, re-render if more
+
+#define STREAM_TIMEOUT 4 // DARC_RMS updates without DARC__meters, until the stream is considered lost
+
 typedef struct {
 	LV2UI_Write_Function write;
 	LV2UI_Controller     controller;
 	LV2UI_Touch*         touch;
 
+	/* meter stream */
+	LV2_URID_Map*  map;
+	LV2_Atom_Forge forge;
+	LV2_URID       atom_eventTransfer;
+	LV2_URID       darc_ui_on;
+	LV2_URID       darc_ui_off;
+	LV2_URID       darc_meters;
+	LV2_URID       darc_frames;
+	uint32_t       port_control;
+	uint32_t       port_notify;
+	bool           stream;      // meters are received via port_notify
+	uint32_t       stream_idle; // meter port updates since the last DARC__meters
+
 	PangoFontDescription* font[2];
 
 	RobWidget* rw;   // top-level container
@@ -63,11 +95,20 @@ typedef struct {
 	/* Gain Mapping */
 	RobWidget* m1;
 
+	/* Gain history */
+	RobWidget* m3;
+	RobWidget* hbox;
+
 	/* current gain */
 	float _gmin;
 	float _gmax;
 	float _rms;
 
+	/* meter positions of the last expose, to invalidate only changed areas */
+	float m0_bar[2]; // x-range of the gain bar
+	float m1_pkx;    // x-position of the level indicator, unscaled
+	float m1_pky[2]; // y-range of the level indicator, unscaled
+
 	/* control knobs */
 	RobTkDial* spn_ctrl[5];
 	RobTkLbl*  lbl_ctrl[5];
@@ -87,6 +128,32 @@ typedef struct {
 
 	bool ctrl_dirty; // update m1_ctrl, m1_mask
 
+	/* transfer curve, y-position for every x-pixel */
+	float    m1_curve[M1RECT + 1];
+	float    m1_hcurve[M1RECT + 1]; // with hold
+	uint32_t m1_hold_x;             // first x above threshold
+	float    m1_thrsh;
+	float    m1_ratio;
+	bool     m1_hold;
+	bool     m1_valid; // m1_ctrl and m1_mask match the curve
+
+	/* gain history, the surface is allocated once for the largest
+	 * scale, and scrolled by one column for every new value */
+	cairo_surface_t* m3_sf;
+	uint32_t         m3_bg[2 * M1RECT]; // background of a column
+	int              m3_cw;             // column width in pixel
+	int              m3_h;              // height in pixel
+	float            hist_min[HIST_COLS];
+	float            hist_max[HIST_COLS];
+	uint32_t         hist_pos; // next column to write
+	uint32_t         hist_len; // number of valid columns
+	float            hist_ms;  // time collected in the current column
+	float            hist_cmin;
+	float            hist_cmax;
+	double           hist_time; // of the last meter port update, sec; 0: none
+	float            hist_pmin; // meter port values of the last update
+	float            hist_pmax;
+
 	/* tooltips */
 	int                tt_id;
 	int                tt_timeout;
@@ -99,6 +166,16 @@ typedef struct {
 	const char* nfo;
 } darcUI;
 
+/* pre-rendered surfaces, shared by all instances */
+enum {
+	ART_DIAL = 0, // knob faceplates 0..4
+	ART_M0BG = 5,
+	ART_M1GRID,
+};
+
+static cairo_surface_t* art_ref (darcUI* ui, int id, int w, int h, bool light);
+static void             art_unref (cairo_surface_t* sf);
+
 /* ****************************************************************************
  * Control knob ranges and value mapping
  */
@@ -194,22 +271,11 @@ static float c_dlf[4] = { 0.8, 0.8, 0.8, 1.0 };
  */
 
 static void
-prepare_faceplates (darcUI* ui)
+render_faceplate (darcUI* ui, cairo_t* cr, int knob)
 {
-	cairo_t* cr;
-	float    xlp, ylp;
+	float xlp, ylp;
 
 /* clang-format off */
-#define INIT_DIAL_SF(VAR, W, H)                                             \
-  VAR = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 2 * (W), 2 * (H)); \
-  cr  = cairo_create (VAR);                                                 \
-  cairo_scale (cr, 2.0, 2.0);                                               \
-  CairoSetSouerceRGBA (c_trs);                                              \
-  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);                           \
-  cairo_rectangle (cr, 0, 0, W, H);                                         \
-  cairo_fill (cr);                                                          \
-  cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
-
 #define DIALDOTS(V, XADD, YADD)                                \
   float ang = (-.75 * M_PI) + (1.5 * M_PI) * (V);              \
   xlp       = GED_CX + XADD + sinf (ang) * (GED_RADIUS + 3.0); \
@@ -229,73 +295,77 @@ prepare_faceplates (darcUI* ui)
   }
 	/* clang-format on */
 
-	INIT_DIAL_SF (ui->dial_bg[0], GED_WIDTH + 8, GED_HEIGHT + 20);
-	RESPLABLEL (0.00);
-	write_text_full (cr, "-10", ui->font[0], xlp + 6, ylp, 0, 1, c_dlf);
-	RESPLABLEL (0.25);
-	RESPLABLEL (0.5);
-	write_text_full (cr, "+10", ui->font[0], xlp - 2, ylp, 0, 2, c_dlf);
-	RESPLABLEL (.75);
-	RESPLABLEL (1.0);
-	write_text_full (cr, "+30", ui->font[0], xlp - 6, ylp, 0, 3, c_dlf);
-	cairo_destroy (cr);
-
-	INIT_DIAL_SF (ui->dial_bg[1], GED_WIDTH + 8, GED_HEIGHT + 20);
-	RESPLABLEL (0.00);
-	write_text_full (cr, "-50", ui->font[0], xlp + 6, ylp, 0, 1, c_dlf);
-	RESPLABLEL (0.25);
-	RESPLABLEL (0.5);
-	write_text_full (cr, "-30", ui->font[0], xlp - 2, ylp, 0, 2, c_dlf);
-	RESPLABLEL (.75);
-	RESPLABLEL (1.0);
-	write_text_full (cr, "-10", ui->font[0], xlp - 6, ylp, 0, 3, c_dlf);
-	cairo_destroy (cr);
-
-	INIT_DIAL_SF (ui->dial_bg[2], GED_WIDTH + 8, GED_HEIGHT + 20);
-	RESPLABLEL (0.00);
-	write_text_full (cr, "1", ui->font[0], xlp + 4, ylp, 0, 1, c_dlf);
-	RESPLABLEL (.25);
-	write_text_full (cr, "2", ui->font[0], xlp + 3, ylp, 0, 1, c_dlf);
-	RESPLABLEL (.44);
-	write_text_full (cr, "3", ui->font[0], xlp + 1, ylp, 0, 1, c_dlf);
-	RESPLABLEL (.64)
-	write_text_full (cr, "5", ui->font[0], xlp + 4, ylp, 0, 1, c_dlf);
-	RESPLABLEL (.81)
-	write_text_full (cr, "10", ui->font[0], xlp + 6, ylp, 0, 1, c_dlf);
-	RESPLABLEL (1.0);
-	write_text_full (cr, "Lim", ui->font[0], xlp - 9, ylp, 0, 3, c_dlf);
-	cairo_destroy (cr);
-
-	INIT_DIAL_SF (ui->dial_bg[3], GED_WIDTH + 8, GED_HEIGHT + 20);
-	RESPLABLEL (0.00);
-	write_text_full (cr, "1ms", ui->font[0], xlp + 9, ylp, 0, 1, c_dlf);
-	RESPLABLEL (.16);
-	RESPLABLEL (.33);
-	write_text_full (cr, "5", ui->font[0], xlp - 1, ylp, 0, 2, c_dlf);
-	RESPLABLEL (0.5);
-	RESPLABLEL (.66);
-	write_text_full (cr, "20", ui->font[0], xlp + 3, ylp, 0, 2, c_dlf);
-	RESPLABLEL (.83);
-	RESPLABLEL (1.0);
-	write_text_full (cr, "100", ui->font[0], xlp - 9, ylp, 0, 3, c_dlf);
-	cairo_destroy (cr);
+	cairo_scale (cr, 2.0, 2.0);
+	CairoSetSouerceRGBA (c_trs);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_rectangle (cr, 0, 0, GED_WIDTH + 8, GED_HEIGHT + 20);
+	cairo_fill (cr);
+	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
 
-	INIT_DIAL_SF (ui->dial_bg[4], GED_WIDTH + 8, GED_HEIGHT + 20);
-	RESPLABLEL (0.00);
-	write_text_full (cr, "30ms", ui->font[0], xlp + 9, ylp, 0, 1, c_dlf);
-	RESPLABLEL (.16);
-	RESPLABLEL (.33);
-	write_text_full (cr, "150", ui->font[0], xlp - 5, ylp, 0, 2, c_dlf);
-	RESPLABLEL (0.5);
-	RESPLABLEL (.66);
-	write_text_full (cr, "600", ui->font[0], xlp + 5, ylp, 0, 2, c_dlf);
-	RESPLABLEL (.83);
-	RESPLABLEL (1.0);
-	write_text_full (cr, "3s", ui->font[0], xlp - 6, ylp, 0, 3, c_dlf);
-	cairo_destroy (cr);
+	switch (knob) {
+		case 0:
+			RESPLABLEL (0.00);
+			write_text_full (cr, "-10", ui->font[0], xlp + 6, ylp, 0, 1, c_dlf);
+			RESPLABLEL (0.25);
+			RESPLABLEL (0.5);
+			write_text_full (cr, "+10", ui->font[0], xlp - 2, ylp, 0, 2, c_dlf);
+			RESPLABLEL (.75);
+			RESPLABLEL (1.0);
+			write_text_full (cr, "+30", ui->font[0], xlp - 6, ylp, 0, 3, c_dlf);
+			break;
+		case 1:
+			RESPLABLEL (0.00);
+			write_text_full (cr, "-50", ui->font[0], xlp + 6, ylp, 0, 1, c_dlf);
+			RESPLABLEL (0.25);
+			RESPLABLEL (0.5);
+			write_text_full (cr, "-30", ui->font[0], xlp - 2, ylp, 0, 2, c_dlf);
+			RESPLABLEL (.75);
+			RESPLABLEL (1.0);
+			write_text_full (cr, "-10", ui->font[0], xlp - 6, ylp, 0, 3, c_dlf);
+			break;
+		case 2:
+			RESPLABLEL (0.00);
+			write_text_full (cr, "1", ui->font[0], xlp + 4, ylp, 0, 1, c_dlf);
+			RESPLABLEL (.25);
+			write_text_full (cr, "2", ui->font[0], xlp + 3, ylp, 0, 1, c_dlf);
+			RESPLABLEL (.44);
+			write_text_full (cr, "3", ui->font[0], xlp + 1, ylp, 0, 1, c_dlf);
+			RESPLABLEL (.64)
+			write_text_full (cr, "5", ui->font[0], xlp + 4, ylp, 0, 1, c_dlf);
+			RESPLABLEL (.81)
+			write_text_full (cr, "10", ui->font[0], xlp + 6, ylp, 0, 1, c_dlf);
+			RESPLABLEL (1.0);
+			write_text_full (cr, "Lim", ui->font[0], xlp - 9, ylp, 0, 3, c_dlf);
+			break;
+		case 3:
+			RESPLABLEL (0.00);
+			write_text_full (cr, "1ms", ui->font[0], xlp + 9, ylp, 0, 1, c_dlf);
+			RESPLABLEL (.16);
+			RESPLABLEL (.33);
+			write_text_full (cr, "5", ui->font[0], xlp - 1, ylp, 0, 2, c_dlf);
+			RESPLABLEL (0.5);
+			RESPLABLEL (.66);
+			write_text_full (cr, "20", ui->font[0], xlp + 3, ylp, 0, 2, c_dlf);
+			RESPLABLEL (.83);
+			RESPLABLEL (1.0);
+			write_text_full (cr, "100", ui->font[0], xlp - 9, ylp, 0, 3, c_dlf);
+			break;
+		case 4:
+			RESPLABLEL (0.00);
+			write_text_full (cr, "30ms", ui->font[0], xlp + 9, ylp, 0, 1, c_dlf);
+			RESPLABLEL (.16);
+			RESPLABLEL (.33);
+			write_text_full (cr, "150", ui->font[0], xlp - 5, ylp, 0, 2, c_dlf);
+			RESPLABLEL (0.5);
+			RESPLABLEL (.66);
+			write_text_full (cr, "600", ui->font[0], xlp + 5, ylp, 0, 2, c_dlf);
+			RESPLABLEL (.83);
+			RESPLABLEL (1.0);
+			write_text_full (cr, "3s", ui->font[0], xlp - 6, ylp, 0, 3, c_dlf);
+			break;
+	}
 
 #undef DIALDOTS
-#undef INIT_DIAL_SF
 #undef RESPLABLEL
 }
 
@@ -550,9 +620,7 @@ m0_size_allocate (RobWidget* handle, int w, int h)
 	if (ui->m_bg) {
 		cairo_pattern_destroy (ui->m_bg);
 	}
-	if (ui->m0bg) {
-		cairo_surface_destroy (ui->m0bg);
-	}
+	art_unref (ui->m0bg);
 	ui->m_fg = NULL;
 	ui->m_bg = NULL;
 	ui->m0bg = NULL;
@@ -680,10 +748,7 @@ m0_expose_event (RobWidget* handle, cairo_t* cr, cairo_rectangle_t* ev)
 	}
 
 	if (!ui->m0bg) {
-		ui->m0bg     = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, ui->m0_width, ui->m0_height);
-		cairo_t* icr = cairo_create (ui->m0bg);
-		m0_render_faceplate (ui, icr);
-		cairo_destroy (icr);
+		ui->m0bg = art_ref (ui, ART_M0BG, ui->m0_width, ui->m0_height, is_light_theme ());
 	}
 
 	cairo_set_source_surface (cr, ui->m0bg, 0, 0);
@@ -696,29 +761,93 @@ m0_expose_event (RobWidget* handle, cairo_t* cr, cairo_rectangle_t* ev)
 	cairo_set_source (cr, ui->m_fg);
 	cairo_fill (cr);
 
+	ui->m0_bar[0] = 7.5 + v0;
+	ui->m0_bar[1] = 12.5 + v1;
+
 	return TRUE;
 }
 
+/* invalidate the area of the displayed and the new gain bar */
+static void
+m0_queue_meter (darcUI* ui)
+{
+	if (ui->m0_width <= 20 || ui->m0_bar[1] <= ui->m0_bar[0]) {
+		queue_draw (ui->m0);
+		return;
+	}
+
+	const uint32_t yscale = ui->m0_height / M0HEIGHT;
+	const uint32_t top    = (ui->m0_height - M0HEIGHT * yscale) * .5;
+	const uint32_t disp_w = ui->m0_width - 20;
+
+	float d0 = (20.f + ui->_gmin) / 60.f;
+	float d1 = (20.f + ui->_gmax) / 60.f;
+	d0       = d0 < 0 ? 0 : (d0 > 1 ? 1 : d0);
+	d1       = d1 < 0 ? 0 : (d1 > 1 ? 1 : d1);
+
+	float x0 = 7.5 + rint (disp_w * d0) - .5;
+	float x1 = 12.5 + rint (disp_w * d1) - .5;
+
+	if (x0 == ui->m0_bar[0] && x1 == ui->m0_bar[1]) {
+		/* no visible change */
+		return;
+	}
+
+	x0 = fminf (x0, ui->m0_bar[0]);
+	x1 = fmaxf (x1, ui->m0_bar[1]);
+
+	queue_draw_area (ui->m0, floorf (x0) - 1, top + 4 * yscale - 1,
+	                 ceilf (x1) - floorf (x0) + 2, 12 * yscale + 2);
+}
+
 /* ****************************************************************************/
 
-static float
-comp_curve (float in, float threshold, float ratio, bool hold)
+/* x-axis of the transfer curve: input level in dB and 10^(1 + .1 * dB),
+ * which does not depend on any parameter. Shared by all instances,
+ * initialized once. */
+static float          m1_x_db[M1RECT + 1];
+static float          m1_x_pw[M1RECT + 1];
+static pthread_once_t m1_x_once = PTHREAD_ONCE_INIT;
+
+static void
+m1_init_axis (void)
 {
-	float key = in;
-	if (hold && in < threshold) {
-		key = threshold;
+	for (uint32_t x = 0; x <= M1RECT; ++x) {
+		m1_x_db[x] = 70.f * (-1.f + x / (float)M1RECT) + 10.f;
+		m1_x_pw[x] = powf (10.f, 1.f + .1f * m1_x_db[x]);
 	}
-#ifdef __USE_GNU
-	float g = logf (exp10f (1.f + .1f * threshold) + exp10f (1.f + .1f * key));
-#else
-	float g = logf (powf (10.f, 1.f + .1f * threshold) + powf (10.f, 1.f + .1f * key));
-#endif
-	return /*-10/log(10)*/ -4.342944819f * ratio * g + in;
 }
 
-/* ****************************************************************************/
+/* evaluate the gain curve (see Dyncomp) for every x-pixel of the graph */
+static void
+m1_update_curve (darcUI* ui, float threshold, float ratio, bool hold)
+{
+	pthread_once (&m1_x_once, m1_init_axis);
 
-#define M1RECT 350
+	const float t_pw = powf (10.f, 1.f + .1f * threshold);
+	const float gr   = /*-10/log(10)*/ -4.342944819f * ratio;
+	const float sc   = M1RECT / -70.f;
+
+	for (uint32_t x = 0; x <= M1RECT; ++x) {
+		ui->m1_curve[x] = sc * (gr * logf (t_pw + m1_x_pw[x]) + m1_x_db[x] - 10.f);
+	}
+
+	/* with hold, the gain below threshold is that at threshold */
+	const float gh = gr * logf (2.f * t_pw);
+	uint32_t    hx = 0;
+	for (uint32_t x = 0; x <= M1RECT; ++x) {
+		const bool below = hold && m1_x_db[x] < threshold;
+		ui->m1_hcurve[x] = below ? sc * (gh + m1_x_db[x] - 10.f) : ui->m1_curve[x];
+		hx += m1_x_db[x] <= threshold;
+	}
+
+	ui->m1_hold_x = hx < M1RECT ? hx : M1RECT;
+	ui->m1_thrsh  = threshold;
+	ui->m1_ratio  = ratio;
+	ui->m1_hold   = hold;
+}
+
+/* ****************************************************************************/
 
 static void
 m1_size_request (RobWidget* handle, int* w, int* h)
@@ -734,18 +863,17 @@ m1_size_allocate (RobWidget* handle, int w, int h)
 {
 	darcUI* ui = (darcUI*)GET_HANDLE (handle);
 
-	if (ui->m1_grid) {
-		cairo_surface_destroy (ui->m1_grid);
-	}
+	art_unref (ui->m1_grid);
 	if (ui->m1_ctrl) {
 		cairo_surface_destroy (ui->m1_ctrl);
 	}
 	if (ui->m1_mask) {
 		cairo_surface_destroy (ui->m1_mask);
 	}
-	ui->m1_grid = NULL;
-	ui->m1_ctrl = NULL;
-	ui->m1_mask = NULL;
+	ui->m1_grid  = NULL;
+	ui->m1_ctrl  = NULL;
+	ui->m1_mask  = NULL;
+	ui->m1_valid = false;
 
 	queue_draw (ui->m1);
 }
@@ -826,16 +954,25 @@ m1_render_grid (darcUI* ui, cairo_t* cr)
 static void
 m1_render_mask (darcUI* ui)
 {
-	if (ui->m1_ctrl) {
-		cairo_surface_destroy (ui->m1_ctrl);
-	}
-	if (ui->m1_mask) {
-		cairo_surface_destroy (ui->m1_mask);
+	const float thrsh = gui_to_ctrl (1, robtk_dial_get_value (ui->spn_ctrl[1]));
+	const float ratio = gui_to_ctrl (2, robtk_dial_get_value (ui->spn_ctrl[2]));
+	const bool  hold  = robtk_cbtn_get_active (ui->btn_hold);
+
+	if (ui->m1_valid && thrsh == ui->m1_thrsh && ratio == ui->m1_ratio && hold == ui->m1_hold) {
+		return;
 	}
 
-	int sq      = M1RECT * ui->rw->widget_scale;
-	ui->m1_ctrl = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, sq, sq);
-	ui->m1_mask = cairo_image_surface_create (CAIRO_FORMAT_A8, M1RECT, M1RECT);
+	m1_update_curve (ui, thrsh, ratio, hold);
+
+	/* surfaces are only re-allocated when the widget-size changes */
+	if (!ui->m1_ctrl) {
+		int sq      = M1RECT * ui->rw->widget_scale;
+		ui->m1_ctrl = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, sq, sq);
+	}
+	if (!ui->m1_mask) {
+		ui->m1_mask = cairo_image_surface_create (CAIRO_FORMAT_A8, M1RECT, M1RECT);
+	}
+	ui->m1_valid = true;
 
 	cairo_t* cr = cairo_create (ui->m1_ctrl);
 	cairo_t* cm = cairo_create (ui->m1_mask);
@@ -855,10 +992,6 @@ m1_render_mask (darcUI* ui)
 	rounded_rectangle (cm, 0, 0, M1RECT, M1RECT, 8);
 	cairo_clip (cm);
 
-	const float thrsh = gui_to_ctrl (1, robtk_dial_get_value (ui->spn_ctrl[1]));
-	const float ratio = gui_to_ctrl (2, robtk_dial_get_value (ui->spn_ctrl[2]));
-	const bool  hold  = robtk_cbtn_get_active (ui->btn_hold);
-
 	if (is_light_theme ()) {
 		cairo_set_source_rgba (cr, .2, .2, .2, 1.0);
 	} else {
@@ -866,19 +999,17 @@ m1_render_mask (darcUI* ui)
 	}
 	cairo_set_line_width (cr, 1.0);
 
+	const float* curve  = ui->m1_curve;
+	const float* hcurve = ui->m1_hcurve;
+
 	if (hold) {
-		cairo_move_to (cr, 0, M1RECT * ((comp_curve (-60, thrsh, ratio, true) - 10) / -70.f));
+		cairo_move_to (cr, 0, hcurve[0]);
 
 		uint32_t x = 1;
-		for (; x <= M1RECT; ++x) {
-			const float x_db = 70.f * (-1.f + x / (float)M1RECT) + 10.f;
-			const float y_db = comp_curve (x_db, thrsh, ratio, true) - 10;
-			const float y    = M1RECT * (y_db / -70.f);
-			cairo_line_to (cr, x, y);
-			if (x_db > thrsh) {
-				break;
-			}
+		for (; x <= ui->m1_hold_x; ++x) {
+			cairo_line_to (cr, x, hcurve[x]);
 		}
+		x = ui->m1_hold_x;
 
 		const double dash1[] = { 1, 2, 4, 2 };
 		cairo_set_dash (cr, dash1, 4, 0);
@@ -886,10 +1017,7 @@ m1_render_mask (darcUI* ui)
 		cairo_set_dash (cr, NULL, 0, 0);
 
 		for (; x > 0; --x) {
-			const float x_db = 70.f * (-1.f + x / (float)M1RECT) + 10.f;
-			const float y_db = comp_curve (x_db, thrsh, ratio, false) - 10;
-			const float y    = M1RECT * (y_db / -70.f);
-			cairo_line_to (cr, x, y);
+			cairo_line_to (cr, x, curve[x]);
 		}
 
 		cairo_close_path (cr);
@@ -898,8 +1026,8 @@ m1_render_mask (darcUI* ui)
 		cairo_fill (cr);
 	}
 
-	cairo_move_to (cr, 0, M1RECT * ((comp_curve (-60, thrsh, ratio, false) - 10) / -70.f));
-	cairo_move_to (cm, 0, M1RECT * ((comp_curve (-60, thrsh, ratio, hold) - 10) / -70.f));
+	cairo_move_to (cr, 0, curve[0]);
+	cairo_move_to (cm, 0, hcurve[0]);
 
 	if (is_light_theme ()) {
 		cairo_set_source_rgba (cr, .2, .2, .2, 1.0);
@@ -908,11 +1036,8 @@ m1_render_mask (darcUI* ui)
 	}
 
 	for (uint32_t x = 1; x <= M1RECT; ++x) {
-		const float x_db = 70.f * (-1.f + x / (float)M1RECT) + 10.f;
-		const float y_db = comp_curve (x_db, thrsh, ratio, false) - 10;
-		const float h_db = comp_curve (x_db, thrsh, ratio, hold) - 10;
-		cairo_line_to (cr, x, M1RECT * (y_db / -70.f));
-		cairo_line_to (cm, x, M1RECT * (h_db / -70.f));
+		cairo_line_to (cr, x, curve[x]);
+		cairo_line_to (cm, x, hcurve[x]);
 	}
 	cairo_stroke_preserve (cr);
 
@@ -948,11 +1073,8 @@ m1_expose_event (RobWidget* handle, cairo_t* cr, cairo_rectangle_t* ev)
 	cairo_fill (cr);
 
 	if (!ui->m1_grid) {
-		int sq       = M1RECT * ui->rw->widget_scale;
-		ui->m1_grid  = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, sq, sq);
-		cairo_t* icr = cairo_create (ui->m1_grid);
-		m1_render_grid (ui, icr);
-		cairo_destroy (icr);
+		int sq      = M1RECT * ui->rw->widget_scale;
+		ui->m1_grid = art_ref (ui, ART_M1GRID, sq, sq, is_light_theme ());
 	}
 
 	if (!ui->m1_ctrl || !ui->m1_mask || ui->ctrl_dirty) {
@@ -992,7 +1114,8 @@ m1_expose_event (RobWidget* handle, cairo_t* cr, cairo_rectangle_t* ev)
 	cairo_stroke (cr);
 	cairo_set_dash (cr, NULL, 0, 0);
 
-	float pkx = (ui->_rms + 60.f) * M1RECT / 70.f;
+	float pkx  = (ui->_rms + 60.f) * M1RECT / 70.f;
+	ui->m1_pkx = pkx;
 	if (pkx > 0) {
 		cairo_save (cr);
 		cairo_rectangle (cr, 0, 0, MIN (M1RECT, pkx), M1RECT);
@@ -1011,8 +1134,10 @@ m1_expose_event (RobWidget* handle, cairo_t* cr, cairo_rectangle_t* ev)
 		cairo_clip (cr);
 		cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
 
-		float pky0 = (ui->_rms + ui->_gmax - 10.f) * M1RECT / -70.f;
-		float pky1 = (ui->_rms + ui->_gmin - 10.f) * M1RECT / -70.f;
+		float pky0    = (ui->_rms + ui->_gmax - 10.f) * M1RECT / -70.f;
+		float pky1    = (ui->_rms + ui->_gmin - 10.f) * M1RECT / -70.f;
+		ui->m1_pky[0] = pky0;
+		ui->m1_pky[1] = pky1;
 		cairo_move_to (cr, pkx, pky0);
 		cairo_line_to (cr, pkx, pky1);
 		cairo_set_line_width (cr, 5);
@@ -1024,6 +1149,37 @@ m1_expose_event (RobWidget* handle, cairo_t* cr, cairo_rectangle_t* ev)
 	return TRUE;
 }
 
+/* invalidate the level indicator and shaded area between the displayed
+ * and the new level, the rest of the graph is unchanged. Nothing is
+ * redrawn while the meters are static. */
+static void
+m1_queue_meter (darcUI* ui)
+{
+	const float pkx   = (ui->_rms + 60.f) * M1RECT / 70.f;
+	const float old   = ui->m1_pkx;
+	const float scale = ui->rw->widget_scale;
+	if (pkx <= 0 && old <= 0) {
+		return;
+	}
+
+	/* skip updates that do not move the indicator by at least a pixel */
+	const float pky0 = (ui->_rms + ui->_gmax - 10.f) * M1RECT / -70.f;
+	const float pky1 = (ui->_rms + ui->_gmin - 10.f) * M1RECT / -70.f;
+	if (lrintf (scale * pkx) == lrintf (scale * old)
+	    && lrintf (scale * pky0) == lrintf (scale * ui->m1_pky[0])
+	    && lrintf (scale * pky1) == lrintf (scale * ui->m1_pky[1])) {
+		return;
+	}
+
+	float x0 = (pkx > 0 && old > 0) ? fminf (pkx, old) : (pkx > 0 ? pkx : old);
+	float x1 = fmaxf (pkx, old);
+	x0       = floorf (scale * (x0 - 3)) - 1;
+	x1       = ceilf (scale * (fminf (x1, M1RECT) + 6)) + 1;
+	x0       = fmaxf (0, x0);
+
+	queue_draw_area (ui->m1, x0, 0, x1 - x0, ceilf (scale * M1RECT));
+}
+
 /* ****************************************************************************/
 
 static void
@@ -1061,6 +1217,328 @@ m2_expose_event (RobWidget* rw, cairo_t* cr, cairo_rectangle_t* ev)
 	return TRUE;
 }
 
+/* *****************************************************************************
+ * Gain history
+ */
+
+#define M3_SF_W (2 * HIST_COLS)
+#define M3_SF_H (2 * M1RECT)
+
+static uint32_t
+m3_pixel (const float* c, float a, const float* bg)
+{
+	const uint32_t r = 255.f * (a * c[0] + (1.f - a) * bg[0]);
+	const uint32_t g = 255.f * (a * c[1] + (1.f - a) * bg[1]);
+	const uint32_t b = 255.f * (a * c[2] + (1.f - a) * bg[2]);
+	return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+static int
+m3_column_width (darcUI* ui)
+{
+	const int cw = rint (ui->rw->widget_scale);
+	return cw < 1 ? 1 : (cw > 2 ? 2 : cw);
+}
+
+/* y-position of gain in dB, same range as the gain meter */
+static int
+m3_ypos (darcUI* ui, float db)
+{
+	const int y = rintf ((40.f - db) * ui->m3_h / 60.f);
+	return y < 0 ? 0 : (y >= ui->m3_h ? ui->m3_h - 1 : y);
+}
+
+static void
+m3_render_column (darcUI* ui, int col, float gmin, float gmax, bool valid)
+{
+	static const float c_bar[3] = { .9, .9, .1 };
+	static const float c_rng[3] = { .1, .9, .1 };
+
+	uint8_t*  data   = cairo_image_surface_get_data (ui->m3_sf);
+	const int stride = cairo_image_surface_get_stride (ui->m3_sf);
+	const int x0     = col * ui->m3_cw;
+
+	const float*   bg = is_light_theme () ? c_g80 : c_blk;
+	const uint32_t pb = m3_pixel (c_bar, 1.f, bg);
+	const uint32_t pr = m3_pixel (c_rng, 1.f, bg);
+
+	int y0 = 0, y1 = -1, yz = 0;
+	if (valid) {
+		y0 = m3_ypos (ui, gmax);
+		y1 = m3_ypos (ui, gmin);
+		yz = m3_ypos (ui, 0);
+	}
+
+	for (int y = 0; y < ui->m3_h; ++y) {
+		uint32_t* row = (uint32_t*)(data + y * stride);
+		uint32_t  px  = ui->m3_bg[y];
+		if (y >= y0 && y <= y1) {
+			/* min..max range, reduction below 0dB is highlighted */
+			px = y > yz ? pb : pr;
+		}
+		for (int x = x0; x < x0 + ui->m3_cw; ++x) {
+			row[x] = px;
+		}
+	}
+}
+
+static void
+m3_render_all (darcUI* ui)
+{
+	cairo_surface_flush (ui->m3_sf);
+	for (int i = 0; i < HIST_COLS; ++i) {
+		/* oldest value on the left */
+		const int n = HIST_COLS - ui->hist_len;
+		if (i < n) {
+			m3_render_column (ui, i, 0, 0, false);
+		} else {
+			const uint32_t r = (ui->hist_pos + HIST_COLS - ui->hist_len + i - n) % HIST_COLS;
+			m3_render_column (ui, i, ui->hist_min[r], ui->hist_max[r], true);
+		}
+	}
+	cairo_surface_mark_dirty (ui->m3_sf);
+}
+
+/* scroll the surface by one column and render only the new value */
+static void
+m3_scroll (darcUI* ui, float gmin, float gmax)
+{
+	uint8_t*  data   = cairo_image_surface_get_data (ui->m3_sf);
+	const int stride = cairo_image_surface_get_stride (ui->m3_sf);
+	const int cw     = ui->m3_cw;
+
+	cairo_surface_flush (ui->m3_sf);
+	for (int y = 0; y < ui->m3_h; ++y) {
+		uint32_t* row = (uint32_t*)(data + y * stride);
+		memmove (row, row + cw, (HIST_COLS - 1) * cw * sizeof (uint32_t));
+	}
+	m3_render_column (ui, HIST_COLS - 1, gmin, gmax, true);
+	cairo_surface_mark_dirty (ui->m3_sf);
+}
+
+/* collect a meter value that spans `ms` milliseconds, this may
+ * complete more than one column. After a longer gap (host stall,
+ * hidden window) the surface is re-rendered once instead of
+ * scrolling it for every column. */
+static void
+hist_push (darcUI* ui, float gmin, float gmax, float ms)
+{
+	if (ui->hist_ms == 0) {
+		ui->hist_cmin = gmin;
+		ui->hist_cmax = gmax;
+	} else {
+		ui->hist_cmin = fminf (ui->hist_cmin, gmin);
+		ui->hist_cmax = fmaxf (ui->hist_cmax, gmax);
+	}
+
+	ui->hist_ms += fminf (ms, HIST_COLS * HIST_MS);
+
+	const int  n_cols = ui->hist_ms / HIST_MS;
+	const bool scroll = n_cols <= HIST_SCROLL_MAX;
+
+	while (ui->hist_ms >= HIST_MS) {
+		ui->hist_ms -= HIST_MS;
+
+		ui->hist_min[ui->hist_pos] = ui->hist_cmin;
+		ui->hist_max[ui->hist_pos] = ui->hist_cmax;
+		ui->hist_pos               = (ui->hist_pos + 1) % HIST_COLS;
+		if (ui->hist_len < HIST_COLS) {
+			++ui->hist_len;
+		}
+
+		if (ui->m3_h > 0 && scroll) {
+			m3_scroll (ui, ui->hist_cmin, ui->hist_cmax);
+		}
+
+		/* the remaining time only has this value */
+		ui->hist_cmin = gmin;
+		ui->hist_cmax = gmax;
+	}
+
+	if (ui->m3_h > 0 && n_cols > 0) {
+		if (!scroll) {
+			m3_render_all (ui);
+		}
+		queue_draw (ui->m3);
+	}
+}
+
+static double
+hist_time (void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER t, f;
+	QueryPerformanceCounter (&t);
+	QueryPerformanceFrequency (&f);
+	return t.QuadPart / (double)f.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+#endif
+}
+
+/* Without the meter stream: hosts send port updates at their own rate,
+ * or only when a value changed. The previous value is valid until now. */
+static void
+hist_port_update (darcUI* ui)
+{
+	const double now = hist_time ();
+	if (ui->hist_time > 0) {
+		hist_push (ui, ui->hist_pmin, ui->hist_pmax, 1000 * (now - ui->hist_time));
+	}
+	ui->hist_time = now;
+	ui->hist_pmin = ui->_gmin;
+	ui->hist_pmax = ui->_gmax;
+}
+
+static void
+m3_size_request (RobWidget* handle, int* w, int* h)
+{
+	darcUI* ui = (darcUI*)GET_HANDLE (handle);
+
+	*w = HIST_COLS * m3_column_width (ui);
+	*h = M1RECT * ui->rw->widget_scale;
+}
+
+static void
+m3_size_allocate (RobWidget* handle, int w, int h)
+{
+	darcUI* ui = (darcUI*)GET_HANDLE (handle);
+
+	ui->m3_cw = m3_column_width (ui);
+	ui->m3_h  = M1RECT * ui->rw->widget_scale;
+	if (ui->m3_h > M3_SF_H) {
+		ui->m3_h = M3_SF_H;
+	}
+
+	robwidget_set_size (ui->m3, HIST_COLS * ui->m3_cw, ui->m3_h);
+
+	/* background and grid, 10dB steps */
+	const float* bg = is_light_theme () ? c_g80 : c_blk;
+	const float  c_grd[3] = { .5, .5, .5 };
+	for (int y = 0; y < ui->m3_h; ++y) {
+		ui->m3_bg[y] = m3_pixel (c_grd, 0, bg);
+	}
+	for (int db = -10; db < 40; db += 10) {
+		ui->m3_bg[m3_ypos (ui, db)] = m3_pixel (c_grd, db == 0 ? .75 : .4, bg);
+	}
+
+	m3_render_all (ui);
+	queue_draw (ui->m3);
+}
+
+static bool
+m3_expose_event (RobWidget* handle, cairo_t* cr, cairo_rectangle_t* ev)
+{
+	darcUI* ui = (darcUI*)GET_HANDLE (handle);
+	cairo_rectangle (cr, ev->x, ev->y, ev->width, ev->height);
+	cairo_clip (cr);
+
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_rectangle (cr, 0, 0, HIST_COLS * ui->m3_cw, ui->m3_h);
+	cairo_set_source_surface (cr, ui->m3_sf, 0, 0);
+	cairo_fill (cr);
+	return TRUE;
+}
+
+/* *****************************************************************************
+ * Surfaces that only depend on size and theme are rendered once and
+ * shared by all instances of the plugin GUI in a process.
+ */
+
+typedef struct _DarcArt {
+	int              id;
+	int              w, h;
+	bool             light;
+	int              refcnt;
+	cairo_surface_t* sf;
+	struct _DarcArt* next;
+} DarcArt;
+
+static DarcArt*        art_cache = NULL;
+static pthread_mutex_t art_lock  = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+art_render (darcUI* ui, cairo_t* cr, int id)
+{
+	switch (id) {
+		case ART_M0BG:
+			m0_render_faceplate (ui, cr);
+			break;
+		case ART_M1GRID:
+			m1_render_grid (ui, cr);
+			break;
+		default:
+			render_faceplate (ui, cr, id - ART_DIAL);
+			break;
+	}
+}
+
+static cairo_surface_t*
+art_ref (darcUI* ui, int id, int w, int h, bool light)
+{
+	cairo_surface_t* sf = NULL;
+
+	pthread_mutex_lock (&art_lock);
+	for (DarcArt* a = art_cache; a; a = a->next) {
+		if (a->id == id && a->w == w && a->h == h && a->light == light) {
+			++a->refcnt;
+			sf = a->sf;
+			break;
+		}
+	}
+
+	if (!sf) {
+		DarcArt* a   = (DarcArt*)malloc (sizeof (DarcArt));
+		sf           = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
+		cairo_t* icr = cairo_create (sf);
+		art_render (ui, icr, id);
+		cairo_destroy (icr);
+
+		a->id     = id;
+		a->w      = w;
+		a->h      = h;
+		a->light  = light;
+		a->refcnt = 1;
+		a->sf     = sf;
+		a->next   = art_cache;
+		art_cache = a;
+	}
+	pthread_mutex_unlock (&art_lock);
+	return sf;
+}
+
+static void
+art_unref (cairo_surface_t* sf)
+{
+	if (!sf) {
+		return;
+	}
+	pthread_mutex_lock (&art_lock);
+	for (DarcArt** a = &art_cache; *a; a = &(*a)->next) {
+		if ((*a)->sf != sf) {
+			continue;
+		}
+		if (--(*a)->refcnt == 0) {
+			DarcArt* d = *a;
+			*a         = d->next;
+			cairo_surface_destroy (d->sf);
+			free (d);
+		}
+		break;
+	}
+	pthread_mutex_unlock (&art_lock);
+}
+
+static void
+prepare_faceplates (darcUI* ui)
+{
+	for (int i = 0; i < 5; ++i) {
+		ui->dial_bg[i] = art_ref (ui, ART_DIAL + i, 2 * (GED_WIDTH + 8), 2 * (GED_HEIGHT + 20), false);
+	}
+}
+
 /* ****************************************************************************/
 
 static RobWidget*
@@ -1189,8 +1667,20 @@ toplevel (darcUI* ui, void* const top)
 
 	rob_table_attach (ui->ctbl, ui->m2, 0, 2, 3, 4, 8, 2, RTK_FILL, RTK_FILL);
 
+	/* gain history */
+	ui->m3    = robwidget_new (ui);
+	ui->m3_sf = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, M3_SF_W, M3_SF_H);
+	robwidget_set_alignment (ui->m3, .5, .5);
+	robwidget_set_expose_event (ui->m3, m3_expose_event);
+	robwidget_set_size_request (ui->m3, m3_size_request);
+	robwidget_set_size_allocate (ui->m3, m3_size_allocate);
+
+	ui->hbox = rob_hbox_new (FALSE, 2);
+	rob_hbox_child_pack (ui->hbox, ui->m1, FALSE, TRUE);
+	rob_hbox_child_pack (ui->hbox, ui->m3, FALSE, TRUE);
+
 	/* top-level packing */
-	rob_vbox_child_pack (ui->rw, ui->m1, FALSE, TRUE);
+	rob_vbox_child_pack (ui->rw, ui->hbox, FALSE, TRUE);
 	rob_vbox_child_pack (ui->rw, ui->ctbl, FALSE, TRUE);
 	rob_vbox_child_pack (ui->rw, ui->m0, TRUE, TRUE);
 	robwidget_set_leave_notify(ui->rw, top_leave_notify);
@@ -1203,7 +1693,7 @@ gui_cleanup (darcUI* ui)
 	for (int i = 0; i < 5; ++i) {
 		robtk_dial_destroy (ui->spn_ctrl[i]);
 		robtk_lbl_destroy (ui->lbl_ctrl[i]);
-		cairo_surface_destroy (ui->dial_bg[i]);
+		art_unref (ui->dial_bg[i]);
 	}
 
 	pango_font_description_free (ui->font[0]);
@@ -1215,12 +1705,8 @@ gui_cleanup (darcUI* ui)
 	if (ui->m_bg) {
 		cairo_pattern_destroy (ui->m_bg);
 	}
-	if (ui->m0bg) {
-		cairo_surface_destroy (ui->m0bg);
-	}
-	if (ui->m1_grid) {
-		cairo_surface_destroy (ui->m1_grid);
-	}
+	art_unref (ui->m0bg);
+	art_unref (ui->m1_grid);
 	if (ui->m1_ctrl) {
 		cairo_surface_destroy (ui->m1_ctrl);
 	}
@@ -1232,10 +1718,71 @@ gui_cleanup (darcUI* ui)
 	robwidget_destroy (ui->m0);
 	robwidget_destroy (ui->m1);
 	robwidget_destroy (ui->m2);
+	robwidget_destroy (ui->m3);
+	cairo_surface_destroy (ui->m3_sf);
+	rob_box_destroy (ui->hbox);
 	rob_table_destroy (ui->ctbl);
 	rob_box_destroy (ui->rw);
 }
 
+/* *****************************************************************************
+ * Meter stream
+ */
+
+static void
+send_subscription (darcUI* ui, bool on)
+{
+	if (!ui->map) {
+		return;
+	}
+	uint8_t              buf[64];
+	LV2_Atom_Forge_Frame frame;
+	lv2_atom_forge_set_buffer (&ui->forge, buf, sizeof (buf));
+	LV2_Atom* msg = (LV2_Atom*)lv2_atom_forge_object (&ui->forge, &frame, 0, on ? ui->darc_ui_on : ui->darc_ui_off);
+	lv2_atom_forge_pop (&ui->forge, &frame);
+	ui->write (ui->controller, ui->port_control, lv2_atom_total_size (msg), ui->atom_eventTransfer, msg);
+}
+
+static void
+parse_meters (darcUI* ui, const LV2_Atom_Object* obj)
+{
+	const LV2_Atom* frames = NULL;
+	if (obj->body.otype != ui->darc_meters) {
+		return;
+	}
+	lv2_atom_object_get (obj, ui->darc_frames, &frames, 0);
+	if (!frames || frames->type != ui->forge.Vector) {
+		return;
+	}
+	const LV2_Atom_Vector* vec = (const LV2_Atom_Vector*)frames;
+	if (vec->body.child_type != ui->forge.Float) {
+		return;
+	}
+	const uint32_t n = (frames->size - sizeof (LV2_Atom_Vector_Body)) / (3 * sizeof (float));
+	const float*   f = (const float*)LV2_ATOM_CONTENTS_CONST (LV2_Atom_Vector, frames);
+	if (n == 0) {
+		return;
+	}
+
+	/* display the range of the batch */
+	float gmin = f[0];
+	float gmax = f[1];
+	for (uint32_t i = 0; i < n; ++i) {
+		gmin = fminf (gmin, f[3 * i]);
+		gmax = fmaxf (gmax, f[3 * i + 1]);
+		hist_push (ui, f[3 * i], f[3 * i + 1], DARC_FRAME_MS);
+	}
+
+	ui->stream      = true;
+	ui->stream_idle = 0;
+	ui->hist_time   = 0;
+	ui->_gmin       = gmin;
+	ui->_gmax       = gmax;
+	ui->_rms        = f[3 * n - 1];
+	m0_queue_meter (ui);
+	m1_queue_meter (ui);
+}
+
 /* *****************************************************************************
  * RobTk + LV2
  */
@@ -1294,6 +1841,21 @@ instantiate (
 
 	interpolate_fg_bg (c_dlf, .2);
 
+	/* the mono variant has no second audio pair */
+	const bool mono  = !strcmp (plugin_uri, RTK_URI "mono");
+	ui->port_control = mono ? DARC_INPUT1 : DARC_CONTROL;
+	ui->port_notify  = mono ? DARC_OUTPUT1 : DARC_NOTIFY;
+
+	if (map) {
+		ui->map                = (LV2_URID_Map*)map;
+		ui->atom_eventTransfer = map->map (map->handle, LV2_ATOM__eventTransfer);
+		ui->darc_ui_on         = map->map (map->handle, DARC__ui_on);
+		ui->darc_ui_off        = map->map (map->handle, DARC__ui_off);
+		ui->darc_meters        = map->map (map->handle, DARC__meters);
+		ui->darc_frames        = map->map (map->handle, DARC__frames);
+		lv2_atom_forge_init (&ui->forge, ui->map);
+	}
+
 	ui->nfo             = robtk_info (ui_toplevel);
 	ui->write           = write_function;
 	ui->controller      = controller;
@@ -1318,6 +1880,8 @@ instantiate (
 			}
 		}
 	}
+
+	send_subscription (ui, true);
 	return ui;
 }
 
@@ -1325,6 +1889,7 @@ static void
 cleanup (LV2UI_Handle handle)
 {
 	darcUI* ui = (darcUI*)handle;
+	send_subscription (ui, false);
 	gui_cleanup (ui);
 	free (ui);
 }
@@ -1339,22 +1904,43 @@ port_event (LV2UI_Handle handle,
 {
 	darcUI* ui = (darcUI*)handle;
 
+	if (format == ui->atom_eventTransfer && ui->map && port_index == ui->port_notify) {
+		const LV2_Atom* atom = (const LV2_Atom*)buffer;
+		if (lv2_atom_forge_is_object_type (&ui->forge, atom->type)) {
+			parse_meters (ui, (const LV2_Atom_Object*)atom);
+		}
+		return;
+	}
+
 	if (format != 0) {
 		return;
 	}
 
+	/* The meter ports are ignored while the stream is active.
+	 * If the host stops delivering it, fall back to the ports. */
+	if (ui->stream && port_index >= DARC_GMIN && port_index <= DARC_RMS) {
+		if (port_index != DARC_RMS || ++ui->stream_idle < STREAM_TIMEOUT) {
+			return;
+		}
+		ui->stream = false;
+	}
+
+	/* queued areas accumulate until the next expose, so the
+	 * three meter ports result in a single partial redraw. */
 	if (port_index == DARC_GMIN) {
 		ui->_gmin = *(float*)buffer;
-		/* TODO: partial exposure, only redraw changed gain area */
-		queue_draw (ui->m0);
-		queue_draw (ui->m1);
+		m0_queue_meter (ui);
+		m1_queue_meter (ui);
+		hist_port_update (ui);
 	} else if (port_index == DARC_GMAX) {
 		ui->_gmax = *(float*)buffer;
-		queue_draw (ui->m0);
-		queue_draw (ui->m1);
+		m0_queue_meter (ui);
+		m1_queue_meter (ui);
+		hist_port_update (ui);
 	} else if (port_index == DARC_RMS) {
 		ui->_rms = *(float*)buffer;
-		queue_draw (ui->m1);
+		m1_queue_meter (ui);
+		hist_port_update (ui);
 	} else if (port_index == DARC_HOLD) {
 		ui->disable_signals = true;
 		robtk_cbtn_set_active (ui->btn_hold, (*(float*)buffer) > 0);
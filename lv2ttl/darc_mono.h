@@ -10,7 +10,7 @@ static const RtkLv2Description _plugin_mono = {
 	, 0 // uint32_t dsp_descriptor_id
 	, 0 // uint32_t gui_descriptor_id
 	, "x42-comp - Dynamic Compressor Mono" // const char *plugin_human_id
-	, (const struct LV2Port[12])
+	, (const struct LV2Port[15])
 	{
 		{ "enable", CONTROL_IN, 1.000000, 0.000000, 1.000000, "Enable"},
 		{ "hold", CONTROL_IN, 0.000000, 0.000000, 1.000000, "Hold"},
@@ -24,17 +24,20 @@ static const RtkLv2Description _plugin_mono = {
 		{ "rms", CONTROL_OUT, nan, -80.000000, 10.000000, "Signal Level"},
 		{ "in", AUDIO_IN, nan, nan, nan, "In"},
 		{ "out", AUDIO_OUT, nan, nan, nan, "Out"},
+		{ "control", ATOM_IN, nan, nan, nan, "Control"},
+		{ "notify", ATOM_OUT, nan, nan, nan, "Notify"},
+		{ "tier", CONTROL_OUT, nan, 0.000000, 2.000000, "Processing Tier"},
 	}
-	, 12 // uint32_t nports_total
+	, 15 // uint32_t nports_total
 	, 1 // uint32_t nports_audio_in
 	, 1 // uint32_t nports_audio_out
 	, 0 // uint32_t nports_midi_in
 	, 0 // uint32_t nports_midi_out
-	, 0 // uint32_t nports_atom_in
-	, 0 // uint32_t nports_atom_out
-	, 10 // uint32_t nports_ctrl
+	, 1 // uint32_t nports_atom_in
+	, 1 // uint32_t nports_atom_out
+	, 11 // uint32_t nports_ctrl
 	, 7 // uint32_t nports_ctrl_in
-	, 3 // uint32_t nports_ctrl_out
+	, 4 // uint32_t nports_ctrl_out
 	, 8192 // uint32_t min_atom_bufsiz
 	, false // bool send_time_info
 	, UINT32_MAX // uint32_t latency_ctrl_port
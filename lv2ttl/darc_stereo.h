@@ -10,7 +10,7 @@ static const RtkLv2Description _plugin_stereo = {
 	, 1 // uint32_t dsp_descriptor_id
 	, 0 // uint32_t gui_descriptor_id
 	, "x42-comp - Dynamic Compressor Stereo" // const char *plugin_human_id
-	, (const struct LV2Port[14])
+	, (const struct LV2Port[17])
 	{
 		{ "enable", CONTROL_IN, 1.000000, 0.000000, 1.000000, "Enable"},
 		{ "hold", CONTROL_IN, 0.000000, 0.000000, 1.000000, "Hold"},
@@ -26,17 +26,20 @@ static const RtkLv2Description _plugin_stereo = {
 		{ "outL", AUDIO_OUT, nan, nan, nan, "Out Left"},
 		{ "inR", AUDIO_IN, nan, nan, nan, "In Right"},
 		{ "outR", AUDIO_OUT, nan, nan, nan, "Out Right"},
+		{ "control", ATOM_IN, nan, nan, nan, "Control"},
+		{ "notify", ATOM_OUT, nan, nan, nan, "Notify"},
+		{ "tier", CONTROL_OUT, nan, 0.000000, 2.000000, "Processing Tier"},
 	}
-	, 14 // uint32_t nports_total
+	, 17 // uint32_t nports_total
 	, 2 // uint32_t nports_audio_in
 	, 2 // uint32_t nports_audio_out
 	, 0 // uint32_t nports_midi_in
 	, 0 // uint32_t nports_midi_out
-	, 0 // uint32_t nports_atom_in
-	, 0 // uint32_t nports_atom_out
-	, 10 // uint32_t nports_ctrl
+	, 1 // uint32_t nports_atom_in
+	, 1 // uint32_t nports_atom_out
+	, 11 // uint32_t nports_ctrl
 	, 7 // uint32_t nports_ctrl_in
-	, 3 // uint32_t nports_ctrl_out
+	, 4 // uint32_t nports_ctrl_out
 	, 8192 // uint32_t min_atom_bufsiz
 	, false // bool send_time_info
 	, UINT32_MAX // uint32_t latency_ctrl_port
@@ -0,0 +1,229 @@
+/* darc.lv2 -- input and parameter capture
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_CAPTURE_H
+#define _DARC_CAPTURE_H
+
+/* run () can copy its input and control values to a preallocated
+ * single-producer, single-consumer byte ring, which is written to disk
+ * by a background thread of the host application (tools/capfile.h).
+ *
+ * A capture file is a DarcCapHeader followed by records:
+ *
+ *  DARC_CAP_STATE  DyncompState at the start of the next block. Written
+ *                  before the first block, after activate () and after
+ *                  blocks were dropped.
+ *  DARC_CAP_BLOCK  control values, processing coefficients and planar
+ *                  float input of one run () call, and a hash of the output.
+ *  DARC_CAP_GAP    n_samples blocks were dropped, the ring was full.
+ *
+ * Replaying the blocks with darc_cap_set_coef () and Dyncomp_process ()
+ * reproduces the output bit-exactly.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "darc.h"
+#include "dyncomp.h"
+
+#define DARC_CAP_VERSION 3
+
+enum {
+	DARC_CAP_BLOCK = 1,
+	DARC_CAP_STATE,
+	DARC_CAP_GAP,
+};
+
+typedef struct {
+	char     magic[8]; // "DarcCap"
+	uint32_t version;
+	uint32_t n_channels;
+	float    sample_rate;
+	uint32_t record_size; // sizeof (DarcCapRecord)
+} DarcCapHeader;
+
+/* processing coefficients, as set by the Dyncomp_set_* functions, and
+ * the kernel selected by the CPU budget governor.
+ * They are recorded instead of recomputed, with -ffast-math the result
+ * of the setters depends on the context they are inlined into.
+ */
+typedef struct {
+	float    p_ign;
+	float    p_thr;
+	float    p_rat;
+	float    w_att;
+	float    w_rel;
+	float    w_rms;
+	float    w_lpf;
+	uint32_t hold;
+	uint32_t tier;
+} DarcCapCoef;
+
+typedef struct {
+	uint32_t    type;
+	uint32_t    n_samples;       // BLOCK: per channel; GAP: dropped blocks
+	uint64_t    pos;             // sample position
+	float       ctrl[DARC_GMIN]; // BLOCK: control input ports
+	DarcCapCoef coef;            // BLOCK: as used by Dyncomp_process ()
+	uint32_t    hash;            // BLOCK: darc_cap_hash () of the output
+} DarcCapRecord;
+
+typedef struct {
+	uint8_t* buf;
+	uint32_t size;    // power of two
+	uint32_t write;   // free-running byte positions
+	uint32_t read;
+	uint32_t dropped; // written by the producer
+	uint32_t reserve; // producer: end of the pending record
+} DarcCapture;
+
+/* Extension data of the plugin. attach () may be called from any thread,
+ * NULL stops the capture. A ring must stay valid until the plugin is
+ * deactivated, or until run () returned after it was detached.
+ */
+#define DARC__capture DARC_URI "capture"
+
+typedef struct {
+	void (*attach) (void* instance, DarcCapture* cap);
+} DarcCaptureInterface;
+
+static inline void
+darc_cap_get_coef (const Dyncomp* d, DarcCapCoef* k)
+{
+	k->p_ign = d->p_ign;
+	k->p_thr = d->p_thr;
+	k->p_rat = d->p_rat;
+	k->w_att = d->w_att;
+	k->w_rel = d->w_rel;
+	k->w_rms = d->w_rms;
+	k->w_lpf = d->w_lpf;
+	k->hold  = d->hold;
+	k->tier  = d->tier;
+}
+
+static inline void
+darc_cap_set_coef (Dyncomp* d, const DarcCapCoef* k)
+{
+	d->p_ign = k->p_ign;
+	d->p_thr = k->p_thr;
+	d->p_rat = k->p_rat;
+	d->w_att = k->w_att;
+	d->w_rel = k->w_rel;
+	d->w_rms = k->w_rms;
+	d->w_lpf = k->w_lpf;
+	d->hold  = k->hold != 0;
+	d->tier  = k->tier;
+}
+
+/* FNV-1a of the 32bit words of all channels */
+static inline uint32_t
+darc_cap_hash (float* const* io, uint32_t n_channels, uint32_t n_samples)
+{
+	uint32_t h = 2166136261u;
+	for (uint32_t c = 0; c < n_channels; ++c) {
+		const uint32_t* w = (const uint32_t*)io[c];
+		for (uint32_t i = 0; i < n_samples; ++i) {
+			h = (h ^ w[i]) * 16777619u;
+		}
+	}
+	return h;
+}
+
+static inline uint32_t
+darc_cap_space (const DarcCapture* c)
+{
+	return c->size - (c->write - __atomic_load_n (&c->read, __ATOMIC_ACQUIRE));
+}
+
+static inline void
+darc_cap_put (DarcCapture* c, uint32_t pos, const void* data, uint32_t len)
+{
+	const uint32_t off = pos & (c->size - 1);
+	const uint32_t n1  = len < c->size - off ? len : c->size - off;
+	memcpy (c->buf + off, data, n1);
+	memcpy (c->buf, (const uint8_t*)data + n1, len - n1);
+}
+
+/* producer: write state, gap and the input of a block, but do not
+ * publish it yet. Returns the position of the block record, or -1
+ * if there is not enough space (the block is dropped).
+ */
+static inline int64_t
+darc_cap_begin (DarcCapture* c, const DyncompState* st, const DarcCapRecord* rec, float* const* in, uint32_t n_channels)
+{
+	const uint32_t data = n_channels * rec->n_samples * sizeof (float);
+	uint32_t       need = sizeof (DarcCapRecord) + data;
+
+	if (st) {
+		need += sizeof (DarcCapRecord) + sizeof (DyncompState);
+	}
+	if (c->dropped) {
+		need += sizeof (DarcCapRecord);
+	}
+	if (need > darc_cap_space (c)) {
+		++c->dropped;
+		return -1;
+	}
+
+	uint32_t w = c->write;
+
+	if (c->dropped) {
+		DarcCapRecord gap;
+		memset (&gap, 0, sizeof (gap));
+		gap.type      = DARC_CAP_GAP;
+		gap.n_samples = c->dropped;
+		gap.pos       = rec->pos;
+		darc_cap_put (c, w, &gap, sizeof (gap));
+		w += sizeof (gap);
+		c->dropped = 0;
+	}
+
+	if (st) {
+		DarcCapRecord sr;
+		memset (&sr, 0, sizeof (sr));
+		sr.type = DARC_CAP_STATE;
+		sr.pos  = rec->pos;
+		darc_cap_put (c, w, &sr, sizeof (sr));
+		w += sizeof (sr);
+		darc_cap_put (c, w, st, sizeof (DyncompState));
+		w += sizeof (DyncompState);
+	}
+
+	const uint32_t at = w;
+	darc_cap_put (c, w, rec, sizeof (DarcCapRecord));
+	w += sizeof (DarcCapRecord);
+	for (uint32_t ch = 0; ch < n_channels; ++ch) {
+		darc_cap_put (c, w, in[ch], rec->n_samples * sizeof (float));
+		w += rec->n_samples * sizeof (float);
+	}
+
+	c->reserve = w;
+	return at;
+}
+
+/* producer: add the hash of the output and publish the block */
+static inline void
+darc_cap_commit (DarcCapture* c, uint32_t at, uint32_t hash)
+{
+	darc_cap_put (c, at + offsetof (DarcCapRecord, hash), &hash, sizeof (hash));
+	__atomic_store_n (&c->write, c->reserve, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -1,7 +1,68 @@
 /* common definitions UI and DSP */
 
+#ifndef _DARC_H
+#define _DARC_H
+
+#include <stdint.h>
+
 #define DARC_URI "http://gareus.org/oss/lv2/darc#"
 
+/* Meter stream, DSP to UI.
+ *
+ * The UI subscribes by sending a DARC__ui_on object to the control port
+ * and unsubscribes with DARC__ui_off. Subscriptions are counted, the
+ * stream stops after every UI sent DARC__ui_off. While subscribed the
+ * DSP sends one DARC__meters object per run () on the notify port,
+ * if at least one frame completed during the cycle. It contains the
+ * frame length in samples (DARC__interval, Int) and a vector of floats
+ * (DARC__frames) with [gain_min, gain_max, rms] in dB per frame. The
+ * event is timestamped with the last sample of the first frame.
+ */
+#define DARC_FRAME_MS 5 // meter frame length
+
+#define DARC__ui_on DARC_URI "ui_on"
+#define DARC__ui_off DARC_URI "ui_off"
+#define DARC__meters DARC_URI "meters"
+#define DARC__interval DARC_URI "interval"
+#define DARC__frames DARC_URI "frames"
+
+/* DSP cost counters, extension data of plugins that are compiled with
+ * DARC_INSTRUMENT. The counters are published once per second of processed
+ * audio and can be read from any thread. get_stats () returns 0 if the
+ * counters could not be read consistently and should be retried.
+ */
+#define DARC__instrument DARC_URI "instrument"
+
+typedef struct {
+	uint64_t calls;       // run () calls
+	uint64_t samples;     // processed samples
+	uint64_t fast_blocks; // Dyncomp_run () with settled parameters
+	uint64_t full_blocks; // Dyncomp_run () interpolating gain or ratio
+	uint64_t resets;      // state reset after NaN or inf
+	uint32_t win_calls;   // run () calls in the last window
+	uint64_t cycles_max;  // per run (), last window
+	double   cycles_avg;  // per run (), last window
+	double   cycles_spl;  // per sample, last window
+} DarcInstrumentStats;
+
+typedef struct {
+	int (*get_stats) (void* instance, DarcInstrumentStats* stats);
+} DarcInstrumentInterface;
+
+/* CPU budget governor, extension data. The budget is the share of the
+ * period (0..1) that run () may take before cheaper kernels are used,
+ * 0 disables the governor. The cheaper kernels are not bit-exact, so the
+ * plugin starts with the governor disabled until a host sets a budget.
+ * set_budget () may be called from any thread.
+ */
+#define DARC__governor DARC_URI "governor"
+
+#define DARC_GOV_BUDGET 0.1f // default of x42-darc-headless and x42-darc-multi
+
+typedef struct {
+	void (*set_budget) (void* instance, float budget);
+} DarcGovernorInterface;
+
 typedef enum {
 	DARC_ENABLE,
 	DARC_HOLD,
@@ -19,5 +80,19 @@ typedef enum {
 	DARC_OUTPUT0,
 	DARC_INPUT1,
 	DARC_OUTPUT1,
+
+	/* the mono variant has no INPUT1/OUTPUT1,
+	 * control, notify and tier use index 12 to 14 */
+	DARC_CONTROL,
+	DARC_NOTIFY,
+
+	/* active DARC_TIER_*, optional */
+	DARC_TIER,
+
+	/* only with DARC_INSTRUMENT, optional */
+	DARC_CYCLES_SPL,
+	DARC_CYCLES_MAX,
 	DARC_LAST
 } PortIndex;
+
+#endif
@@ -0,0 +1,877 @@
+/* darc.lv2 -- Dynamic Audio Range Compressor, DSP core
+ *
+ * Copyright (C) 2018,2019 Robin Gareus <robin@gareus.org>
+ * inspired by Fons Adriaensen's zita-dc1
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_DYNCOMP_H
+#define _DARC_DYNCOMP_H
+
+/* This file is shared by the LV2 plugin and the standalone tools.
+ * Users must define _GNU_SOURCE before including <math.h> to use exp10f().
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fastmath.h"
+
+/* Processing kernels, in order of decreasing cost. They share the state,
+ * the tier can change between any two calls of Dyncomp_run ().
+ */
+enum {
+	DARC_TIER_FULL = 0, // libm logf () and expf () for every sample
+	DARC_TIER_FAST,     // approximated logf () and expf (), vectorized
+	DARC_TIER_CTRL,     // gain computed every DARC_CTRL_STRIDE samples, interpolated
+	DARC_TIER_LAST
+};
+
+#define DARC_CTRL_STRIDE 16
+#define DARC_CTRL_MAXSTEP .01f // max gain change of an interpolated chunk, ln
+
+/* Optional meter, min/max gain and level for every `len` samples.
+ * Frames are collected by Dyncomp_run () without affecting the audio,
+ * and are independent of the block-size. The caller consumes them and
+ * resets `n`. If more than `max` frames complete before that, the
+ * remaining ones are merged into the last. The chunked kernels end a
+ * frame at the end of a chunk, the average frame length is still `len`.
+ */
+typedef struct {
+	uint32_t len;   // samples per frame, > 0
+	uint32_t cnt;   // samples in the current frame
+	uint32_t n;     // completed frames
+	uint32_t max;   // capacity of `val`, in frames
+	uint32_t first; // sample of the last Dyncomp_run () call, that completed the first frame
+	float*   val;   // per frame: min and max gain [dB], level [dBFS]
+} DyncompFrames;
+
+typedef struct {
+	float sample_rate;
+
+	uint32_t n_channels;
+	float    norm_input;
+
+	float ratio;
+	float p_rat;
+
+	bool hold;
+
+	float igain;
+	float p_ign;
+	float l_ign;
+
+	float p_thr;
+	float l_thr;
+
+	float w_att;
+	float w_rel;
+	float t_att;
+	float t_rel;
+
+	float za1;
+	float zr1;
+	float zr2;
+
+	bool  newg;
+	float gmax;
+	float gmin;
+
+	float rms;
+	float w_rms;
+	float w_lpf;
+
+	uint32_t n_reset; // state reset after NaN or inf
+	uint32_t tier;    // DARC_TIER_*
+
+	DyncompFrames* frames; // NULL: off
+
+#ifdef DARC_INSTRUMENT
+	uint32_t n_fast; // Dyncomp_run () calls with settled parameters
+	uint32_t n_full; // calls interpolating input gain or ratio
+#endif
+} Dyncomp;
+
+static inline void
+Dyncomp_reset (Dyncomp* self)
+{
+	self->za1  = 0.f;
+	self->zr1  = 0.f;
+	self->zr2  = 0.f;
+	self->rms  = 0.f;
+	self->gmin = 0.f;
+	self->gmax = 0.f;
+	self->newg = true;
+}
+
+static inline void
+Dyncomp_set_ratio (Dyncomp* self, float r)
+{
+	self->p_rat = 0.5f * r;
+}
+
+static inline void
+Dyncomp_set_inputgain (Dyncomp* self, float g)
+{
+	if (g == self->l_ign) {
+		return;
+	}
+	self->l_ign = g;
+#ifdef __USE_GNU
+	self->p_ign = exp10f (0.05f * g);
+#else
+	self->p_ign = powf (10.0f, 0.05f * g);
+#endif
+}
+
+static inline void
+Dyncomp_set_threshold (Dyncomp* self, float t)
+{
+	if (t == self->l_thr) {
+		return;
+	}
+	self->l_thr = t;
+	/* Note that this is signal-power, hence .5 * 10^(x/10) */
+#ifdef __USE_GNU
+	self->p_thr = 0.5f * exp10f (0.1f * t);
+#else
+	self->p_thr = 0.5f * powf (10.0f, 0.1f * t);
+#endif
+}
+
+static inline void
+Dyncomp_set_hold (Dyncomp* self, bool hold)
+{
+	self->hold = hold;
+}
+
+static inline void
+Dyncomp_set_attack (Dyncomp* self, float a)
+{
+	if (a == self->t_att) {
+		return;
+	}
+	self->t_att = a;
+	self->w_att = 0.5f / (self->sample_rate * a);
+}
+
+static inline void
+Dyncomp_set_release (Dyncomp* self, float r)
+{
+	if (r == self->t_rel) {
+		return;
+	}
+	self->t_rel = r;
+	self->w_rel = 3.5f / (self->sample_rate * r);
+}
+
+static inline void
+Dyncomp_get_gain (Dyncomp* self, float* gmin, float* gmax, float* rms)
+{
+	*gmin = self->gmin * 8.68589f; /* 20 / log(10) */
+	*gmax = self->gmax * 8.68589f;
+	if (self->rms > 1e-8f) {
+		*rms = 10.f * log10f (2.f * self->rms);
+	} else {
+		*rms = -80;
+	}
+	self->newg = true;
+}
+
+static inline void
+Dyncomp_init (Dyncomp* self, float sample_rate, uint32_t n_channels)
+{
+	self->sample_rate = sample_rate;
+	self->n_channels  = n_channels;
+	self->norm_input  = 1.f / n_channels;
+
+	self->ratio = 0.f;
+	self->p_rat = 0.f;
+
+	self->igain = 1.f;
+	self->p_ign = 1.f;
+	self->l_ign = 0.f;
+
+	self->p_thr = 0.05f;
+	self->l_thr = -10.f;
+
+	self->hold = false;
+
+	self->t_att = 0.f;
+	self->t_rel = 0.f;
+
+	self->w_rms = 5.f / sample_rate;
+	self->w_lpf = 160.f / sample_rate;
+
+	self->n_reset = 0;
+	self->tier    = DARC_TIER_FULL;
+	self->frames  = NULL;
+#ifdef DARC_INSTRUMENT
+	self->n_fast = 0;
+	self->n_full = 0;
+#endif
+
+	Dyncomp_set_attack (self, 0.01f);
+	Dyncomp_set_release (self, 0.03f);
+	Dyncomp_reset (self);
+}
+
+/* complete a meter frame at sample `at` of the current call, and start
+ * a new min/max gain report */
+static inline void
+Dyncomp_frame (DyncompFrames* fr, uint32_t at, float* gmin, float* gmax, float rms)
+{
+	const float fmin = *gmin * 8.68589f;
+	const float fmax = *gmax * 8.68589f;
+	const float frms = rms > 1e-8f ? 10.f * log10f (2.f * rms) : -80.f;
+
+	if (fr->n == 0) {
+		fr->first = at;
+	}
+	if (fr->n < fr->max) {
+		float* f = &fr->val[3 * fr->n++];
+		f[0]     = fmin;
+		f[1]     = fmax;
+		f[2]     = frms;
+	} else {
+		float* f = &fr->val[3 * (fr->max - 1)];
+		f[0]     = fminf (f[0], fmin);
+		f[1]     = fmaxf (f[1], fmax);
+		f[2]     = frms;
+	}
+
+	*gmax = -100.0f;
+	*gmin = 100.0f;
+}
+
+/* DARC_TIER_FULL, see Dyncomp_run () */
+static inline void
+Dyncomp_run_full (Dyncomp* self, uint32_t n_samples, float* io[], float* gain, const bool apply)
+{
+	float gmin, gmax;
+
+	/* reset min/max gain report */
+	if (self->newg) {
+		gmax       = -100.0f;
+		gmin       = 100.0f;
+		self->newg = false;
+	} else {
+		gmax = self->gmax;
+		gmin = self->gmin;
+	}
+
+	/* interpolate input gain */
+	float       g  = self->igain;
+	const float g1 = self->p_ign;
+	float       dg = g1 - g;
+	if (fabsf (dg) < 1e-5f || (g > 1.f && fabsf (dg) < 1e-3f)) {
+		g  = g1;
+		dg = 0;
+	}
+
+	/* interpolate ratio */
+	float       r  = self->ratio;
+	const float r1 = self->p_rat;
+	float       dr = r1 - r;
+	if (fabsf (dr) < 1e-5f) {
+		r  = r1;
+		dr = 0;
+	}
+
+#ifdef DARC_INSTRUMENT
+	if (dg == 0 && dr == 0) {
+		++self->n_fast;
+	} else {
+		++self->n_full;
+	}
+#endif
+
+	/* localize variables */
+	float za1 = self->za1;
+	float zr1 = self->zr1;
+	float zr2 = self->zr2;
+
+	float rms = self->rms;
+
+	const float w_rms = self->w_rms;
+	const float w_lpf = self->w_lpf;
+	const float w_att = self->w_att;
+	const float w_rel = self->w_rel;
+	const float p_thr = self->p_thr;
+
+	const float p_hold = self->hold ? 2.f * p_thr : 0.f;
+
+	const uint32_t nc  = self->n_channels;
+	const float    n_1 = self->norm_input;
+
+	DyncompFrames* fr = self->frames;
+
+	for (uint32_t j = 0; j < n_samples;) {
+		/* end of the block, or of the current meter frame */
+		uint32_t j_end = n_samples;
+		if (fr && fr->len - fr->cnt < n_samples - j) {
+			j_end = j + fr->len - fr->cnt;
+		}
+		const uint32_t j_start = j;
+
+		for (; j < j_end; ++j) {
+			/* update input gain */
+			if (dg != 0) {
+				g += w_lpf * (g1 - g);
+			}
+
+			/* Input/Key RMS */
+			float v = 0;
+			for (uint32_t i = 0; i < nc; ++i) {
+				const float x = g * io[i][j];
+				v += x * x;
+			}
+
+			v *= n_1; // normalize *= 1 / (number of channels)
+
+			/* slow moving RMS, used for GUI level meter display */
+			rms += w_rms * (v - rms); // TODO: consider reporting range; 5ms integrate, 50ms min/max readout
+
+			/* calculate signal power relative to threshold, LPF using attack time constant */
+			za1 += w_att * (p_thr + v - za1);
+
+			/* hold release */
+			const bool hold = 0 != isless (za1, p_hold);
+
+			/* Note: za1 >= p_thr; so zr1, zr2 can't become denormal */
+			if (isless (zr1, za1)) {
+				zr1 = za1;
+			} else if (!hold) {
+				zr1 -= w_rel * zr1;
+			}
+
+			if (isless (zr2, za1)) {
+				zr2 = za1;
+			} else if (!hold) {
+				zr2 += w_rel * (zr1 - zr2);
+			}
+
+			/* update ratio */
+			if (dr != 0) {
+				r += w_lpf * (r1 - r);
+			}
+
+			/* Note: expf (a * logf (b)) == powf (b, a);
+			 * however powf() is significantly slower
+			 *
+			 * Effective gain is  (zr2) ^ (-ratio).
+			 *
+			 * with 0 <= ratio <= 0.5 and
+			 * zr2 being low-pass (attack/release) filtered square of the key-signal.
+			 */
+
+			float pg = -r * logf (20.0f * zr2);
+
+			/* store min/max gain in dB, report to UI */
+			gmax = fmaxf (gmax, pg);
+			gmin = fminf (gmin, pg);
+
+			pg = g * expf (pg);
+
+			if (gain) {
+				gain[j] = pg;
+			}
+
+			if (!apply) {
+				continue;
+			}
+
+			/* apply gain factor to all channels */
+			for (uint32_t i = 0; i < nc; ++i) {
+				io[i][j] *= pg;
+			}
+		}
+
+		if (fr) {
+			fr->cnt += j_end - j_start;
+			if (fr->cnt >= fr->len) {
+				fr->cnt = 0;
+				Dyncomp_frame (fr, j_end - 1, &gmin, &gmax, rms);
+			}
+		}
+	}
+
+	/* copy back variables */
+	self->igain = g;
+	self->ratio = r;
+
+	if (!isfinite (za1)) {
+		self->za1  = 0.f;
+		self->zr1  = 0.f;
+		self->zr2  = 0.f;
+		self->newg = true; /* reset gmin/gmax next cycle */
+		++self->n_reset;
+	} else {
+		self->za1  = za1;
+		self->zr1  = zr1;
+		self->zr2  = zr2;
+		self->gmax = gmax;
+		self->gmin = gmin;
+	}
+
+	if (!isfinite (rms)) {
+		self->rms = 0.f;
+	} else if (rms > 10) {
+		self->rms = 10; // 20dBFS
+	} else {
+		self->rms = rms + 1e-12; // + denormal protection
+	}
+}
+
+/* DARC_TIER_FAST and DARC_TIER_CTRL, see Dyncomp_run () */
+static inline void
+Dyncomp_run_chunked (Dyncomp* self, uint32_t n_samples, float* io[], float* gain, const bool apply, const uint32_t tier)
+{
+	float gmin, gmax;
+
+	/* reset min/max gain report */
+	if (self->newg) {
+		gmax       = -100.0f;
+		gmin       = 100.0f;
+		self->newg = false;
+	} else {
+		gmax = self->gmax;
+		gmin = self->gmin;
+	}
+
+	/* interpolate input gain */
+	float       g  = self->igain;
+	const float g1 = self->p_ign;
+	float       dg = g1 - g;
+	if (fabsf (dg) < 1e-5f || (g > 1.f && fabsf (dg) < 1e-3f)) {
+		g  = g1;
+		dg = 0;
+	}
+
+	/* interpolate ratio */
+	float       r  = self->ratio;
+	const float r1 = self->p_rat;
+	float       dr = r1 - r;
+	if (fabsf (dr) < 1e-5f) {
+		r  = r1;
+		dr = 0;
+	}
+
+#ifdef DARC_INSTRUMENT
+	if (dg == 0 && dr == 0) {
+		++self->n_fast;
+	} else {
+		++self->n_full;
+	}
+#endif
+
+	/* localize variables */
+	float za1 = self->za1;
+	float zr1 = self->zr1;
+	float zr2 = self->zr2;
+
+	float rms = self->rms;
+
+	const float w_rms = self->w_rms;
+	const float w_lpf = self->w_lpf;
+	const float w_att = self->w_att;
+	const float w_rel = self->w_rel;
+	const float p_thr = self->p_thr;
+
+	const float p_hold = self->hold ? 2.f * p_thr : 0.f;
+
+	const uint32_t nc  = self->n_channels;
+	const float    n_1 = self->norm_input;
+
+	/* The detector runs for every sample, and stores its result for a
+	 * chunk of DARC_CTRL_STRIDE samples. The gain of the chunk is then
+	 * computed in a separate loop, which can be vectorized.
+	 * DARC_TIER_CTRL only computes the gain at the end of every chunk,
+	 * and interpolates starting with the gain of the previous chunk.
+	 * Chunks where the gain changes by more than DARC_CTRL_MAXSTEP
+	 * (attack onsets, parameter changes) are not interpolated, but
+	 * computed the same way as DARC_TIER_FAST.
+	 * This must mirror Dyncomp_run_full ().
+	 */
+	float ge[DARC_CTRL_STRIDE]; // input gain
+	float gz[DARC_CTRL_STRIDE]; // zr2
+	float gr[DARC_CTRL_STRIDE]; // ratio
+	float gk[DARC_CTRL_STRIDE]; // gain factor
+
+	DyncompFrames* fr = self->frames;
+
+	float p0      = 0; // gain at the end of the previous chunk, ln
+	float e0      = 0;
+	bool  e_valid = false;
+
+	if (tier == DARC_TIER_CTRL && zr2 > 0 && isfinite (zr2)) {
+		p0      = -r * logf (20.0f * zr2);
+		e0      = expf (p0);
+		e_valid = true;
+	}
+
+	for (uint32_t j0 = 0; j0 < n_samples; j0 += DARC_CTRL_STRIDE) {
+		const uint32_t k = n_samples - j0 < DARC_CTRL_STRIDE ? n_samples - j0 : DARC_CTRL_STRIDE;
+
+		for (uint32_t j = 0; j < k; ++j) {
+			if (dg != 0) {
+				g += w_lpf * (g1 - g);
+			}
+
+			float v = 0;
+			for (uint32_t i = 0; i < nc; ++i) {
+				const float x = g * io[i][j0 + j];
+				v += x * x;
+			}
+
+			v *= n_1;
+
+			rms += w_rms * (v - rms);
+
+			za1 += w_att * (p_thr + v - za1);
+
+			const bool hold = 0 != isless (za1, p_hold);
+
+			if (isless (zr1, za1)) {
+				zr1 = za1;
+			} else if (!hold) {
+				zr1 -= w_rel * zr1;
+			}
+
+			if (isless (zr2, za1)) {
+				zr2 = za1;
+			} else if (!hold) {
+				zr2 += w_rel * (zr1 - zr2);
+			}
+
+			if (dr != 0) {
+				r += w_lpf * (r1 - r);
+			}
+
+			ge[j] = g;
+			gz[j] = zr2;
+			gr[j] = r;
+		}
+
+		bool  interp = false;
+		float p1;
+		float e1 = 0;
+
+		if (tier == DARC_TIER_CTRL) {
+			p1     = -r * logf (20.0f * zr2);
+			e1     = expf (p1);
+			interp = e_valid && !(fabsf (p1 - p0) > DARC_CTRL_MAXSTEP);
+		} else {
+			p1 = -r * fast_logf (20.0f * zr2);
+		}
+
+		/* min/max of the gain at the end of every chunk, like Dyncomp_analyze ().
+		 * A min/max reduction prevents vectorization of the loop below. */
+		gmax = fmaxf (gmax, p1);
+		gmin = fminf (gmin, p1);
+
+		if (fr) {
+			fr->cnt += k;
+			if (fr->cnt >= fr->len) {
+				fr->cnt -= fr->len;
+				Dyncomp_frame (fr, j0 + k - 1, &gmin, &gmax, rms);
+			}
+		}
+
+		if (interp) {
+			const float de = (e1 - e0) / k;
+			for (uint32_t j = 0; j < k; ++j) {
+				gk[j] = ge[j] * (e0 + de * (j + 1));
+			}
+		} else {
+			for (uint32_t j = 0; j < k; ++j) {
+				gk[j] = ge[j] * fast_expf (-gr[j] * fast_logf (20.0f * gz[j]));
+			}
+		}
+
+		p0      = p1;
+		e0      = e1;
+		e_valid = true;
+
+		if (gain) {
+			memcpy (&gain[j0], gk, k * sizeof (float));
+		}
+
+		if (!apply) {
+			continue;
+		}
+
+		for (uint32_t i = 0; i < nc; ++i) {
+			for (uint32_t j = 0; j < k; ++j) {
+				io[i][j0 + j] *= gk[j];
+			}
+		}
+	}
+
+	/* copy back variables */
+	self->igain = g;
+	self->ratio = r;
+
+	if (!isfinite (za1)) {
+		self->za1  = 0.f;
+		self->zr1  = 0.f;
+		self->zr2  = 0.f;
+		self->newg = true; /* reset gmin/gmax next cycle */
+		++self->n_reset;
+	} else {
+		self->za1  = za1;
+		self->zr1  = zr1;
+		self->zr2  = zr2;
+		self->gmax = gmax;
+		self->gmin = gmin;
+	}
+
+	if (!isfinite (rms)) {
+		self->rms = 0.f;
+	} else if (rms > 10) {
+		self->rms = 10; // 20dBFS
+	} else {
+		self->rms = rms + 1e-12; // + denormal protection
+	}
+}
+
+/* Process n_samples. If `gain` is not NULL, the gain-factor that is
+ * applied to each sample (including input-gain) is stored there.
+ * With apply == false the audio is only analyzed and `io` is not modified.
+ * The kernel is selected by self->tier, which may change between calls.
+ */
+static inline void
+Dyncomp_run (Dyncomp* self, uint32_t n_samples, float* io[], float* gain, const bool apply)
+{
+	switch (self->tier) {
+		case DARC_TIER_FAST:
+			Dyncomp_run_chunked (self, n_samples, io, gain, apply, DARC_TIER_FAST);
+			break;
+		case DARC_TIER_CTRL:
+			Dyncomp_run_chunked (self, n_samples, io, gain, apply, DARC_TIER_CTRL);
+			break;
+		default:
+			Dyncomp_run_full (self, n_samples, io, gain, apply);
+			break;
+	}
+}
+
+static inline void
+Dyncomp_process (Dyncomp* self, uint32_t n_samples, float* io[])
+{
+	Dyncomp_run (self, n_samples, io, NULL, true);
+}
+
+/* compute the gain-factor for every sample, without modifying the input */
+static inline void
+Dyncomp_process_gain (Dyncomp* self, uint32_t n_samples, float* in[], float* gain)
+{
+	Dyncomp_run (self, n_samples, in, gain, false);
+}
+
+/* ****************************************************************************
+ * Detector-only analysis
+ */
+
+#define DARC_HIST_MIN (-20)  // dB
+#define DARC_HIST_BINS 60    // 1dB per bin, -20..+40 dB, same as the meter
+#define DARC_ANALYSIS_STRIDE 16
+
+typedef struct {
+	uint64_t n_samples;
+	uint64_t n_above; // detector above threshold
+	uint64_t n_hold;  // hold engaged (below threshold, release halted)
+	uint64_t hist[DARC_HIST_BINS];
+	double   gain_sum; // dB, sum over samples
+	float    gain_min; // dB
+	float    gain_max; // dB
+	uint32_t phase;
+} DyncompStats;
+
+static inline void
+DyncompStats_reset (DyncompStats* st)
+{
+	memset (st, 0, sizeof (DyncompStats));
+	st->gain_min = 100.f;
+	st->gain_max = -100.f;
+}
+
+/* Run the level detector and envelope only, and collect statistics.
+ * The gain is evaluated every DARC_ANALYSIS_STRIDE samples, and the
+ * input is not modified. This must mirror Dyncomp_run().
+ */
+static inline void
+Dyncomp_analyze (Dyncomp* self, uint32_t n_samples, float* in[], DyncompStats* st)
+{
+	float       g  = self->igain;
+	const float g1 = self->p_ign;
+	float       dg = g1 - g;
+	if (fabsf (dg) < 1e-5f || (g > 1.f && fabsf (dg) < 1e-3f)) {
+		g  = g1;
+		dg = 0;
+	}
+
+	float       r  = self->ratio;
+	const float r1 = self->p_rat;
+	float       dr = r1 - r;
+	if (fabsf (dr) < 1e-5f) {
+		r  = r1;
+		dr = 0;
+	}
+
+	float za1 = self->za1;
+	float zr1 = self->zr1;
+	float zr2 = self->zr2;
+
+	const float w_lpf = self->w_lpf;
+	const float w_att = self->w_att;
+	const float w_rel = self->w_rel;
+	const float p_thr = self->p_thr;
+
+	const float p_hold  = self->hold ? 2.f * p_thr : 0.f;
+	const float p_above = 2.f * p_thr;
+
+	const uint32_t nc  = self->n_channels;
+	const float    n_1 = self->norm_input;
+
+	uint32_t phase   = st->phase;
+	uint64_t n_above = 0;
+	uint64_t n_hold  = 0;
+
+	for (uint32_t j = 0; j < n_samples; ++j) {
+		if (dg != 0) {
+			g += w_lpf * (g1 - g);
+		}
+
+		float v = 0;
+		for (uint32_t i = 0; i < nc; ++i) {
+			const float x = g * in[i][j];
+			v += x * x;
+		}
+		v *= n_1;
+
+		za1 += w_att * (p_thr + v - za1);
+
+		const bool hold = 0 != isless (za1, p_hold);
+
+		n_above += isless (za1, p_above) ? 0 : 1;
+		n_hold += hold ? 1 : 0;
+
+		if (isless (zr1, za1)) {
+			zr1 = za1;
+		} else if (!hold) {
+			zr1 -= w_rel * zr1;
+		}
+
+		if (isless (zr2, za1)) {
+			zr2 = za1;
+		} else if (!hold) {
+			zr2 += w_rel * (zr1 - zr2);
+		}
+
+		if (dr != 0) {
+			r += w_lpf * (r1 - r);
+		}
+
+		if (phase == 0) {
+			phase = DARC_ANALYSIS_STRIDE;
+			/* gain in dB: 20 / log(10) */
+			const float pg = -8.68589f * r * logf (20.0f * zr2);
+			if (isfinite (pg)) {
+				int bin = floorf (pg) - DARC_HIST_MIN;
+				bin     = bin < 0 ? 0 : (bin >= DARC_HIST_BINS ? DARC_HIST_BINS - 1 : bin);
+				st->hist[bin] += DARC_ANALYSIS_STRIDE;
+				st->gain_sum += pg * DARC_ANALYSIS_STRIDE;
+				st->gain_min = fminf (st->gain_min, pg);
+				st->gain_max = fmaxf (st->gain_max, pg);
+			}
+		}
+		--phase;
+	}
+
+	st->phase = phase;
+	st->n_samples += n_samples;
+	st->n_above += n_above;
+	st->n_hold += n_hold;
+
+	self->igain = g;
+	self->ratio = r;
+
+	if (!isfinite (za1)) {
+		self->za1 = 0.f;
+		self->zr1 = 0.f;
+		self->zr2 = 0.f;
+	} else {
+		self->za1 = za1;
+		self->zr1 = zr1;
+		self->zr2 = zr2;
+	}
+}
+
+/* ****************************************************************************
+ * Envelope state snapshot
+ *
+ * The snapshot captures everything that evolves over time (interpolated
+ * gain and ratio, detector envelope and level meter). Together with the
+ * parameters it allows to resume processing at a given position without
+ * pre-roll, e.g. after a relocate or when rendering a region.
+ */
+
+#define DARC_STATE_VERSION 1
+
+typedef struct {
+	uint32_t version;
+	float    igain;
+	float    ratio;
+	float    za1;
+	float    zr1;
+	float    zr2;
+	float    rms;
+} DyncompState;
+
+static inline void
+Dyncomp_get_state (const Dyncomp* self, DyncompState* s)
+{
+	s->version = DARC_STATE_VERSION;
+	s->igain   = self->igain;
+	s->ratio   = self->ratio;
+	s->za1     = self->za1;
+	s->zr1     = self->zr1;
+	s->zr2     = self->zr2;
+	s->rms     = self->rms;
+}
+
+static inline bool
+Dyncomp_set_state (Dyncomp* self, const DyncompState* s)
+{
+	if (s->version != DARC_STATE_VERSION) {
+		return false;
+	}
+	if (!isfinite (s->za1) || !isfinite (s->zr1) || !isfinite (s->zr2)) {
+		return false;
+	}
+	self->igain = s->igain;
+	self->ratio = s->ratio;
+	self->za1   = s->za1;
+	self->zr1   = s->zr1;
+	self->zr2   = s->zr2;
+	self->rms   = s->rms;
+	self->newg  = true;
+	return true;
+}
+
+#endif
@@ -0,0 +1,71 @@
+/* darc.lv2 -- vectorizable log/exp approximations
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_FASTMATH_H
+#define _DARC_FASTMATH_H
+
+/* Branch-free replacements for logf() and expf(), which unlike the libm
+ * calls can be inlined and auto-vectorized. For 1e-10 < x < 1e10 the
+ * absolute error of log is below 2e-6 (for larger |log(x)| the rounding of
+ * the result dominates), and for |x| < 87 the relative error of exp is
+ * below 5e-6. There is no special handling of NaN, inf, zero or
+ * denormals.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+static inline float
+fast_logf (float x)
+{
+	int32_t i;
+	memcpy (&i, &x, sizeof (float));
+
+	/* x = m * 2^e, with m in [sqrt(.5), sqrt(2)) */
+	int32_t e = ((i - 0x3f3504f3) >> 23);
+	i -= (int32_t)((uint32_t)e << 23); // e may be negative
+
+	float m;
+	memcpy (&m, &i, sizeof (float));
+
+	/* log(m) = 2 atanh (t) */
+	const float t  = (m - 1.f) / (m + 1.f);
+	const float t2 = t * t;
+	const float p  = 2.f + t2 * (0.666666667f + t2 * (0.4f + t2 * (0.285714286f + t2 * 0.222222222f)));
+
+	return t * p + 0.693147181f * (float)e;
+}
+
+static inline float
+fast_expf (float x)
+{
+	x = x < -87.f ? -87.f : (x > 88.f ? 88.f : x);
+
+	/* e^x = 2^n * e^r, |r| <= ln(2)/2 */
+	const float n = (float)(int32_t)(x * 1.442695041f + (x < 0 ? -.5f : .5f));
+	const float r = x - n * 0.693147181f;
+
+	const float p = 1.f + r * (1.f + r * (.5f + r * (0.166666667f + r * (0.041666667f + r * (0.008333333f + r * 0.001388889f)))));
+
+	int32_t i = ((int32_t)n + 127) << 23;
+	float   s;
+	memcpy (&s, &i, sizeof (float));
+	return p * s;
+}
+
+#endif
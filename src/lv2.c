@@ -27,18 +27,54 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "capture.h"
 #include "darc.h"
+#include "dyncomp.h"
+#include "trace.h"
 
 #ifdef HAVE_LV2_1_18_6
+#include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+#include <lv2/atom/util.h>
 #include <lv2/core/lv2.h>
+#include <lv2/log/log.h>
+#include <lv2/urid/urid.h>
+#include <lv2/worker/worker.h>
 #else
+#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
+#include <lv2/lv2plug.in/ns/ext/log/log.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
 #include <lv2/lv2plug.in/ns/lv2core/lv2.h>
 #endif
 
 #ifdef DISPLAY_INTERFACE
 #include "lv2_rgext.h"
-#include <cairo/cairo.h>
-#include <pango/pangocairo.h>
+#include <pthread.h>
+#endif
+
+#ifdef DARC_INSTRUMENT
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define darc_cycles() __rdtsc ()
+#else
+#include <time.h>
+static inline uint64_t
+darc_cycles (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
 #endif
 
 #ifndef MAX
@@ -49,381 +85,604 @@
 #define MIN(A, B) ((A) < (B)) ? (A) : (B)
 #endif
 
+#define DARC_MAX_FRAMES 64 // meter frames per run (), 320ms
+
 /* ****************************************************************************/
 
 typedef struct {
-	float sample_rate;
+	LV2_URID atom_Float;
+	LV2_URID ui_on;
+	LV2_URID ui_off;
+	LV2_URID meters;
+	LV2_URID interval;
+	LV2_URID frames;
+	LV2_URID log_Note;
+	LV2_URID log_Warning;
+} DarcURIs;
 
-	uint32_t n_channels;
-	float    norm_input;
-
-	float ratio;
-	float p_rat;
+typedef struct {
+	float* _port[DARC_LAST];
 
-	bool hold;
+	const LV2_Atom_Sequence* control;
+	LV2_Atom_Sequence*       notify;
 
-	float igain;
-	float p_ign;
-	float l_ign;
+	Dyncomp dyncomp;
 
-	float p_thr;
-	float l_thr;
+	float _gmin;
+	float _gmax;
+	float _rms;
 
-	float w_att;
-	float w_rel;
-	float t_att;
-	float t_rel;
+	uint32_t samplecnt;
+	uint32_t sampletme; // 50ms
 
-	float za1;
-	float zr1;
-	float zr2;
+	/* meter stream to the UI */
+	LV2_URID_Map*  map;
+	LV2_Atom_Forge forge;
+	DarcURIs       uris;
+	uint32_t       ui_count; // subscribed UIs
+	DyncompFrames  meter;
+	float          frames[3 * DARC_MAX_FRAMES];
+
+	/* min/max of all frames since the control ports were updated */
+	uint32_t acc_n;
+	float    acc_gmin;
+	float    acc_gmax;
+	float    acc_rms;
+
+	/* event trace, formatted by the worker or the host's main loop */
+	DarcTrace            trace;
+	LV2_Log_Log*         log;
+	LV2_Worker_Schedule* schedule;
+	bool                 trace_busy; // work is scheduled
+	bool                 trace_sync; // trace_ctrl is valid
+	float                trace_ctrl[DARC_GMIN];
+	uint32_t             trace_resets;
+	uint64_t             trace_pos;
+	double               rate;
+
+	/* input capture, the ring is attached by the host */
+	DarcCapture* capture;
+	DarcCapture* capture_prev; // last ring seen by run ()
+	bool         capture_sync; // the state snapshot was written
+
+	/* CPU budget governor */
+	float    gov_budget;               // share of the period, 0: off
+	float    gov_load;                 // share of the period used by run (), smoothed
+	float    gov_cost[DARC_TIER_LAST]; // sec/sample of every kernel, smoothed
+	uint32_t gov_hold;                 // samples until the tier may change again
+	uint32_t gov_calm;                 // samples the next better tier fits the budget
+
+#ifdef DARC_INSTRUMENT
+	/* DSP cost, totals and last complete window */
+	DarcInstrumentStats inst;
+	uint32_t            win_len; // samples
+	uint32_t            win_calls;
+	uint64_t            win_samples;
+	uint64_t            win_cycles;
+	uint64_t            win_max;
+	/* copy of inst for other threads, seqlock */
+	DarcInstrumentStats inst_pub;
+	uint32_t            inst_seq;
+#endif
 
-	bool  newg;
-	float gmax;
-	float gmin;
+#ifdef DISPLAY_INTERFACE
+	LV2_Inline_Display_Image_Surface surf;
+	uint32_t*                        display; // ARGB32
+	LV2_Inline_Display*              queue_draw;
+	struct _DplBackground*           bg;
+	uint32_t                         w, h;
+	int                              bar_x0, bar_x1; // painted columns
+	float                            bar_o, bar_s;   // dB to pixel, set by render
+	float                            ui_gmin;
+	float                            ui_gmax;
+#endif
 
-	float rms;
-	float w_rms;
-	float w_lpf;
+} Darc;
 
-} Dyncomp;
+#ifdef DISPLAY_INTERFACE
+static void dpl_background_unref (struct _DplBackground*);
 
-static inline void
-Dyncomp_reset (Dyncomp* self)
+/* test if the gain-bar moved by at least a pixel since it was last drawn */
+static bool
+dpl_moved (const Darc* self)
 {
-	self->za1  = 0.f;
-	self->zr1  = 0.f;
-	self->zr2  = 0.f;
-	self->rms  = 0.f;
-	self->gmin = 0.f;
-	self->gmax = 0.f;
-	self->newg = true;
+	const float o = self->bar_o;
+	const float s = self->bar_s;
+	if (s == 0) {
+		return self->ui_gmin != self->_gmin || self->ui_gmax != self->_gmax;
+	}
+	return rintf (o + s * self->ui_gmin) != rintf (o + s * self->_gmin)
+	       || rintf (o + s * self->ui_gmax) != rintf (o + s * self->_gmax);
 }
+#endif
 
-static inline void
-Dyncomp_set_ratio (Dyncomp* self, float r)
+static LV2_Handle
+instantiate (const LV2_Descriptor*     descriptor,
+             double                    rate,
+             const char*               bundle_path,
+             const LV2_Feature* const* features)
 {
-	self->p_rat = 0.5f * r;
-}
+	Darc* self = (Darc*)calloc (1, sizeof (Darc));
 
-static inline void
-Dyncomp_set_inputgain (Dyncomp* self, float g)
-{
-	if (g == self->l_ign) {
-		return;
+	uint32_t n_channels;
+
+	if (!strcmp (descriptor->URI, DARC_URI "mono")) {
+		n_channels = 1;
+	} else if (!strcmp (descriptor->URI, DARC_URI "stereo")) {
+		n_channels = 2;
+	} else {
+		free (self);
+		return NULL;
 	}
-	self->l_ign = g;
-#ifdef __USE_GNU
-	self->p_ign = exp10f (0.05f * g);
-#else
-	self->p_ign = powf (10.0f, 0.05f * g);
+
+	for (int i = 0; features[i]; ++i) {
+		if (!strcmp (features[i]->URI, LV2_URID__map)) {
+			self->map = (LV2_URID_Map*)features[i]->data;
+		}
+		if (!strcmp (features[i]->URI, LV2_LOG__log)) {
+			self->log = (LV2_Log_Log*)features[i]->data;
+		}
+		if (!strcmp (features[i]->URI, LV2_WORKER__schedule)) {
+			self->schedule = (LV2_Worker_Schedule*)features[i]->data;
+		}
+#ifdef DISPLAY_INTERFACE
+		if (!strcmp (features[i]->URI, LV2_INLINEDISPLAY__queue_draw)) {
+			self->queue_draw = (LV2_Inline_Display*)features[i]->data;
+		}
 #endif
-}
+	}
 
-static inline void
-Dyncomp_set_threshold (Dyncomp* self, float t)
-{
-	if (t == self->l_thr) {
-		return;
+	if (self->map) {
+		LV2_URID_Map* map = self->map;
+		lv2_atom_forge_init (&self->forge, map);
+		self->uris.atom_Float  = map->map (map->handle, LV2_ATOM__Float);
+		self->uris.ui_on       = map->map (map->handle, DARC__ui_on);
+		self->uris.ui_off      = map->map (map->handle, DARC__ui_off);
+		self->uris.meters      = map->map (map->handle, DARC__meters);
+		self->uris.interval    = map->map (map->handle, DARC__interval);
+		self->uris.frames      = map->map (map->handle, DARC__frames);
+		self->uris.log_Note    = map->map (map->handle, LV2_LOG__Note);
+		self->uris.log_Warning = map->map (map->handle, LV2_LOG__Warning);
+	} else {
+		self->log = NULL; // log types are URIDs
 	}
-	self->l_thr = t;
-	/* Note that this is signal-power, hence .5 * 10^(x/10) */
-#ifdef __USE_GNU
-	self->p_thr = 0.5f * exp10f (0.1f * t);
-#else
-	self->p_thr = 0.5f * powf (10.0f, 0.1f * t);
+
+	Dyncomp_init (&self->dyncomp, rate, n_channels);
+	self->sampletme = ceilf (rate * 0.05); // 50ms
+	self->samplecnt = self->sampletme;
+	self->meter.len = ceilf (rate * DARC_FRAME_MS / 1000.f);
+	self->meter.max = DARC_MAX_FRAMES;
+	self->meter.val = self->frames;
+	self->rate      = rate;
+
+	self->gov_budget = 0; // off until a host sets a budget
+#ifdef DARC_INSTRUMENT
+	self->win_len = rate; // 1 sec
 #endif
-}
 
-static inline void
-Dyncomp_set_hold (Dyncomp* self, bool hold)
-{
-	self->hold = hold;
+	return (LV2_Handle)self;
 }
 
-static inline void
-Dyncomp_set_attack (Dyncomp* self, float a)
+static void
+connect_port (LV2_Handle instance,
+              uint32_t   port,
+              void*      data)
 {
-	if (a == self->t_att) {
-		return;
-	}
-	self->t_att = a;
-	self->w_att = 0.5f / (self->sample_rate * a);
-}
+	Darc* self = (Darc*)instance;
 
-static inline void
-Dyncomp_set_release (Dyncomp* self, float r)
-{
-	if (r == self->t_rel) {
-		return;
+	if (self->dyncomp.n_channels == 1 && port >= DARC_INPUT1) {
+		port += DARC_CONTROL - DARC_INPUT1;
 	}
-	self->t_rel = r;
-	self->w_rel = 3.5f / (self->sample_rate * r);
-}
 
-static inline void
-Dyncomp_get_gain (Dyncomp* self, float* gmin, float* gmax, float* rms)
-{
-	*gmin = self->gmin * 8.68589f; /* 20 / log(10) */
-	*gmax = self->gmax * 8.68589f;
-	if (self->rms > 1e-8f) {
-		*rms = 10.f * log10f (2.f * self->rms);
-	} else {
-		*rms = -80;
+	switch (port) {
+		case DARC_CONTROL:
+			self->control = (const LV2_Atom_Sequence*)data;
+			break;
+		case DARC_NOTIFY:
+			self->notify = (LV2_Atom_Sequence*)data;
+			break;
+		default:
+			if (port < DARC_LAST) {
+				self->_port[port] = (float*)data;
+			}
+			break;
 	}
-	self->newg = true;
 }
 
-static inline void
-Dyncomp_init (Dyncomp* self, float sample_rate, uint32_t n_channels)
+static void
+activate (LV2_Handle instance)
 {
-	self->sample_rate = sample_rate;
-	self->n_channels  = n_channels;
-	self->norm_input  = 1.f / n_channels;
-
-	self->ratio = 0.f;
-	self->p_rat = 0.f;
-
-	self->igain = 1.f;
-	self->p_ign = 1.f;
-	self->l_ign = 0.f;
-
-	self->p_thr = 0.05f;
-	self->l_thr = -10.f;
-
-	self->hold = false;
-
-	self->t_att = 0.f;
-	self->t_rel = 0.f;
+	Darc* self = (Darc*)instance;
+	Dyncomp_reset (&self->dyncomp);
+	self->samplecnt = self->sampletme;
+	self->meter.cnt = 0;
+	self->meter.n   = 0;
+	self->acc_n     = 0;
 
-	self->w_rms = 5.f / sample_rate;
-	self->w_lpf = 160.f / sample_rate;
+	self->trace_sync   = false;
+	self->capture_sync = false;
 
-	Dyncomp_set_attack (self, 0.01f);
-	Dyncomp_set_release (self, 0.03f);
-	Dyncomp_reset (self);
+	self->dyncomp.tier = DARC_TIER_FULL;
+	self->gov_load     = 0;
+	self->gov_hold     = 0;
+	self->gov_calm     = 0;
 }
 
-static inline void
-Dyncomp_process (Dyncomp* self, uint32_t n_samples, float* io[])
-{
-	float gmin, gmax;
+/* ****************************************************************************
+ * meter stream to the UI
+ */
 
-	/* reset min/max gain report */
-	if (self->newg) {
-		gmax       = -100.0f;
-		gmin       = 100.0f;
-		self->newg = false;
-	} else {
-		gmax = self->gmax;
-		gmin = self->gmin;
+static void
+ui_subscription (Darc* self)
+{
+	if (!self->control || !self->map) {
+		return;
 	}
-
-	/* interpolate input gain */
-	float       g  = self->igain;
-	const float g1 = self->p_ign;
-	float       dg = g1 - g;
-	if (fabsf (dg) < 1e-5f || (g > 1.f && fabsf (dg) < 1e-3f)) {
-		g  = g1;
-		dg = 0;
+	LV2_ATOM_SEQUENCE_FOREACH (self->control, ev)
+	{
+		const LV2_Atom_Object* obj = (const LV2_Atom_Object*)&ev->body;
+		if (!lv2_atom_forge_is_object_type (&self->forge, obj->atom.type)) {
+			continue;
+		}
+		if (obj->body.otype == self->uris.ui_on) {
+			if (self->ui_count++ == 0) {
+				self->meter.cnt = 0;
+				self->meter.n   = 0;
+			}
+		} else if (obj->body.otype == self->uris.ui_off && self->ui_count > 0) {
+			--self->ui_count;
+		}
 	}
+}
 
-	/* interpolate ratio */
-	float       r  = self->ratio;
-	const float r1 = self->p_rat;
-	float       dr = r1 - r;
-	if (fabsf (dr) < 1e-5f) {
-		r  = r1;
-		dr = 0;
+/* send the frames that Dyncomp_run () collected, and accumulate them
+ * for the control ports */
+static void
+emit_frames (Darc* self)
+{
+	LV2_Atom_Forge*      forge = &self->forge;
+	LV2_Atom_Forge_Frame frame;
+
+	for (uint32_t i = 0; i < self->meter.n; ++i) {
+		float* f = &self->frames[3 * i];
+
+		f[0] = fminf (40.f, fmaxf (-20.f, f[0]));
+		f[1] = fminf (40.f, fmaxf (-20.f, f[1]));
+		f[2] = fminf (10.f, fmaxf (-80.f, f[2]));
+
+		if (self->acc_n++ == 0) {
+			self->acc_gmin = f[0];
+			self->acc_gmax = f[1];
+		} else {
+			self->acc_gmin = fminf (self->acc_gmin, f[0]);
+			self->acc_gmax = fmaxf (self->acc_gmax, f[1]);
+		}
+		self->acc_rms = f[2];
 	}
 
-	/* localize variables */
-	float za1 = self->za1;
-	float zr1 = self->zr1;
-	float zr2 = self->zr2;
+	if (lv2_atom_forge_frame_time (forge, self->meter.first)) {
+		lv2_atom_forge_object (forge, &frame, 0, self->uris.meters);
+		lv2_atom_forge_key (forge, self->uris.interval);
+		lv2_atom_forge_int (forge, self->meter.len);
+		lv2_atom_forge_key (forge, self->uris.frames);
+		lv2_atom_forge_vector (forge, sizeof (float), self->uris.atom_Float, 3 * self->meter.n, self->frames);
+		lv2_atom_forge_pop (forge, &frame);
+	}
+	self->meter.n = 0;
+}
 
-	float rms = self->rms;
+#ifdef DARC_INSTRUMENT
+/* ****************************************************************************
+ * DSP cost counters
+ */
 
-	const float w_rms = self->w_rms;
-	const float w_lpf = self->w_lpf;
-	const float w_att = self->w_att;
-	const float w_rel = self->w_rel;
-	const float p_thr = self->p_thr;
+static void
+instrument (Darc* self, uint32_t n_samples, uint64_t cycles)
+{
+	DarcInstrumentStats* st = &self->inst;
+	Dyncomp*             d  = &self->dyncomp;
+
+	++st->calls;
+	st->samples += n_samples;
+	st->fast_blocks += d->n_fast;
+	st->full_blocks += d->n_full;
+	st->resets = d->n_reset;
+	d->n_fast  = 0;
+	d->n_full  = 0;
+
+	++self->win_calls;
+	self->win_samples += n_samples;
+	self->win_cycles += cycles;
+	if (cycles > self->win_max) {
+		self->win_max = cycles;
+	}
 
-	const float p_hold = self->hold ? 2.f * p_thr : 0.f;
+	if (self->win_samples >= self->win_len) {
+		st->win_calls  = self->win_calls;
+		st->cycles_max = self->win_max;
+		st->cycles_avg = self->win_cycles / (double)self->win_calls;
+		st->cycles_spl = self->win_cycles / (double)self->win_samples;
+
+		self->win_calls   = 0;
+		self->win_samples = 0;
+		self->win_cycles  = 0;
+		self->win_max     = 0;
+
+		/* the sequence number is odd while writing */
+		__atomic_store_n (&self->inst_seq, self->inst_seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence (__ATOMIC_RELEASE);
+		self->inst_pub = *st;
+		__atomic_store_n (&self->inst_seq, self->inst_seq + 1, __ATOMIC_RELEASE);
+	}
 
-	const uint32_t nc  = self->n_channels;
-	const float    n_1 = self->norm_input;
+	if (self->_port[DARC_CYCLES_SPL]) {
+		*self->_port[DARC_CYCLES_SPL] = st->cycles_spl;
+	}
+	if (self->_port[DARC_CYCLES_MAX]) {
+		*self->_port[DARC_CYCLES_MAX] = st->cycles_max;
+	}
+}
 
-	for (uint32_t j = 0; j < n_samples; ++j) {
-		/* update input gain */
-		if (dg != 0) {
-			g += w_lpf * (g1 - g);
+static int
+get_stats (void* instance, DarcInstrumentStats* stats)
+{
+	Darc* self = (Darc*)instance;
+	for (int i = 0; i < 16; ++i) {
+		const uint32_t seq = __atomic_load_n (&self->inst_seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			continue;
 		}
-
-		/* Input/Key RMS */
-		float v = 0;
-		for (uint32_t i = 0; i < nc; ++i) {
-			const float x = g * io[i][j];
-			v += x * x;
+		*stats = self->inst_pub;
+		__atomic_thread_fence (__ATOMIC_ACQUIRE);
+		if (__atomic_load_n (&self->inst_seq, __ATOMIC_RELAXED) == seq) {
+			return 1;
 		}
+	}
+	return 0;
+}
+#endif
 
-		v *= n_1; // normalize *= 1 / (number of channels)
+/* ****************************************************************************
+ * event trace
+ */
 
-		/* slow moving RMS, used for GUI level meter display */
-		rms += w_rms * (v - rms); // TODO: consider reporting range; 5ms integrate, 50ms min/max readout
+static void
+trace_log (Darc* self, bool warn, const char* msg)
+{
+	if (self->log) {
+		self->log->printf (self->log->handle,
+		                   warn ? self->uris.log_Warning : self->uris.log_Note,
+		                   "x42-darc: %s\n", msg);
+	} else {
+		fprintf (stderr, "x42-darc: %s\n", msg);
+	}
+}
 
-		/* calculate signal power relative to threshold, LPF using attack time constant */
-		za1 += w_att * (p_thr + v - za1);
+/* smallest change of a control input between two cycles that is traced */
+static const float trace_jump[DARC_GMIN] = {
+	0, 0, 3.f, 3.f, .1f, .01f, .3f
+};
 
-		/* hold release */
-		const bool hold = 0 != isless (za1, p_hold);
+static void
+trace_controls (Darc* self)
+{
+	for (uint32_t p = 0; p < DARC_GMIN; ++p) {
+		const float v = *self->_port[p];
+		const float o = self->trace_ctrl[p];
 
-		/* Note: za1 >= p_thr; so zr1, zr2 can't become denormal */
-		if (isless (zr1, za1)) {
-			zr1 = za1;
-		} else if (!hold) {
-			zr1 -= w_rel * zr1;
-		}
+		self->trace_ctrl[p] = v;
 
-		if (isless (zr2, za1)) {
-			zr2 = za1;
-		} else if (!hold) {
-			zr2 += w_rel * (zr1 - zr2);
+		if (!self->trace_sync) {
+			continue;
 		}
-
-		/* update ratio */
-		if (dr != 0) {
-			r += w_lpf * (r1 - r);
+		if (p == DARC_ENABLE || p == DARC_HOLD) {
+			if ((v > 0) != (o > 0)) {
+				const uint32_t type = p == DARC_ENABLE ? DARC_TRACE_ENABLE : DARC_TRACE_PARAM;
+				darc_trace_push (&self->trace, type, p, self->trace_pos, o > 0, v > 0);
+			}
+		} else if (!(fabsf (v - o) < trace_jump[p]) && v != o) {
+			darc_trace_push (&self->trace, DARC_TRACE_PARAM, p, self->trace_pos, o, v);
 		}
+	}
+	self->trace_sync = true;
+}
 
-		/* Note: expf (a * logf (b)) == powf (b, a);
-		 * however powf() is significantly slower
-		 *
-		 * Effective gain is  (zr2) ^ (-ratio).
-		 *
-		 * with 0 <= ratio <= 0.5 and
-		 * zr2 being low-pass (attack/release) filtered square of the key-signal.
-		 */
-
-		float pg = -r * logf (20.0f * zr2);
-
-		/* store min/max gain in dB, report to UI */
-		gmax = fmaxf (gmax, pg);
-		gmin = fminf (gmin, pg);
+static void
+trace_cycle (Darc* self, uint32_t n_samples)
+{
+	const uint32_t n_reset = self->dyncomp.n_reset;
+	if (n_reset != self->trace_resets) {
+		darc_trace_push (&self->trace, DARC_TRACE_RESET, 0, self->trace_pos, n_reset - self->trace_resets, 0);
+		self->trace_resets = n_reset;
+	}
 
-		pg = g * expf (pg);
+	self->trace_pos += n_samples;
 
-		/* apply gain factor to all channels */
-		for (uint32_t i = 0; i < nc; ++i) {
-			io[i][j] *= pg;
+	if (self->schedule && darc_trace_pending (&self->trace) && !__atomic_load_n (&self->trace_busy, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n (&self->trace_busy, true, __ATOMIC_RELAXED);
+		if (self->schedule->schedule_work (self->schedule->handle, 1, "") != LV2_WORKER_SUCCESS) {
+			__atomic_store_n (&self->trace_busy, false, __ATOMIC_RELAXED);
 		}
 	}
+}
 
-	/* copy back variables */
-	self->igain = g;
-	self->ratio = r;
+/* format and log pending events, not realtime safe */
+static void
+trace_drain (Darc* self)
+{
+	DarcTraceEvent ev;
+	char           msg[128];
 
-	if (!isfinite (za1)) {
-		self->za1  = 0.f;
-		self->zr1  = 0.f;
-		self->zr2  = 0.f;
-		self->newg = true; /* reset gmin/gmax next cycle */
-	} else {
-		self->za1  = za1;
-		self->zr1  = zr1;
-		self->zr2  = zr2;
-		self->gmax = gmax;
-		self->gmin = gmin;
+	while (darc_trace_pop (&self->trace, &ev)) {
+		darc_trace_format (&ev, self->rate, msg, sizeof (msg));
+		trace_log (self, ev.type == DARC_TRACE_RESET, msg);
 	}
 
-	if (!isfinite (rms)) {
-		self->rms = 0.f;
-	} else if (rms > 10) {
-		self->rms = 10; // 20dBFS
-	} else {
-		self->rms = rms + 1e-12; // + denormal protection
+	/* events are dropped when the ring is full, after the ones above */
+	const uint32_t lost = darc_trace_lost (&self->trace);
+	if (lost > 0) {
+		snprintf (msg, sizeof (msg), "%u trace event(s) lost", lost);
+		trace_log (self, true, msg);
 	}
 }
 
-/* ****************************************************************************/
-
-typedef struct {
-	float* _port[DARC_LAST];
+static LV2_Worker_Status
+trace_work (LV2_Handle                  instance,
+            LV2_Worker_Respond_Function respond,
+            LV2_Worker_Respond_Handle   handle,
+            uint32_t                    size,
+            const void*                 data)
+{
+	Darc* self = (Darc*)instance;
+	trace_drain (self);
+	__atomic_store_n (&self->trace_busy, false, __ATOMIC_RELEASE);
+	return LV2_WORKER_SUCCESS;
+}
 
-	Dyncomp dyncomp;
+static LV2_Worker_Status
+trace_work_response (LV2_Handle instance, uint32_t size, const void* data)
+{
+	return LV2_WORKER_SUCCESS;
+}
 
-	float _gmin;
-	float _gmax;
-	float _rms;
+/* ****************************************************************************
+ * CPU budget governor
+ *
+ * The time that run () takes is compared to the duration of the block.
+ * If the smoothed share exceeds the budget, the next cheaper kernel is
+ * used. A kernel is restored once its predicted load stayed below half
+ * the budget for DARC_GOV_RECOVER seconds. All kernels share the filter
+ * state and the gain at block boundaries, a change does not click.
+ * The governor is off unless a host sets a budget.
+ */
 
-	uint32_t samplecnt;
-	uint32_t sampletme; // 50ms
+#define DARC_GOV_HOLD 0.1f   // sec, minimum time between changes
+#define DARC_GOV_RECOVER 1.f // sec
 
-#ifdef DISPLAY_INTERFACE
-	LV2_Inline_Display_Image_Surface surf;
-	cairo_surface_t*                 display;
-	LV2_Inline_Display*              queue_draw;
-	cairo_pattern_t*                 mpat;
-	cairo_pattern_t*                 cpat;
-	uint32_t                         w, h;
-	float                            ui_gmin;
-	float                            ui_gmax;
+static inline double
+gov_time (void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER t, f;
+	QueryPerformanceCounter (&t);
+	QueryPerformanceFrequency (&f);
+	return t.QuadPart / (double)f.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
 #endif
+}
 
-} Darc;
+static void
+gov_set_budget (void* instance, float budget)
+{
+	Darc* self = (Darc*)instance;
+	__atomic_store (&self->gov_budget, &budget, __ATOMIC_RELAXED);
+}
 
-static LV2_Handle
-instantiate (const LV2_Descriptor*     descriptor,
-             double                    rate,
-             const char*               bundle_path,
-             const LV2_Feature* const* features)
+/* called with a budget > 0 */
+static void
+governor (Darc* self, float budget, uint32_t n_samples, double elapsed)
 {
-	Darc* self = (Darc*)calloc (1, sizeof (Darc));
+	Dyncomp*       d    = &self->dyncomp;
+	const uint32_t tier = d->tier;
 
-	uint32_t n_channels;
+	if (n_samples == 0) {
+		return;
+	}
 
-	if (!strcmp (descriptor->URI, DARC_URI "mono")) {
-		n_channels = 1;
-	} else if (!strcmp (descriptor->URI, DARC_URI "stereo")) {
-		n_channels = 2;
+	/* cost of the active kernel */
+	const float cost = elapsed / n_samples;
+	if (self->gov_cost[tier] > 0) {
+		self->gov_cost[tier] += .125f * (cost - self->gov_cost[tier]);
 	} else {
-		free (self);
-		return NULL;
+		self->gov_cost[tier] = cost;
 	}
 
-#ifdef DISPLAY_INTERFACE
-	for (int i = 0; features[i]; ++i) {
-		if (!strcmp (features[i]->URI, LV2_INLINEDISPLAY__queue_draw)) {
-			self->queue_draw = (LV2_Inline_Display*)features[i]->data;
+	/* a single late block, e.g. after preemption, does not change the tier */
+	const float load = fminf (2.f * budget, elapsed * self->rate / n_samples);
+	self->gov_load += .125f * (load - self->gov_load);
+
+	if (self->gov_hold > n_samples) {
+		self->gov_hold -= n_samples;
+		return;
+	}
+	self->gov_hold = 0;
+
+	if (self->gov_load > budget && tier + 1 < DARC_TIER_LAST) {
+		d->tier        = tier + 1;
+		self->gov_hold = self->rate * DARC_GOV_HOLD;
+		self->gov_calm = 0;
+		if (self->gov_cost[tier + 1] > 0) {
+			self->gov_load *= fminf (1.f, self->gov_cost[tier + 1] / self->gov_cost[tier]);
 		}
+		return;
 	}
-#endif
 
-	Dyncomp_init (&self->dyncomp, rate, n_channels);
-	self->sampletme = ceilf (rate * 0.05); // 50ms
-	self->samplecnt = self->sampletme;
+	if (tier == DARC_TIER_FULL) {
+		return;
+	}
 
-	return (LV2_Handle)self;
+	/* the cost of the better kernel may have been measured under load */
+	const float ratio = fminf (4.f, fmaxf (1.f, self->gov_cost[tier - 1] / self->gov_cost[tier]));
+	const float load1 = self->gov_load * ratio;
+
+	if (load1 < .5f * budget) {
+		self->gov_calm += n_samples;
+	} else {
+		self->gov_calm = 0;
+	}
+
+	if (self->gov_calm >= self->rate * DARC_GOV_RECOVER) {
+		d->tier                  = tier - 1;
+		self->gov_load           = load1;
+		self->gov_hold           = self->rate * DARC_GOV_HOLD;
+		self->gov_calm           = 0;
+		self->gov_cost[tier - 1] = 0; // measure again
+	}
 }
 
+/* ****************************************************************************
+ * input capture
+ */
+
 static void
-connect_port (LV2_Handle instance,
-              uint32_t   port,
-              void*      data)
+capture_attach (void* instance, DarcCapture* cap)
 {
 	Darc* self = (Darc*)instance;
-	if (port < DARC_LAST) {
-		self->_port[port] = (float*)data;
-	}
+	__atomic_store_n (&self->capture, cap, __ATOMIC_RELEASE);
 }
 
-static void
-activate (LV2_Handle instance)
+/* copy the input (before it is processed in-place) and parameters */
+static int64_t
+capture_begin (Darc* self, DarcCapture* cap, float* const* in, uint32_t n_samples)
 {
-	Darc* self = (Darc*)instance;
-	Dyncomp_reset (&self->dyncomp);
-	self->samplecnt = self->sampletme;
+	DarcCapRecord rec;
+	DyncompState  st;
+
+	if (cap != self->capture_prev) {
+		self->capture_prev = cap;
+		self->capture_sync = false;
+	}
+
+	memset (&rec, 0, sizeof (rec));
+	rec.type      = DARC_CAP_BLOCK;
+	rec.n_samples = n_samples;
+	rec.pos       = self->trace_pos;
+	for (uint32_t p = 0; p < DARC_GMIN; ++p) {
+		rec.ctrl[p] = *self->_port[p];
+	}
+	darc_cap_get_coef (&self->dyncomp, &rec.coef);
+	if (!self->capture_sync) {
+		Dyncomp_get_state (&self->dyncomp, &st);
+	}
+
+	const int64_t at = darc_cap_begin (cap, self->capture_sync ? NULL : &st, &rec, in, self->dyncomp.n_channels);
+
+	/* resume with a state snapshot after a dropped block */
+	self->capture_sync = at >= 0;
+	return at;
 }
 
 static void
@@ -431,9 +690,25 @@ run (LV2_Handle instance, uint32_t n_samples)
 {
 	Darc* self = (Darc*)instance;
 
+	float budget;
+	__atomic_load (&self->gov_budget, &budget, __ATOMIC_RELAXED);
+
+	double gov_t0 = 0;
+	if (budget > 0) {
+		gov_t0 = gov_time ();
+	} else {
+		self->dyncomp.tier = DARC_TIER_FULL;
+		self->gov_load     = 0;
+	}
+#ifdef DARC_INSTRUMENT
+	const uint64_t t0 = darc_cycles ();
+#endif
+
 	/* bypass/enable */
 	const bool enable = *self->_port[DARC_ENABLE] > 0;
 
+	trace_controls (self);
+
 	if (enable) {
 		Dyncomp_set_inputgain (&self->dyncomp, *self->_port[DARC_INPUTGAIN]);
 		Dyncomp_set_threshold (&self->dyncomp, *self->_port[DARC_THRESHOLD]);
@@ -458,19 +733,55 @@ run (LV2_Handle instance, uint32_t n_samples)
 		}
 	}
 
+	ui_subscription (self);
+
+	DarcCapture* cap    = __atomic_load_n (&self->capture, __ATOMIC_ACQUIRE);
+	int64_t      cap_at = -1;
+	if (cap) {
+		cap_at = capture_begin (self, cap, outs, n_samples);
+	}
+
+	const bool stream = self->ui_count > 0 && self->notify && self->map;
+
+	/* the meter stream does not change the processing */
+	self->dyncomp.frames = stream ? &self->meter : NULL;
 	Dyncomp_process (&self->dyncomp, n_samples, outs);
 
+	if (self->notify && self->map) {
+		LV2_Atom_Forge_Frame frame;
+		lv2_atom_forge_set_buffer (&self->forge, (uint8_t*)self->notify, self->notify->atom.size);
+		lv2_atom_forge_sequence_head (&self->forge, &frame, 0);
+
+		if (stream && self->meter.n > 0) {
+			emit_frames (self);
+		}
+
+		lv2_atom_forge_pop (&self->forge, &frame);
+	}
+
+	if (cap_at >= 0) {
+		darc_cap_commit (cap, cap_at, darc_cap_hash (outs, self->dyncomp.n_channels, n_samples));
+	}
+
 	self->samplecnt += n_samples;
 	while (self->samplecnt >= self->sampletme) {
 		self->samplecnt -= self->sampletme;
-		Dyncomp_get_gain (&self->dyncomp, &self->_gmin, &self->_gmax, &self->_rms);
-
-		self->_gmin = fminf (40.f, fmaxf (-20.f, self->_gmin));
-		self->_gmax = fminf (40.f, fmaxf (-20.f, self->_gmax));
-		self->_rms  = fminf (10.f, fmaxf (-80.f, self->_rms));
+		if (self->acc_n > 0) {
+			/* the meter stream already collected the values */
+			self->_gmin = self->acc_gmin;
+			self->_gmax = self->acc_gmax;
+			self->_rms  = self->acc_rms;
+			self->acc_n = 0;
+		} else if (self->ui_count == 0 || !self->notify) {
+			Dyncomp_get_gain (&self->dyncomp, &self->_gmin, &self->_gmax, &self->_rms);
+
+			self->_gmin = fminf (40.f, fmaxf (-20.f, self->_gmin));
+			self->_gmax = fminf (40.f, fmaxf (-20.f, self->_gmax));
+			self->_rms  = fminf (10.f, fmaxf (-80.f, self->_rms));
+		}
 
 #ifdef DISPLAY_INTERFACE
-		if (self->queue_draw && (self->ui_gmin != self->_gmin || self->ui_gmax != self->_gmax)) {
+		if (self->queue_draw && dpl_moved (self)) {
 			self->ui_gmin = self->_gmin;
 			self->ui_gmax = self->_gmax;
 			self->queue_draw->queue_draw (self->queue_draw->handle);
@@ -481,22 +792,28 @@ run (LV2_Handle instance, uint32_t n_samples)
 	*self->_port[DARC_GMIN] = self->_gmin;
 	*self->_port[DARC_GMAX] = self->_gmax;
 	*self->_port[DARC_RMS]  = self->_rms;
+
+	trace_cycle (self, n_samples);
+
+	if (budget > 0) {
+		governor (self, budget, n_samples, gov_time () - gov_t0);
+	}
+	if (self->_port[DARC_TIER]) {
+		*self->_port[DARC_TIER] = self->dyncomp.tier;
+	}
+
+#ifdef DARC_INSTRUMENT
+	instrument (self, n_samples, darc_cycles () - t0);
+#endif
 }
 
 static void
 cleanup (LV2_Handle instance)
 {
-	Darc* self = (Darc*)instance;
 #ifdef DISPLAY_INTERFACE
-	if (self->mpat) {
-		cairo_pattern_destroy (self->mpat);
-	}
-	if (self->cpat) {
-		cairo_pattern_destroy (self->cpat);
-	}
-	if (self->display) {
-		cairo_surface_destroy (self->display);
-	}
+	Darc* self = (Darc*)instance;
+	dpl_background_unref (self->bg);
+	free (self->display);
 #endif
 	free (instance);
 }
@@ -515,8 +832,57 @@ struct license_info license_infos = {
 #endif
 
 #ifdef DISPLAY_INTERFACE
+/* The inline display is rendered directly into an ARGB32 buffer,
+ * so that the DSP does not need to link against cairo.
+ *
+ * Everything except the gain-bar is static and only depends on the size.
+ * Static parts are computed once per size and shared by all instances,
+ * an update only repaints the columns of the gain-bar that changed.
+ */
+
+typedef struct {
+	float pos;
+	float r, g, b, a;
+} DplStop;
+
+typedef struct _DplBackground {
+	uint32_t w, h;
+	uint32_t refcnt;
+	int      x0, wd;  // meter area
+	uint32_t* row_o;  // rows outside the meter area
+	uint32_t* row_i;  // rows of the meter area, without gain-bar
+	float*    inner;  // row_i as RGB
+	float*    cpat;   // gain-bar gradient, premultiplied RGBA
+	struct _DplBackground* next;
+} DplBackground;
+
+static DplBackground*  dpl_cache = NULL;
+static pthread_mutex_t dpl_lock  = PTHREAD_MUTEX_INITIALIZER;
+
+/* linear gradient, sampled at pixel centers */
 static void
-create_pattern (Darc* self, const double w)
+dpl_gradient (float* pat, const DplStop* s, int n_stops, uint32_t w)
+{
+	int k = 0;
+	for (uint32_t x = 0; x < w; ++x) {
+		const float t = (x + .5f) / w;
+		while (k < n_stops - 2 && t > s[k + 1].pos) {
+			++k;
+		}
+		const float d = s[k + 1].pos - s[k].pos;
+		float       f = d > 0 ? (t - s[k].pos) / d : 0;
+		f             = f < 0 ? 0 : (f > 1 ? 1 : f);
+
+		const float a  = s[k].a + f * (s[k + 1].a - s[k].a);
+		pat[4 * x]     = a * (s[k].r + f * (s[k + 1].r - s[k].r));
+		pat[4 * x + 1] = a * (s[k].g + f * (s[k + 1].g - s[k].g));
+		pat[4 * x + 2] = a * (s[k].b + f * (s[k + 1].b - s[k].b));
+		pat[4 * x + 3] = a;
+	}
+}
+
+static void
+create_pattern (float* mpat, float* cpat, const double w)
 {
 	const int x0 = floor (w * 0.05);
 	const int x1 = ceil (w * 0.95);
@@ -524,29 +890,147 @@ create_pattern (Darc* self, const double w)
 
 #define DEF(x) ((x0 + wd * ((x) + 20.) / 60.) / w)
 
-	cairo_pattern_t* pat = cairo_pattern_create_linear (0.0, 0.0, w, 0);
 	/* clang-format off */
-	cairo_pattern_add_color_stop_rgba (pat, 1.0,       .0, .5, .0, 0);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (40),  .0, .5, .0, 0.5);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (5),   .0, .5, .0, 0.5);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (-5),  .5, .0, .0, 0.5);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (-20), .5, .0, .0, 0.5);
-	cairo_pattern_add_color_stop_rgba (pat, 0.0,       .5, .0, .0, 0);
+	const DplStop mstops[] = {
+		{ 0.0,       .5, .0, .0, 0 },
+		{ DEF (-20), .5, .0, .0, 0.5 },
+		{ DEF (-5),  .5, .0, .0, 0.5 },
+		{ DEF (5),   .0, .5, .0, 0.5 },
+		{ DEF (40),  .0, .5, .0, 0.5 },
+		{ 1.0,       .0, .5, .0, 0 },
+	};
+	const DplStop cstops[] = {
+		{ 0.0,       .9, .9, .1, 0 },
+		{ DEF (-20), .9, .9, .1, 1 },
+		{ DEF (-5),  .9, .9, .1, 1 },
+		{ DEF (5),   .1, .9, .1, 1 },
+		{ DEF (40),  .1, .9, .1, 1 },
+		{ 1.0,       .1, .9, .1, 0 },
+	};
 	/* clang-format on */
-	self->mpat = pat;
 
-	pat = cairo_pattern_create_linear (0.0, 0.0, w, 0);
-	/* clang-format off */
-	cairo_pattern_add_color_stop_rgba (pat, 1.0,       .1, .9, .1, 0);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (40),  .1, .9, .1, 1);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (5),   .1, .9, .1, 1);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (-5),  .9, .9, .1, 1);
-	cairo_pattern_add_color_stop_rgba (pat, DEF (-20), .9, .9, .1, 1);
-	cairo_pattern_add_color_stop_rgba (pat, 0.0,       .9, .9, .1, 0);
-	/* clang-format on */
-	self->cpat = pat;
+#undef DEF
+
+	dpl_gradient (mpat, mstops, 6, w);
+	dpl_gradient (cpat, cstops, 6, w);
+}
+
+/* composite premultiplied `src` with coverage `cov` over an opaque pixel */
+static inline void
+dpl_over (float* rgb, const float* src, float cov)
+{
+	const float ia = 1.f - cov * src[3];
+	rgb[0]         = cov * src[0] + ia * rgb[0];
+	rgb[1]         = cov * src[1] + ia * rgb[1];
+	rgb[2]         = cov * src[2] + ia * rgb[2];
+}
+
+static inline uint32_t
+dpl_pixel (const float* rgb)
+{
+	return 0xff000000
+	       | ((uint32_t)(rgb[0] * 255.f + .5f) << 16)
+	       | ((uint32_t)(rgb[1] * 255.f + .5f) << 8)
+	       | ((uint32_t)(rgb[2] * 255.f + .5f));
+}
+
+static DplBackground*
+dpl_background_create (uint32_t w, uint32_t h)
+{
+	DplBackground* bg = (DplBackground*)malloc (sizeof (DplBackground)
+	                                            + 2 * w * sizeof (uint32_t)
+	                                            + 7 * w * sizeof (float));
+	float* mpat = (float*)malloc (4 * w * sizeof (float));
+	if (!bg || !mpat) {
+		free (bg);
+		free (mpat);
+		return NULL;
+	}
+
+	bg->w      = w;
+	bg->h      = h;
+	bg->refcnt = 0;
+	bg->next   = NULL;
+	bg->row_o  = (uint32_t*)&bg[1];
+	bg->row_i  = &bg->row_o[w];
+	bg->inner  = (float*)&bg->row_i[w];
+	bg->cpat   = &bg->inner[3 * w];
+
+	create_pattern (mpat, bg->cpat, w);
+
+	const int x0 = floor (w * 0.05);
+	const int x1 = ceil (w * 0.95);
+	const int wd = x1 - x0;
+
+	bg->x0 = x0;
+	bg->wd = wd;
+
+#define DEF(x) (rint (x0 + wd * ((x) + 20.) / 60.) - .5)
+#define GRID(x) ((int)DEF (x) == (int)px)
+
+	for (uint32_t px = 0; px < w; ++px) {
+		float* inner = &bg->inner[3 * px];
+		float  outer[3];
 
+		outer[0] = outer[1] = outer[2] = .2f;
+
+		if (GRID (-20) || GRID (-10) || GRID (0) || GRID (10) || GRID (20) || GRID (30) || GRID (40)) {
+			outer[0] = outer[1] = outer[2] = .8f;
+		}
+
+		memcpy (inner, outer, sizeof (outer));
+		if ((int)px >= x0 && (int)px < x1) {
+			dpl_over (inner, &mpat[4 * px], 1.f);
+		}
+
+		bg->row_o[px] = dpl_pixel (outer);
+		bg->row_i[px] = dpl_pixel (inner);
+	}
+
+#undef GRID
 #undef DEF
+
+	free (mpat);
+	return bg;
+}
+
+static DplBackground*
+dpl_background_ref (uint32_t w, uint32_t h)
+{
+	DplBackground* bg;
+	pthread_mutex_lock (&dpl_lock);
+	for (bg = dpl_cache; bg; bg = bg->next) {
+		if (bg->w == w && bg->h == h) {
+			break;
+		}
+	}
+	if (!bg && (bg = dpl_background_create (w, h))) {
+		bg->next  = dpl_cache;
+		dpl_cache = bg;
+	}
+	if (bg) {
+		++bg->refcnt;
+	}
+	pthread_mutex_unlock (&dpl_lock);
+	return bg;
+}
+
+static void
+dpl_background_unref (DplBackground* bg)
+{
+	if (!bg) {
+		return;
+	}
+	pthread_mutex_lock (&dpl_lock);
+	if (--bg->refcnt == 0) {
+		DplBackground** p = &dpl_cache;
+		while (*p != bg) {
+			p = &(*p)->next;
+		}
+		*p = bg->next;
+		free (bg);
+	}
+	pthread_mutex_unlock (&dpl_lock);
 }
 
 static LV2_Inline_Display_Image_Surface*
@@ -562,78 +1046,76 @@ dpl_render (LV2_Handle handle, uint32_t w, uint32_t max_h)
 	Darc* self = (Darc*)handle;
 
 	if (!self->display || self->w != w || self->h != h) {
-		if (self->display)
-			cairo_surface_destroy (self->display);
-		self->display = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
-		self->w       = w;
-		self->h       = h;
-		if (self->mpat) {
-			cairo_pattern_destroy (self->mpat);
-			self->mpat = NULL;
+		dpl_background_unref (self->bg);
+		free (self->display);
+		self->bg      = dpl_background_ref (w, h);
+		self->display = (uint32_t*)malloc (w * h * sizeof (uint32_t));
+		if (!self->bg || !self->display) {
+			dpl_background_unref (self->bg);
+			free (self->display);
+			self->bg      = NULL;
+			self->display = NULL;
+			return NULL;
 		}
-		if (self->cpat) {
-			cairo_pattern_destroy (self->cpat);
-			self->cpat = NULL;
+		self->w = w;
+		self->h = h;
+
+		/* meter area: rows [2, h - 3) */
+		for (uint32_t y = 0; y < h; ++y) {
+			memcpy (&self->display[y * w], (y >= 2 && y + 3 < h) ? self->bg->row_i : self->bg->row_o, w * sizeof (uint32_t));
 		}
-	}
+		self->bar_x0 = self->bar_x1 = 0;
 
-	if (!self->mpat || !self->cpat) {
-		create_pattern (self, w);
+		self->surf.width  = w;
+		self->surf.height = h;
+		self->surf.stride = w * sizeof (uint32_t);
+		self->surf.data   = (unsigned char*)self->display;
 	}
 
-	cairo_t* cr = cairo_create (self->display);
-	cairo_rectangle (cr, 0, 0, w, h);
-	cairo_set_source_rgba (cr, .2, .2, .2, 1.0);
-	cairo_fill (cr);
+	const DplBackground* bg = self->bg;
 
-	const int x0 = floor (w * 0.05);
-	const int x1 = ceil (w * 0.95);
-	const int wd = x1 - x0;
+	self->bar_s = bg->wd / 60.f;
+	self->bar_o = bg->x0 + 20.f * self->bar_s;
 
-	cairo_set_line_width (cr, 1);
-	cairo_set_source_rgba (cr, 0.8, 0.8, 0.8, 1.0);
+#define DEF(x) (rint (bg->x0 + bg->wd * ((x) + 20.) / 60.) - .5)
 
-#define DEF(x) (rint (x0 + wd * ((x) + 20.) / 60.) - .5)
-#define GRID(x)                         \
-	cairo_move_to (cr, DEF (x), 0); \
-	cairo_rel_line_to (cr, 0, h);   \
-	cairo_stroke (cr)
-
-	GRID (-20);
-	GRID (-10);
-	GRID (0);
-	GRID (10);
-	GRID (20);
-	GRID (30);
-	GRID (40);
+	const float v0 = DEF (self->ui_gmin) - 1;
+	const float v1 = DEF (self->ui_gmax) + 1;
 
-#undef GRID
+#undef DEF
 
-	cairo_rectangle (cr, x0, 2, wd, h - 5);
-	cairo_set_source (cr, self->mpat);
-	cairo_fill (cr);
+	int b0 = floorf (v0);
+	int b1 = ceilf (v1);
+	b0     = b0 < 0 ? 0 : (b0 > (int)w ? (int)w : b0);
+	b1     = b1 < b0 ? b0 : (b1 > (int)w ? (int)w : b1);
+
+	/* repaint the union of the previous and the new gain-bar */
+	int u0 = b0;
+	int u1 = b1;
+	if (self->bar_x1 > self->bar_x0) {
+		u0 = self->bar_x0 < u0 ? self->bar_x0 : u0;
+		u1 = self->bar_x1 > u1 ? self->bar_x1 : u1;
+	}
 
-	if (1) {
-		float v0 = DEF (self->ui_gmin);
-		float v1 = DEF (self->ui_gmax);
-		cairo_rectangle (cr, v0 - 1, 2, 2. + v1 - v0, h - 5);
-		cairo_set_source (cr, self->cpat);
-		cairo_fill (cr);
-	} else { /* bypassed */
-		cairo_rectangle (cr, 0, 0, w, h);
-		cairo_set_source_rgba (cr, .2, .2, .2, 0.8);
-		cairo_fill (cr);
+	uint32_t* row = &self->display[2 * w];
+	for (int px = u0; px < u1; ++px) {
+		const float cov = fminf (px + 1.f, v1) - fmaxf (px, v0);
+		if (cov > 0) {
+			float rgb[3];
+			memcpy (rgb, &bg->inner[3 * px], sizeof (rgb));
+			dpl_over (rgb, &bg->cpat[4 * px], fminf (1.f, cov));
+			row[px] = dpl_pixel (rgb);
+		} else {
+			row[px] = bg->row_i[px];
+		}
 	}
 
-#undef DEF
+	for (uint32_t y = 3; y + 3 < h && u1 > u0; ++y) {
+		memcpy (&self->display[y * w + u0], &row[u0], (u1 - u0) * sizeof (uint32_t));
+	}
 
-	/* finish surface */
-	cairo_destroy (cr);
-	cairo_surface_flush (self->display);
-	self->surf.width  = cairo_image_surface_get_width (self->display);
-	self->surf.height = cairo_image_surface_get_height (self->display);
-	self->surf.stride = cairo_image_surface_get_stride (self->display);
-	self->surf.data   = cairo_image_surface_get_data (self->display);
+	self->bar_x0 = b0;
+	self->bar_x1 = b1;
 
 	return &self->surf;
 }
@@ -645,15 +1127,26 @@ extension_data (const char* uri)
 #ifdef DISPLAY_INTERFACE
 	static const LV2_Inline_Display_Interface display = { dpl_render };
 	if (!strcmp (uri, LV2_INLINEDISPLAY__interface)) {
-#if (defined _WIN32 && defined RTK_STATIC_INIT)
-		static int once = 0;
-		if (!once) {
-			once = 1;
-			gobject_init_ctor ();
-		}
-#endif
 		return &display;
 	}
+#endif
+	static const LV2_Worker_Interface worker = { trace_work, trace_work_response, NULL };
+	if (!strcmp (uri, LV2_WORKER__interface)) {
+		return &worker;
+	}
+	static const DarcCaptureInterface capture = { capture_attach };
+	if (!strcmp (uri, DARC__capture)) {
+		return &capture;
+	}
+	static const DarcGovernorInterface governor = { gov_set_budget };
+	if (!strcmp (uri, DARC__governor)) {
+		return &governor;
+	}
+#ifdef DARC_INSTRUMENT
+	static const DarcInstrumentInterface instrument = { get_stats };
+	if (!strcmp (uri, DARC__instrument)) {
+		return &instrument;
+	}
 #endif
 #ifdef WITH_SIGNATURE
 	LV2_LICENSE_EXT_C
@@ -0,0 +1,131 @@
+/* darc.lv2 -- realtime event trace
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_TRACE_H
+#define _DARC_TRACE_H
+
+/* Wait-free single-producer, single-consumer ring of events that are
+ * recorded by run (). Events are formatted by a non-realtime thread.
+ * When the ring is full, events are dropped and counted.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define DARC_TRACE_SIZE 128 // power of two
+
+typedef enum {
+	DARC_TRACE_RESET,  // filter state reset after NaN or inf, a: count
+	DARC_TRACE_ENABLE, // a: previous, b: new state
+	DARC_TRACE_PARAM,  // parameter jump, a: previous, b: new value
+} DarcTraceType;
+
+typedef struct {
+	uint64_t pos;  // sample position of the cycle
+	uint32_t type; // DarcTraceType
+	uint32_t port;
+	float    a;
+	float    b;
+} DarcTraceEvent;
+
+typedef struct {
+	DarcTraceEvent ev[DARC_TRACE_SIZE];
+	uint32_t       write;
+	uint32_t       read;
+	uint32_t       lost;     // written by the producer
+	uint32_t       reported; // lost events already reported by the consumer
+} DarcTrace;
+
+/* called by run () */
+static inline void
+darc_trace_push (DarcTrace* t, uint32_t type, uint32_t port, uint64_t pos, float a, float b)
+{
+	const uint32_t w = t->write;
+	if (w - __atomic_load_n (&t->read, __ATOMIC_ACQUIRE) >= DARC_TRACE_SIZE) {
+		__atomic_store_n (&t->lost, t->lost + 1, __ATOMIC_RELAXED);
+		return;
+	}
+	DarcTraceEvent* ev = &t->ev[w & (DARC_TRACE_SIZE - 1)];
+	ev->pos            = pos;
+	ev->type           = type;
+	ev->port           = port;
+	ev->a              = a;
+	ev->b              = b;
+	__atomic_store_n (&t->write, w + 1, __ATOMIC_RELEASE);
+}
+
+static inline bool
+darc_trace_pending (const DarcTrace* t)
+{
+	return t->write != __atomic_load_n (&t->read, __ATOMIC_RELAXED);
+}
+
+/* called by the non-realtime thread */
+static inline bool
+darc_trace_pop (DarcTrace* t, DarcTraceEvent* ev)
+{
+	const uint32_t r = t->read;
+	if (r == __atomic_load_n (&t->write, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+	*ev = t->ev[r & (DARC_TRACE_SIZE - 1)];
+	__atomic_store_n (&t->read, r + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/* number of dropped events since the last call */
+static inline uint32_t
+darc_trace_lost (DarcTrace* t)
+{
+	const uint32_t lost = __atomic_load_n (&t->lost, __ATOMIC_RELAXED);
+	const uint32_t n    = lost - t->reported;
+	t->reported         = lost;
+	return n;
+}
+
+static inline void
+darc_trace_format (const DarcTraceEvent* ev, double rate, char* buf, size_t len)
+{
+	static const char* sym[] = {
+		"enable", "hold", "inputgain", "threshold", "Ratio", "attack", "release"
+	};
+
+	int n = snprintf (buf, len, "%.3fs (%llu) ", ev->pos / rate, (unsigned long long)ev->pos);
+	if (n < 0 || (size_t)n >= len) {
+		return;
+	}
+
+	switch (ev->type) {
+		case DARC_TRACE_RESET:
+			snprintf (buf + n, len - n, "filter state reset after NaN or inf (%.0f)", ev->a);
+			break;
+		case DARC_TRACE_ENABLE:
+			snprintf (buf + n, len - n, "%s", ev->b > 0 ? "enabled" : "bypassed");
+			break;
+		case DARC_TRACE_PARAM:
+			snprintf (buf + n, len - n, "%s jump %g -> %g",
+			          ev->port < sizeof (sym) / sizeof (sym[0]) ? sym[ev->port] : "?", ev->a, ev->b);
+			break;
+		default:
+			snprintf (buf + n, len - n, "unknown event %u", ev->type);
+			break;
+	}
+}
+
+#endif
@@ -0,0 +1,241 @@
+/* darc.lv2 -- capture files
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_CAPFILE_H
+#define _DARC_CAPFILE_H
+
+/* Writer thread that streams the capture ring of a plugin instance to
+ * disk, and a reader for the resulting file. See src/capture.h for the
+ * format.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "../src/capture.h"
+
+#define DARC_CAP_RING (1 << 23) // bytes, 8 MB: ~10 sec stereo at 96kHz
+
+typedef struct {
+	DarcCapture ring;
+	FILE*       f;
+	pthread_t   thread;
+	int         stop;
+	bool        error; // write failed, the thread only drains the ring
+	uint64_t    bytes;
+} DarcCapWriter;
+
+static void*
+darc_capwriter_thread (void* arg)
+{
+	DarcCapWriter* self = (DarcCapWriter*)arg;
+	DarcCapture*   c    = &self->ring;
+
+	for (;;) {
+		const bool     stop = __atomic_load_n (&self->stop, __ATOMIC_ACQUIRE);
+		const uint32_t w    = __atomic_load_n (&c->write, __ATOMIC_ACQUIRE);
+		const uint32_t r    = c->read;
+
+		if (w == r) {
+			if (stop) {
+				break;
+			}
+			usleep (10000);
+			continue;
+		}
+
+		/* up to the end of the buffer, the rest with the next iteration */
+		const uint32_t off = r & (c->size - 1);
+		uint32_t       n   = w - r;
+		if (n > c->size - off) {
+			n = c->size - off;
+		}
+		if (!self->error && fwrite (c->buf + off, 1, n, self->f) != n) {
+			self->error = true;
+		}
+		self->bytes += n;
+		__atomic_store_n (&c->read, r + n, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/* create the file and start the writer. `size` must be a power of two. */
+static int
+darc_capwriter_start (DarcCapWriter* self, const char* path, uint32_t n_channels, float rate, uint32_t size)
+{
+	memset (self, 0, sizeof (DarcCapWriter));
+
+	if (!(self->f = fopen (path, "wb"))) {
+		return -1;
+	}
+
+	DarcCapHeader hdr;
+	memset (&hdr, 0, sizeof (hdr));
+	memcpy (hdr.magic, "DarcCap", 8);
+	hdr.version     = DARC_CAP_VERSION;
+	hdr.n_channels  = n_channels;
+	hdr.sample_rate = rate;
+	hdr.record_size = sizeof (DarcCapRecord);
+
+	if (fwrite (&hdr, sizeof (hdr), 1, self->f) != 1) {
+		fclose (self->f);
+		return -1;
+	}
+
+	/* touch and lock the pages, run () must not page-fault */
+	self->ring.size = size;
+	self->ring.buf  = (uint8_t*)malloc (size);
+	if (!self->ring.buf) {
+		fclose (self->f);
+		return -1;
+	}
+	memset (self->ring.buf, 0, size);
+#ifndef _WIN32
+	mlock (self->ring.buf, size);
+#endif
+
+	if (pthread_create (&self->thread, NULL, darc_capwriter_thread, self)) {
+		free (self->ring.buf);
+		fclose (self->f);
+		return -1;
+	}
+	return 0;
+}
+
+/* call after the ring was detached, or the plugin was deactivated.
+ * Returns the number of blocks that were dropped at the end, or -1 on error.
+ */
+static int
+darc_capwriter_stop (DarcCapWriter* self)
+{
+	__atomic_store_n (&self->stop, 1, __ATOMIC_RELEASE);
+	pthread_join (self->thread, NULL);
+
+	const uint32_t dropped = self->ring.dropped;
+	if (dropped > 0 && !self->error) {
+		DarcCapRecord gap;
+		memset (&gap, 0, sizeof (gap));
+		gap.type      = DARC_CAP_GAP;
+		gap.n_samples = dropped;
+		self->error   = fwrite (&gap, sizeof (gap), 1, self->f) != 1;
+	}
+
+	if (fclose (self->f)) {
+		self->error = true;
+	}
+#ifndef _WIN32
+	munlock (self->ring.buf, self->ring.size);
+#endif
+	free (self->ring.buf);
+	self->ring.buf = NULL;
+	return self->error ? -1 : (int)dropped;
+}
+
+/* ****************************************************************************
+ * reader
+ */
+
+typedef struct {
+	FILE*         f;
+	DarcCapHeader hdr;
+	float*        data[2]; // planar input of the last block
+	uint32_t      alloc;   // samples per channel
+	DyncompState  state;   // of the last state record
+} DarcCapReader;
+
+static int
+darc_capreader_open (DarcCapReader* self, const char* path)
+{
+	memset (self, 0, sizeof (DarcCapReader));
+	if (!(self->f = fopen (path, "rb"))) {
+		return -1;
+	}
+	if (fread (&self->hdr, sizeof (DarcCapHeader), 1, self->f) != 1
+	    || memcmp (self->hdr.magic, "DarcCap", 8)
+	    || self->hdr.version != DARC_CAP_VERSION
+	    || self->hdr.record_size != sizeof (DarcCapRecord)
+	    || self->hdr.n_channels < 1 || self->hdr.n_channels > 2
+	    || !(self->hdr.sample_rate > 0)) {
+		fclose (self->f);
+		self->f = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+static void
+darc_capreader_close (DarcCapReader* self)
+{
+	if (self->f) {
+		fclose (self->f);
+	}
+	free (self->data[0]);
+	free (self->data[1]);
+	memset (self, 0, sizeof (DarcCapReader));
+}
+
+/* read the next record and its payload.
+ * Returns 1 on success, 0 at the end of the file and -1 if it is truncated.
+ */
+static int
+darc_capreader_next (DarcCapReader* self, DarcCapRecord* rec)
+{
+	const size_t n = fread (rec, 1, sizeof (DarcCapRecord), self->f);
+	if (n != sizeof (DarcCapRecord)) {
+		return (n == 0 && feof (self->f)) ? 0 : -1;
+	}
+
+	switch (rec->type) {
+		case DARC_CAP_STATE:
+			return fread (&self->state, sizeof (DyncompState), 1, self->f) == 1 ? 1 : -1;
+		case DARC_CAP_GAP:
+			return 1;
+		case DARC_CAP_BLOCK:
+			break;
+		default:
+			return -1;
+	}
+
+	if (rec->n_samples > self->alloc) {
+		for (uint32_t c = 0; c < self->hdr.n_channels; ++c) {
+			float* d = (float*)realloc (self->data[c], rec->n_samples * sizeof (float));
+			if (!d) {
+				return -1;
+			}
+			self->data[c] = d;
+		}
+		self->alloc = rec->n_samples;
+	}
+
+	for (uint32_t c = 0; c < self->hdr.n_channels; ++c) {
+		if (fread (self->data[c], sizeof (float), rec->n_samples, self->f) != rec->n_samples) {
+			return -1;
+		}
+	}
+	return 1;
+}
+
+#endif
@@ -0,0 +1,197 @@
+/* darc.lv2 -- envelope state checkpoints
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_CHECKPOINT_H
+#define _DARC_CHECKPOINT_H
+
+/* A checkpoint file holds a Dyncomp state snapshot taken every
+ * `interval` samples of a continuous render. Restoring the checkpoint at
+ * or before a given position reproduces the envelope of the continuous
+ * render, so only the (at most interval - 1) samples between the
+ * checkpoint and the target position need to be processed.
+ *
+ * Checkpoints are only valid for the parameters they were recorded with.
+ */
+
+#include "common.h"
+
+typedef struct {
+	char       magic[8]; // "DarcCkpt"
+	uint32_t   version;
+	uint32_t   n_channels;
+	float      sample_rate;
+	uint32_t   interval;
+	DarcParams params;
+	uint64_t   n_checkpoints;
+} CheckpointHeader;
+
+typedef struct {
+	CheckpointHeader hdr;
+	DyncompState*    cp;
+	uint64_t         alloc;
+} Checkpoints;
+
+static void
+checkpoints_init (Checkpoints* self, const Dyncomp* d, const DarcParams* p, uint32_t interval)
+{
+	memset (self, 0, sizeof (Checkpoints));
+	memcpy (self->hdr.magic, "DarcCkpt", 8);
+	self->hdr.version     = DARC_STATE_VERSION;
+	self->hdr.n_channels  = d->n_channels;
+	self->hdr.sample_rate = d->sample_rate;
+	self->hdr.interval    = interval;
+	self->hdr.params      = *p;
+}
+
+static void
+checkpoints_free (Checkpoints* self)
+{
+	free (self->cp);
+	self->cp    = NULL;
+	self->alloc = 0;
+}
+
+static bool
+checkpoints_add (Checkpoints* self, const Dyncomp* d)
+{
+	if (self->hdr.n_checkpoints == self->alloc) {
+		uint64_t      alloc = self->alloc ? 2 * self->alloc : 1024;
+		DyncompState* cp    = (DyncompState*)realloc (self->cp, alloc * sizeof (DyncompState));
+		if (!cp) {
+			return false;
+		}
+		self->cp    = cp;
+		self->alloc = alloc;
+	}
+	Dyncomp_get_state (d, &self->cp[self->hdr.n_checkpoints++]);
+	return true;
+}
+
+/* Process n_samples starting at timeline position `pos`, recording a
+ * checkpoint at every multiple of the interval, before the sample at that
+ * position is processed.
+ */
+static bool
+checkpoints_process (Checkpoints* self, Dyncomp* d, uint64_t pos, uint32_t n_samples, float* const* io)
+{
+	const uint32_t nc = d->n_channels;
+	float*         buf[MAX_CHANNELS];
+	uint32_t       off = 0;
+
+	while (off < n_samples) {
+		const uint64_t p = pos + off;
+		uint32_t       n = n_samples - off;
+
+		if (p % self->hdr.interval == 0) {
+			/* checkpoints must be recorded consecutively */
+			if (p / self->hdr.interval != self->hdr.n_checkpoints) {
+				return false;
+			}
+			if (!checkpoints_add (self, d)) {
+				return false;
+			}
+		}
+
+		const uint32_t to_next = self->hdr.interval - p % self->hdr.interval;
+		if (n > to_next) {
+			n = to_next;
+		}
+
+		for (uint32_t c = 0; c < nc; ++c) {
+			buf[c] = &io[c][off];
+		}
+		Dyncomp_process (d, n, buf);
+		off += n;
+	}
+	return true;
+}
+
+/* restore the latest checkpoint at or before `pos`.
+ * Returns the timeline position of the restored state, or -1 on error.
+ */
+static int64_t
+checkpoints_seek (const Checkpoints* self, Dyncomp* d, uint64_t pos)
+{
+	uint64_t k = pos / self->hdr.interval;
+	if (self->hdr.n_checkpoints == 0) {
+		return -1;
+	}
+	if (k >= self->hdr.n_checkpoints) {
+		k = self->hdr.n_checkpoints - 1;
+	}
+	if (!Dyncomp_set_state (d, &self->cp[k])) {
+		return -1;
+	}
+	return k * self->hdr.interval;
+}
+
+static bool
+checkpoints_match (const Checkpoints* self, const Dyncomp* d, const DarcParams* p)
+{
+	return self->hdr.n_channels == d->n_channels
+	       && self->hdr.sample_rate == d->sample_rate
+	       && !memcmp (&self->hdr.params, p, sizeof (DarcParams));
+}
+
+static int
+checkpoints_save (const Checkpoints* self, const char* path)
+{
+	FILE* f = fopen (path, "wb");
+	if (!f) {
+		return -1;
+	}
+	int rv = 0;
+	if (fwrite (&self->hdr, sizeof (CheckpointHeader), 1, f) != 1) {
+		rv = -1;
+	} else if (self->hdr.n_checkpoints > 0 && fwrite (self->cp, sizeof (DyncompState), self->hdr.n_checkpoints, f) != self->hdr.n_checkpoints) {
+		rv = -1;
+	}
+	if (fclose (f)) {
+		rv = -1;
+	}
+	return rv;
+}
+
+static int
+checkpoints_load (Checkpoints* self, const char* path)
+{
+	memset (self, 0, sizeof (Checkpoints));
+	FILE* f = fopen (path, "rb");
+	if (!f) {
+		return -1;
+	}
+	if (fread (&self->hdr, sizeof (CheckpointHeader), 1, f) != 1
+	    || memcmp (self->hdr.magic, "DarcCkpt", 8)
+	    || self->hdr.version != DARC_STATE_VERSION
+	    || self->hdr.interval == 0) {
+		fclose (f);
+		return -1;
+	}
+	const uint64_t n = self->hdr.n_checkpoints;
+	self->cp         = (DyncompState*)malloc (n * sizeof (DyncompState));
+	self->alloc      = n;
+	if (n > 0 && (!self->cp || fread (self->cp, sizeof (DyncompState), n, f) != n)) {
+		fclose (f);
+		checkpoints_free (self);
+		return -1;
+	}
+	fclose (f);
+	return 0;
+}
+
+#endif
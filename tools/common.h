@@ -0,0 +1,131 @@
+/* darc.lv2 -- shared helpers for the standalone tools
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_TOOLS_COMMON_H
+#define _DARC_TOOLS_COMMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/dyncomp.h"
+
+#define MAX_CHANNELS 64
+#define BLOCKSIZE 4096
+
+/* control-port values, same units and defaults as the LV2 plugin */
+typedef struct {
+	float inputgain; // dB
+	float threshold; // dB
+	float ratio;     // 0..1
+	float attack;    // sec
+	float release;   // sec
+	float hold;      // 0, 1
+} DarcParams;
+
+static const DarcParams darc_default_params = { 0.f, -30.f, 0.f, 0.01f, 0.3f, 0.f };
+
+static void
+darc_params_apply (Dyncomp* d, const DarcParams* p)
+{
+	Dyncomp_set_inputgain (d, p->inputgain);
+	Dyncomp_set_threshold (d, p->threshold);
+	Dyncomp_set_ratio (d, p->ratio);
+	Dyncomp_set_hold (d, p->hold > 0);
+	Dyncomp_set_attack (d, p->attack);
+	Dyncomp_set_release (d, p->release);
+}
+
+static bool
+darc_params_clamp (DarcParams* p)
+{
+	bool ok = true;
+#define CLAMP(VAR, MIN, MAX)        \
+	if (p->VAR < MIN) {         \
+		p->VAR = MIN;       \
+		ok     = false;     \
+	} else if (p->VAR > MAX) {  \
+		p->VAR = MAX;       \
+		ok     = false;     \
+	}
+	CLAMP (inputgain, -10.f, 30.f);
+	CLAMP (threshold, -50.f, -10.f);
+	CLAMP (ratio, 0.f, 1.f);
+	CLAMP (attack, .001f, .1f);
+	CLAMP (release, .03f, 3.f);
+	CLAMP (hold, 0.f, 1.f);
+#undef CLAMP
+	return ok;
+}
+
+/* parse a "symbol=value" pair using the LV2 port symbols */
+static bool
+darc_params_parse (DarcParams* p, const char* arg)
+{
+	const char* eq = strchr (arg, '=');
+	if (!eq) {
+		return false;
+	}
+	const size_t len = eq - arg;
+	const float  val = atof (eq + 1);
+#define PARAM(SYM, VAR)                                        \
+	if (len == strlen (SYM) && !strncmp (arg, SYM, len)) { \
+		p->VAR = val;                                  \
+		return true;                                   \
+	}
+	PARAM ("inputgain", inputgain);
+	PARAM ("threshold", threshold);
+	PARAM ("Ratio", ratio);
+	PARAM ("ratio", ratio);
+	PARAM ("attack", attack);
+	PARAM ("release", release);
+	PARAM ("hold", hold);
+#undef PARAM
+	return false;
+}
+
+static void
+darc_params_print (FILE* f, const DarcParams* p)
+{
+	fprintf (f, "inputgain=%.1f threshold=%.1f Ratio=%.3f attack=%.4f release=%.3f hold=%.0f\n",
+	         p->inputgain, p->threshold, p->ratio, p->attack, p->release, p->hold);
+}
+
+static void
+deinterleave (float* const* out, const float* in, uint32_t n_channels, uint32_t n_samples)
+{
+	for (uint32_t c = 0; c < n_channels; ++c) {
+		float* o = out[c];
+		for (uint32_t i = 0; i < n_samples; ++i) {
+			o[i] = in[i * n_channels + c];
+		}
+	}
+}
+
+static void
+interleave (float* out, float* const* in, uint32_t n_channels, uint32_t n_samples)
+{
+	for (uint32_t c = 0; c < n_channels; ++c) {
+		const float* s = in[c];
+		for (uint32_t i = 0; i < n_samples; ++i) {
+			out[i * n_channels + c] = s[i];
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,344 @@
+/* darc.lv2 -- runtime control for headless hosts
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_CONTROL_H
+#define _DARC_CONTROL_H
+
+/* Control port description, parsing of text and OSC commands, and a
+ * lock-free single-producer, single-consumer queue to pass commands
+ * to the process callback.
+ *
+ * Text commands: "[<instance>/]<symbol> <value>" or "...<symbol>=<value>"
+ * OSC messages:  "[/darc][/<instance>]/<symbol>" with a single float or
+ *                int32 argument.
+ */
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/darc.h"
+
+#define DARC_N_CTRL DARC_GMIN // control inputs
+#define DARC_CMDQ_SIZE 256     // power of two
+
+typedef struct {
+	const char* symbol;
+	float       dflt;
+	float       min;
+	float       max;
+} DarcCtrlPort;
+
+/* see lv2ttl/darc.ports.ttl.in */
+static const DarcCtrlPort darc_ctrl_ports[DARC_N_CTRL] = {
+	{ "enable", 1.f, 0.f, 1.f },
+	{ "hold", 0.f, 0.f, 1.f },
+	{ "inputgain", 0.f, -10.f, 30.f },
+	{ "threshold", -30.f, -50.f, -10.f },
+	{ "Ratio", 0.f, 0.f, 1.f },
+	{ "attack", .01f, .001f, .1f },
+	{ "release", .3f, .03f, 3.f },
+};
+
+typedef struct {
+	uint32_t instance;
+	uint32_t port;
+	float    value;
+} DarcCmd;
+
+typedef struct {
+	DarcCmd  cmd[DARC_CMDQ_SIZE];
+	uint32_t write;
+	uint32_t read;
+} DarcCmdQueue;
+
+/* called by the control thread */
+static bool
+darc_cmdq_push (DarcCmdQueue* q, const DarcCmd* c)
+{
+	const uint32_t w = q->write;
+	if (w - __atomic_load_n (&q->read, __ATOMIC_ACQUIRE) >= DARC_CMDQ_SIZE) {
+		return false;
+	}
+	q->cmd[w & (DARC_CMDQ_SIZE - 1)] = *c;
+	__atomic_store_n (&q->write, w + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/* called by the process callback */
+static bool
+darc_cmdq_pop (DarcCmdQueue* q, DarcCmd* c)
+{
+	const uint32_t r = q->read;
+	if (r == __atomic_load_n (&q->write, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+	*c = q->cmd[r & (DARC_CMDQ_SIZE - 1)];
+	__atomic_store_n (&q->read, r + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static int
+darc_ctrl_lookup (const char* sym, size_t len)
+{
+	for (int i = 0; i < DARC_N_CTRL; ++i) {
+		if (strlen (darc_ctrl_ports[i].symbol) == len && !strncasecmp (sym, darc_ctrl_ports[i].symbol, len)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void
+darc_ctrl_default (float* ctrl)
+{
+	for (int i = 0; i < DARC_N_CTRL; ++i) {
+		ctrl[i] = darc_ctrl_ports[i].dflt;
+	}
+}
+
+/* parse "[<instance>/]<symbol>", the value is clamped to the port's range,
+ * non-finite values are rejected */
+static bool
+darc_ctrl_target (const char* str, size_t len, float value, DarcCmd* cmd)
+{
+	if (!isfinite (value)) {
+		return false;
+	}
+
+	const char* sl = (const char*)memchr (str, '/', len);
+
+	cmd->instance = 0;
+	if (sl) {
+		char* end;
+		cmd->instance = strtoul (str, &end, 10);
+		if (end != sl) {
+			return false;
+		}
+		len -= sl + 1 - str;
+		str = sl + 1;
+	}
+
+	const int p = darc_ctrl_lookup (str, len);
+	if (p < 0) {
+		return false;
+	}
+
+	const DarcCtrlPort* cp = &darc_ctrl_ports[p];
+	cmd->port              = p;
+	cmd->value             = value < cp->min ? cp->min : (value > cp->max ? cp->max : value);
+	return true;
+}
+
+/* parse a text command, "symbol=value" or "symbol value" */
+static bool
+darc_ctrl_parse (const char* line, DarcCmd* cmd)
+{
+	while (*line == ' ' || *line == '\t') {
+		++line;
+	}
+	const size_t len = strcspn (line, "= \t");
+	if (len == 0 || !line[len]) {
+		return false;
+	}
+
+	char*       end;
+	const char* val   = line + len + 1;
+	const float value = strtof (val, &end);
+	if (end == val) {
+		return false;
+	}
+	return darc_ctrl_target (line, len, value, cmd);
+}
+
+static uint32_t
+darc_osc_u32 (const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* parse an OSC message */
+static bool
+darc_osc_parse (const uint8_t* buf, size_t len, DarcCmd* cmd)
+{
+	const char*  addr = (const char*)buf;
+	const size_t alen = strnlen (addr, len);
+	const size_t toff = (alen + 4) & ~(size_t)3;
+
+	if (len < toff + 8 || addr[0] != '/') {
+		return false;
+	}
+
+	const char* tt = (const char*)&buf[toff];
+	if (tt[0] != ',' || (tt[1] != 'f' && tt[1] != 'i') || tt[2] != '\0') {
+		return false;
+	}
+
+	const uint32_t v = darc_osc_u32 (&buf[toff + 4]);
+	float          value;
+	if (tt[1] == 'f') {
+		memcpy (&value, &v, sizeof (float));
+	} else {
+		value = (int32_t)v;
+	}
+
+	const char* path = addr + 1;
+	size_t      plen = alen - 1;
+	if (plen > 5 && !strncmp (path, "darc/", 5)) {
+		path += 5;
+		plen -= 5;
+	}
+	return darc_ctrl_target (path, plen, value, cmd);
+}
+
+/* ****************************************************************************
+ * command input from stdin and a localhost UDP socket
+ */
+
+typedef struct {
+	char   line[1024];
+	size_t fill;
+	bool   in;  // stdin is open
+	int    udp; // socket or -1
+} DarcCtrlIO;
+
+/* called for every complete line on stdin */
+typedef void (*darc_line_cb) (void* arg, const char* line);
+/* called for every valid text or OSC message received via UDP */
+typedef void (*darc_cmd_cb) (void* arg, const DarcCmd* cmd);
+
+static int
+darc_ctrl_io_init (DarcCtrlIO* io, int udp_port)
+{
+	struct sockaddr_in addr;
+
+	io->fill = 0;
+	io->in   = true;
+	io->udp  = -1;
+
+	if (udp_port <= 0) {
+		return 0;
+	}
+
+	io->udp = socket (AF_INET, SOCK_DGRAM, 0);
+	if (io->udp < 0) {
+		return -1;
+	}
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons (udp_port);
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	if (bind (io->udp, (struct sockaddr*)&addr, sizeof (addr))) {
+		close (io->udp);
+		io->udp = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static void
+darc_ctrl_io_close (DarcCtrlIO* io)
+{
+	if (io->udp >= 0) {
+		close (io->udp);
+	}
+	io->udp = -1;
+}
+
+static void
+darc_ctrl_io_stdin (DarcCtrlIO* io, darc_line_cb line_cb, void* arg)
+{
+	ssize_t rv = read (STDIN_FILENO, &io->line[io->fill], sizeof (io->line) - 1 - io->fill);
+	if (rv <= 0) {
+		io->in = false;
+		return;
+	}
+	io->fill += rv;
+	io->line[io->fill] = '\0';
+
+	char* l = io->line;
+	char* nl;
+	while ((nl = strchr (l, '\n'))) {
+		*nl = '\0';
+		line_cb (arg, l);
+		l = nl + 1;
+	}
+	io->fill -= l - io->line;
+	memmove (io->line, l, io->fill);
+	if (io->fill == sizeof (io->line) - 1) {
+		io->fill = 0; // line too long, discard
+	}
+}
+
+static void
+darc_ctrl_io_udp (DarcCtrlIO* io, darc_cmd_cb cmd_cb, void* arg)
+{
+	uint8_t buf[512];
+	DarcCmd cmd;
+	ssize_t rv = recv (io->udp, buf, sizeof (buf) - 1, 0);
+	if (rv <= 0) {
+		return;
+	}
+	buf[rv] = '\0';
+	if (buf[0] == '/' ? darc_osc_parse (buf, rv, &cmd) : darc_ctrl_parse ((char*)buf, &cmd)) {
+		cmd_cb (arg, &cmd);
+	}
+}
+
+/* wait up to `ms` for input and dispatch it */
+static void
+darc_ctrl_io_poll (DarcCtrlIO* io, int ms, darc_line_cb line_cb, darc_cmd_cb cmd_cb, void* arg)
+{
+	struct pollfd pfd[2];
+	int           n = 0;
+	if (io->in) {
+		pfd[n].fd     = STDIN_FILENO;
+		pfd[n].events = POLLIN;
+		++n;
+	}
+	if (io->udp >= 0) {
+		pfd[n].fd     = io->udp;
+		pfd[n].events = POLLIN;
+		++n;
+	}
+
+	if (poll (pfd, n, ms) <= 0) {
+		return;
+	}
+
+	for (int i = 0; i < n; ++i) {
+		if (!(pfd[i].revents & (POLLIN | POLLHUP))) {
+			continue;
+		}
+		if (pfd[i].fd == STDIN_FILENO) {
+			darc_ctrl_io_stdin (io, line_cb, arg);
+		} else {
+			darc_ctrl_io_udp (io, cmd_cb, arg);
+		}
+	}
+}
+
+#endif
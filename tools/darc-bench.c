@@ -0,0 +1,403 @@
+/* x42-darc-bench -- DSP throughput and worst-case latency
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <xmmintrin.h>
+#define HAVE_TSC
+#endif
+
+/* the plugin, without inline-display */
+#undef DISPLAY_INTERFACE
+#include "../src/lv2.c"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+#define MAX_CHANNELS 8
+#define MAX_BLOCK 8192
+#define RATE 48000
+
+/* Every configuration processes the same amount of audio, split into
+ * blocks of the given size. The input is generated outside of the timed
+ * region, only the call to Dyncomp_process () or run () is measured.
+ */
+
+enum Signal {
+	SIG_STEADY = 0, // -12dBFS sine
+	SIG_AUTOMATED,  // sine, parameters change every block
+	SIG_SILENT,     // digital silence
+	SIG_DENORMAL,   // subnormal noise
+	SIG_NANBURST,   // sine, with a NaN burst every 16th block
+	SIG_LAST
+};
+
+static const char* sig_names[SIG_LAST] = {
+	"steady", "automated", "silent", "denormal", "nanburst"
+};
+
+typedef struct {
+	const char* name;  // "dyncomp" or "run"
+	uint32_t    n_ch;  // number of channels
+	int         index; // lv2 descriptor index, -1: call Dyncomp directly
+} Target;
+
+static const Target targets[] = {
+	{ "dyncomp", 1, -1 },
+	{ "dyncomp", 2, -1 },
+	{ "dyncomp", 4, -1 },
+	{ "dyncomp", 8, -1 },
+	{ "run", 1, 0 },
+	{ "run", 2, 1 },
+};
+
+typedef struct {
+	uint64_t cycles;
+	uint64_t ns;
+} Sample;
+
+static float     bufs[MAX_CHANNELS][MAX_BLOCK];
+static float     ctrl[DARC_INPUT0];
+static uint32_t  rng = 1;
+static const int n_targets = sizeof (targets) / sizeof (Target);
+
+static inline uint64_t
+bench_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t
+bench_cycles (void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc ();
+#else
+	return bench_ns ();
+#endif
+}
+
+static float
+randf (void)
+{
+	rng = rng * 1664525 + 1013904223;
+	return (rng >> 8) / 8388608.f - 1.f;
+}
+
+static void
+generate (enum Signal sig, uint32_t n_ch, uint32_t n, uint64_t pos, uint64_t block)
+{
+	for (uint32_t c = 0; c < n_ch; ++c) {
+		float* b = bufs[c];
+		switch (sig) {
+			case SIG_SILENT:
+				memset (b, 0, n * sizeof (float));
+				break;
+			case SIG_DENORMAL:
+				for (uint32_t i = 0; i < n; ++i) {
+					b[i] = 1e-39f * randf ();
+				}
+				break;
+			default:
+				for (uint32_t i = 0; i < n; ++i) {
+					b[i] = .25f * sinf (2.f * M_PI * 997.f * ((pos + i) % RATE) / RATE + c);
+				}
+				if (sig == SIG_NANBURST && (block % 16) == 15) {
+					const uint32_t nb = n < 32 ? n : 32;
+					for (uint32_t i = 0; i < nb; ++i) {
+						b[(n - nb) / 2 + i] = NAN;
+					}
+				}
+				break;
+		}
+	}
+}
+
+/* parameter values for the given block */
+static void
+automate (enum Signal sig, uint64_t pos)
+{
+	ctrl[DARC_ENABLE]    = 1;
+	ctrl[DARC_HOLD]      = 0;
+	ctrl[DARC_INPUTGAIN] = 0;
+	ctrl[DARC_THRESHOLD] = -30;
+	ctrl[DARC_RATIO]     = .5;
+	ctrl[DARC_ATTACK]    = .01;
+	ctrl[DARC_RELEASE]   = .3;
+
+	if (sig != SIG_AUTOMATED) {
+		return;
+	}
+	/* 0.5Hz sweeps of gain, threshold and ratio, hold toggles every second */
+	const float ph = 2.f * M_PI * (pos % (2 * RATE)) / (2.f * RATE);
+	ctrl[DARC_INPUTGAIN] = 10.f + 10.f * sinf (ph);
+	ctrl[DARC_THRESHOLD] = -30.f + 15.f * sinf (ph + 1.f);
+	ctrl[DARC_RATIO]     = .5f + .45f * sinf (ph + 2.f);
+	ctrl[DARC_HOLD]      = (pos / RATE) & 1;
+}
+
+static int
+cmp_u64 (const void* a, const void* b)
+{
+	const uint64_t x = *(const uint64_t*)a;
+	const uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint64_t
+percentile (const uint64_t* v, size_t n, double p)
+{
+	size_t i = ceil (p * n) - 1;
+	return v[i < n ? i : n - 1];
+}
+
+static void
+bench (const Target* t, enum Signal sig, uint32_t bs, uint64_t n_samples, Sample* s, uint64_t* sorted)
+{
+	const LV2_Descriptor* desc   = NULL;
+	LV2_Handle            handle = NULL;
+	Dyncomp               dc;
+
+	if (t->index < 0) {
+		Dyncomp_init (&dc, RATE, t->n_ch);
+		Dyncomp_reset (&dc);
+	} else {
+		static const LV2_Feature* features[] = { NULL };
+		desc   = lv2_descriptor (t->index);
+		handle = desc->instantiate (desc, RATE, NULL, features);
+		for (uint32_t p = 0; p < DARC_INPUT0; ++p) {
+			desc->connect_port (handle, p, &ctrl[p]);
+		}
+		for (uint32_t c = 0; c < t->n_ch; ++c) {
+			desc->connect_port (handle, DARC_INPUT0 + 2 * c, bufs[c]);
+			desc->connect_port (handle, DARC_OUTPUT0 + 2 * c, bufs[c]);
+		}
+		desc->activate (handle);
+	}
+
+	float* io[MAX_CHANNELS];
+	for (uint32_t c = 0; c < MAX_CHANNELS; ++c) {
+		io[c] = bufs[c];
+	}
+
+	const uint64_t n_blocks = n_samples / bs;
+	uint64_t       total_ns = 0;
+
+	for (uint64_t b = 0; b < n_blocks; ++b) {
+		const uint64_t pos = b * bs;
+		generate (sig, t->n_ch, bs, pos, b);
+		automate (sig, pos);
+
+		uint64_t c0, c1, t0, t1;
+		if (t->index < 0) {
+			t0 = bench_ns ();
+			c0 = bench_cycles ();
+			Dyncomp_set_inputgain (&dc, ctrl[DARC_INPUTGAIN]);
+			Dyncomp_set_threshold (&dc, ctrl[DARC_THRESHOLD]);
+			Dyncomp_set_ratio (&dc, ctrl[DARC_RATIO]);
+			Dyncomp_set_hold (&dc, ctrl[DARC_HOLD] > 0);
+			Dyncomp_process (&dc, bs, io);
+			c1 = bench_cycles ();
+			t1 = bench_ns ();
+		} else {
+			t0 = bench_ns ();
+			c0 = bench_cycles ();
+			desc->run (handle, bs);
+			c1 = bench_cycles ();
+			t1 = bench_ns ();
+		}
+		s[b].cycles = c1 - c0;
+		s[b].ns     = t1 - t0;
+		total_ns += t1 - t0;
+	}
+
+	if (handle) {
+		desc->cleanup (handle);
+	}
+
+	for (uint64_t b = 0; b < n_blocks; ++b) {
+		sorted[b] = s[b].cycles;
+	}
+	qsort (sorted, n_blocks, sizeof (uint64_t), cmp_u64);
+	const uint64_t cyc_p50 = percentile (sorted, n_blocks, .50);
+	const uint64_t cyc_p90 = percentile (sorted, n_blocks, .90);
+	const uint64_t cyc_p99 = percentile (sorted, n_blocks, .99);
+	const uint64_t cyc_max = sorted[n_blocks - 1];
+
+	for (uint64_t b = 0; b < n_blocks; ++b) {
+		sorted[b] = s[b].ns;
+	}
+	qsort (sorted, n_blocks, sizeof (uint64_t), cmp_u64);
+	const uint64_t ns_p99 = percentile (sorted, n_blocks, .99);
+	const uint64_t ns_max = sorted[n_blocks - 1];
+
+	printf ("%s,%u,%s,%u,%" PRIu64 ",%.3f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+	        t->name, t->n_ch, sig_names[sig], bs, n_blocks,
+	        total_ns / (double)(n_blocks * bs),
+	        cyc_p50, cyc_p90, cyc_p99, cyc_max, ns_p99, ns_max);
+	fflush (stdout);
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-bench - x42 Dynamic Compressor DSP benchmark.\n\n"
+	        "Usage: x42-darc-bench [OPTIONS]\n\n"
+	        "Process audio with Dyncomp_process () for 1, 2, 4 and 8 channels,\n"
+	        "and with the plugin's run () for mono and stereo, using block-sizes\n"
+	        "from 16 to 8192 and the input signals: steady, automated, silent,\n"
+	        "denormal and nanburst.\n\n"
+	        "Results are printed as CSV, one line per configuration:\n"
+	        "target,channels,signal,blocksize,blocks,ns_per_sample,\n"
+	        "cycles_p50,cycles_p90,cycles_p99,cycles_max,ns_p99,ns_max\n"
+	        "Cycles are per block, measured with the CPU's timestamp counter\n"
+	        "where available, otherwise they are nanoseconds.\n\n"
+	        "Options:\n"
+	        "  -b, --blocksize <n>     only test the given block-size\n"
+	        "  -f, --flush-denormals   enable flush-to-zero and denormals-are-zero\n"
+	        "  -n, --samples <n>       samples per configuration (default: 1048576)\n"
+	        "  -s, --signal <name>     only test the given signal\n"
+	        "  -t, --target <name>     only test \"dyncomp\" or \"run\"\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "blocksize", required_argument, 0, 'b' },
+		{ "flush-denormals", no_argument, 0, 'f' },
+		{ "samples", required_argument, 0, 'n' },
+		{ "signal", required_argument, 0, 's' },
+		{ "target", required_argument, 0, 't' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	uint32_t    only_bs   = 0;
+	int         only_sig  = -1;
+	const char* only_tgt  = NULL;
+	uint64_t    n_samples = 1 << 20;
+	bool        ftz       = false;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "b:fn:s:t:hV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'b':
+				only_bs = atoi (optarg);
+				if (only_bs < 1 || only_bs > MAX_BLOCK) {
+					fprintf (stderr, "Block-size must be between 1 and %d\n", MAX_BLOCK);
+					return 1;
+				}
+				break;
+			case 'f':
+				ftz = true;
+				break;
+			case 'n':
+				n_samples = strtoull (optarg, NULL, 10);
+				break;
+			case 's':
+				for (int i = 0; i < SIG_LAST; ++i) {
+					if (!strcmp (optarg, sig_names[i])) {
+						only_sig = i;
+					}
+				}
+				if (only_sig < 0) {
+					fprintf (stderr, "Unknown signal: '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 't':
+				only_tgt = optarg;
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-bench version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	if (n_samples < MAX_BLOCK) {
+		n_samples = MAX_BLOCK;
+	}
+
+	if (ftz) {
+#ifdef HAVE_TSC
+		_mm_setcsr (_mm_getcsr () | 0x8040);
+#else
+		fprintf (stderr, "Flush-to-zero is not supported on this architecture\n");
+#endif
+	}
+
+	const uint64_t max_blocks = n_samples / (only_bs ? only_bs : 16);
+
+	Sample*   s      = (Sample*)malloc (max_blocks * sizeof (Sample));
+	uint64_t* sorted = (uint64_t*)malloc (max_blocks * sizeof (uint64_t));
+	if (!s || !sorted) {
+		fprintf (stderr, "Out of memory\n");
+		free (s);
+		free (sorted);
+		return 1;
+	}
+
+	printf ("target,channels,signal,blocksize,blocks,ns_per_sample,"
+	        "cycles_p50,cycles_p90,cycles_p99,cycles_max,ns_p99,ns_max\n");
+
+	for (int t = 0; t < n_targets; ++t) {
+		if (only_tgt && strcmp (only_tgt, targets[t].name)) {
+			continue;
+		}
+		for (int sig = 0; sig < SIG_LAST; ++sig) {
+			if (only_sig >= 0 && sig != only_sig) {
+				continue;
+			}
+			for (uint32_t bs = 16; bs <= MAX_BLOCK; bs *= 2) {
+				rng = 1;
+				bench (&targets[t], (enum Signal)sig, only_bs ? only_bs : bs, n_samples, s, sorted);
+				if (only_bs) {
+					break;
+				}
+			}
+		}
+	}
+
+	free (s);
+	free (sorted);
+	return 0;
+}
@@ -0,0 +1,426 @@
+/* x42-darc-headless -- JACK client without GUI
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <signal.h>
+
+#include <jack/jack.h>
+
+/* the plugin, without inline-display */
+#undef DISPLAY_INTERFACE
+#include "../src/lv2.c"
+
+#include "capfile.h"
+#include "control.h"
+#include "telemetry.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+#define MAX_CONNECT 8
+
+typedef struct {
+	const LV2_Descriptor* desc;
+	LV2_Handle            handle;
+	uint32_t              n_channels;
+
+	jack_client_t* client;
+	jack_port_t*   in[2];
+	jack_port_t*   out[2];
+
+	float ctrl[DARC_LAST]; // control ports, written by process ()
+
+	DarcCmdQueue queue;
+
+	/* counters, written by process () and the xrun callback */
+	uint64_t cycles;
+	uint64_t frames;
+	uint32_t xruns;
+} DarcHeadless;
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void
+catchsig (int sig)
+{
+	keep_running = 0;
+}
+
+static void
+jack_shutdown (void* arg)
+{
+	fprintf (stderr, "JACK server shut down\n");
+	keep_running = 0;
+}
+
+static int
+xrun (void* arg)
+{
+	DarcHeadless* self = (DarcHeadless*)arg;
+	__atomic_add_fetch (&self->xruns, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static int
+process (jack_nframes_t n_samples, void* arg)
+{
+	DarcHeadless* self = (DarcHeadless*)arg;
+
+	DarcCmd cmd;
+	while (darc_cmdq_pop (&self->queue, &cmd)) {
+		self->ctrl[cmd.port] = cmd.value;
+	}
+
+	for (uint32_t c = 0; c < self->n_channels; ++c) {
+		self->desc->connect_port (self->handle, DARC_INPUT0 + 2 * c, jack_port_get_buffer (self->in[c], n_samples));
+		self->desc->connect_port (self->handle, DARC_OUTPUT0 + 2 * c, jack_port_get_buffer (self->out[c], n_samples));
+	}
+
+	self->desc->run (self->handle, n_samples);
+
+	__atomic_store_n (&self->cycles, self->cycles + 1, __ATOMIC_RELAXED);
+	__atomic_store_n (&self->frames, self->frames + n_samples, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static void
+publish_telemetry (DarcHeadless* self, DarcTlm* tlm, bool running)
+{
+	DarcTlmStatus st;
+	memset (&st, 0, sizeof (st));
+	st.running  = running;
+	st.xruns    = __atomic_load_n (&self->xruns, __ATOMIC_RELAXED);
+	st.cycles   = __atomic_load_n (&self->cycles, __ATOMIC_RELAXED);
+	st.frames   = __atomic_load_n (&self->frames, __ATOMIC_RELAXED);
+	st.dsp_load = jack_cpu_load (self->client);
+	darc_tlm_set_status (tlm, &st);
+
+	/* values are only written by process () */
+	DarcTlmMeter m;
+	memset (&m, 0, sizeof (m));
+	m.instance = 1;
+	m.channels = self->n_channels;
+	m.gmin     = self->ctrl[DARC_GMIN];
+	m.gmax     = self->ctrl[DARC_GMAX];
+	m.rms      = self->ctrl[DARC_RMS];
+	memcpy (m.ctrl, self->ctrl, sizeof (m.ctrl));
+	m.resets = __atomic_load_n (&((Darc*)self->handle)->dyncomp.n_reset, __ATOMIC_RELAXED);
+	m.tier   = self->ctrl[DARC_TIER];
+#ifdef DARC_INSTRUMENT
+	DarcInstrumentStats is;
+	if (get_stats (self->handle, &is)) {
+		m.cycles_spl = is.cycles_spl;
+	}
+#endif
+	darc_tlm_set_meter (tlm, 0, &m);
+}
+
+static void
+print_status (DarcHeadless* self)
+{
+	/* values are only written by process () */
+	for (int i = 0; i < DARC_N_CTRL; ++i) {
+		printf ("%s=%g ", darc_ctrl_ports[i].symbol, self->ctrl[i]);
+	}
+	printf ("gain_min=%.1f gain_max=%.1f rms=%.1f tier=%.0f\n",
+	        self->ctrl[DARC_GMIN], self->ctrl[DARC_GMAX], self->ctrl[DARC_RMS], self->ctrl[DARC_TIER]);
+	fflush (stdout);
+}
+
+static void
+handle_line (void* arg, const char* line)
+{
+	DarcHeadless* self = (DarcHeadless*)arg;
+	DarcCmd       cmd;
+	if (!*line || *line == '#') {
+		return;
+	}
+	if (!strcmp (line, "status")) {
+		print_status (self);
+	} else if (!strcmp (line, "quit")) {
+		keep_running = 0;
+	} else if (!darc_ctrl_parse (line, &cmd) || cmd.instance != 0) {
+		fprintf (stderr, "Invalid command: '%s'\n", line);
+	} else if (!darc_cmdq_push (&self->queue, &cmd)) {
+		fprintf (stderr, "Command queue is full\n");
+	}
+}
+
+static void
+handle_cmd (void* arg, const DarcCmd* cmd)
+{
+	DarcHeadless* self = (DarcHeadless*)arg;
+	if (cmd->instance == 0) {
+		darc_cmdq_push (&self->queue, cmd);
+	}
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-headless - x42 Dynamic Compressor, JACK client without GUI.\n\n"
+	        "Usage: x42-darc-headless [OPTIONS] [symbol=value ...]\n\n"
+	        "Initial parameters are given as LV2 port symbol=value pairs:\n"
+	        "enable, hold, inputgain, threshold, Ratio, attack, release.\n\n"
+	        "At runtime, parameters can be changed by writing \"symbol value\" lines\n"
+	        "to stdin, or by sending the same text or an OSC message\n"
+	        "/darc/<symbol> with a float argument to the UDP port on localhost.\n"
+	        "The stdin commands \"status\" and \"quit\" print the current values\n"
+	        "and meters, or terminate the client.\n\n"
+	        "Options:\n"
+	        "  -m, --mono              mono instead of stereo\n"
+	        "  -n, --name <name>       JACK client name (default: x42-darc)\n"
+	        "  -i, --input <port>      connect to input port, repeat for each channel\n"
+	        "  -o, --output <port>     connect to output port, repeat for each channel\n"
+	        "  -u, --udp <port>        listen for commands on the given UDP port\n"
+	        "  -T, --telemetry <id>    publish meters and DSP load in shared memory\n"
+	        "                          " DARC_TLM_PREFIX "<id>, see x42-darc-telemetry\n"
+	        "  -C, --capture <file>    record input and parameters to a file, for\n"
+	        "                          x42-darc-tool replay\n"
+	        "  -B, --budget <percent>  share of the JACK period the DSP may use\n"
+	        "                          before cheaper kernels are used (default: 10),\n"
+	        "                          0 disables the governor\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "mono", no_argument, 0, 'm' },
+		{ "name", required_argument, 0, 'n' },
+		{ "input", required_argument, 0, 'i' },
+		{ "output", required_argument, 0, 'o' },
+		{ "udp", required_argument, 0, 'u' },
+		{ "telemetry", required_argument, 0, 'T' },
+		{ "capture", required_argument, 0, 'C' },
+		{ "budget", required_argument, 0, 'B' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	DarcHeadless self;
+	memset (&self, 0, sizeof (DarcHeadless));
+	self.n_channels = 2;
+
+	const char* name = "x42-darc";
+	const char* conn_in[MAX_CONNECT];
+	const char* conn_out[MAX_CONNECT];
+	int         n_in     = 0;
+	int         n_out    = 0;
+	int         udp_port = 0;
+	const char* tlm_id   = NULL;
+	const char* cap_path = NULL;
+	float       budget   = DARC_GOV_BUDGET;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "mn:i:o:u:T:C:B:hV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'm':
+				self.n_channels = 1;
+				break;
+			case 'n':
+				name = optarg;
+				break;
+			case 'i':
+				if (n_in < MAX_CONNECT) {
+					conn_in[n_in++] = optarg;
+				}
+				break;
+			case 'o':
+				if (n_out < MAX_CONNECT) {
+					conn_out[n_out++] = optarg;
+				}
+				break;
+			case 'u':
+				udp_port = atoi (optarg);
+				break;
+			case 'T':
+				tlm_id = optarg;
+				break;
+			case 'C':
+				cap_path = optarg;
+				break;
+			case 'B':
+				budget = atof (optarg) / 100.f;
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-headless version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	darc_ctrl_default (self.ctrl);
+	for (int i = optind; i < argc; ++i) {
+		DarcCmd cmd;
+		if (!darc_ctrl_parse (argv[i], &cmd) || cmd.instance != 0) {
+			fprintf (stderr, "Invalid parameter: '%s'\n", argv[i]);
+			return 1;
+		}
+		self.ctrl[cmd.port] = cmd.value;
+	}
+
+	DarcCtrlIO io;
+	if (darc_ctrl_io_init (&io, udp_port)) {
+		fprintf (stderr, "Cannot bind to UDP port %d\n", udp_port);
+		return 1;
+	}
+
+	jack_status_t status;
+	self.client = jack_client_open (name, JackNoStartServer, &status);
+	if (!self.client) {
+		fprintf (stderr, "Cannot connect to JACK\n");
+		return 1;
+	}
+
+	static const LV2_Feature* features[] = { NULL };
+
+	self.desc   = lv2_descriptor (self.n_channels == 1 ? 0 : 1);
+	self.handle = self.desc->instantiate (self.desc, jack_get_sample_rate (self.client), NULL, features);
+	if (!self.handle) {
+		jack_client_close (self.client);
+		return 1;
+	}
+
+	for (uint32_t p = 0; p < DARC_INPUT0; ++p) {
+		self.desc->connect_port (self.handle, p, &self.ctrl[p]);
+	}
+	const uint32_t tport = DARC_TIER - (self.n_channels == 1 ? DARC_CONTROL - DARC_INPUT1 : 0);
+	self.desc->connect_port (self.handle, tport, &self.ctrl[DARC_TIER]);
+	gov_set_budget (self.handle, budget);
+
+	static const char* pn_mono[]   = { "in", "out" };
+	static const char* pn_stereo[] = { "inL", "outL", "inR", "outR" };
+
+	const char** pn = self.n_channels == 1 ? pn_mono : pn_stereo;
+	for (uint32_t c = 0; c < self.n_channels; ++c) {
+		self.in[c]  = jack_port_register (self.client, pn[2 * c], JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+		self.out[c] = jack_port_register (self.client, pn[2 * c + 1], JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+		if (!self.in[c] || !self.out[c]) {
+			fprintf (stderr, "Cannot register JACK ports\n");
+			jack_client_close (self.client);
+			self.desc->cleanup (self.handle);
+			return 1;
+		}
+	}
+
+	char    tlm_name[256];
+	DarcTlm tlm;
+	memset (&tlm, 0, sizeof (DarcTlm));
+
+	if (tlm_id) {
+		snprintf (tlm_name, sizeof (tlm_name), DARC_TLM_PREFIX "%s", tlm_id);
+		if (darc_tlm_create (&tlm, tlm_name, 1, jack_get_sample_rate (self.client), name)) {
+			fprintf (stderr, "Cannot create shared memory segment '%s'\n", tlm_name);
+			jack_client_close (self.client);
+			self.desc->cleanup (self.handle);
+			return 1;
+		}
+	}
+
+	DarcCapWriter cap;
+	if (cap_path) {
+		if (darc_capwriter_start (&cap, cap_path, self.n_channels, jack_get_sample_rate (self.client), DARC_CAP_RING)) {
+			fprintf (stderr, "Cannot create capture file '%s'\n", cap_path);
+			jack_client_close (self.client);
+			self.desc->cleanup (self.handle);
+			if (tlm.hdr) {
+				darc_tlm_close (&tlm);
+				shm_unlink (tlm_name);
+			}
+			return 1;
+		}
+		capture_attach (self.handle, &cap.ring);
+	}
+
+	jack_set_process_callback (self.client, process, &self);
+	jack_set_xrun_callback (self.client, xrun, &self);
+	jack_on_shutdown (self.client, jack_shutdown, NULL);
+
+	self.desc->activate (self.handle);
+
+	if (jack_activate (self.client)) {
+		fprintf (stderr, "Cannot activate JACK client\n");
+		jack_client_close (self.client);
+		self.desc->cleanup (self.handle);
+		if (cap_path) {
+			darc_capwriter_stop (&cap);
+		}
+		if (tlm.hdr) {
+			darc_tlm_close (&tlm);
+			shm_unlink (tlm_name);
+		}
+		return 1;
+	}
+
+	for (int i = 0; i < n_in && i < (int)self.n_channels; ++i) {
+		jack_connect (self.client, conn_in[i], jack_port_name (self.in[i]));
+	}
+	for (int i = 0; i < n_out && i < (int)self.n_channels; ++i) {
+		jack_connect (self.client, jack_port_name (self.out[i]), conn_out[i]);
+	}
+
+	signal (SIGINT, catchsig);
+	signal (SIGTERM, catchsig);
+	signal (SIGHUP, catchsig);
+
+	while (keep_running) {
+		darc_ctrl_io_poll (&io, 100, handle_line, handle_cmd, &self);
+		/* there is no LV2 worker, print events of the trace ring */
+		trace_drain ((Darc*)self.handle);
+		if (tlm.hdr) {
+			publish_telemetry (&self, &tlm, true);
+		}
+	}
+
+	jack_deactivate (self.client);
+	trace_drain ((Darc*)self.handle);
+
+	if (cap_path) {
+		capture_attach (self.handle, NULL);
+		if (darc_capwriter_stop (&cap) < 0) {
+			fprintf (stderr, "Error writing capture file '%s'\n", cap_path);
+		}
+	}
+
+	if (tlm.hdr) {
+		publish_telemetry (&self, &tlm, false);
+		darc_tlm_close (&tlm);
+		shm_unlink (tlm_name);
+	}
+	jack_client_close (self.client);
+	self.desc->cleanup (self.handle);
+	darc_ctrl_io_close (&io);
+	return 0;
+}
@@ -0,0 +1,789 @@
+/* x42-darc-multi -- many compressors in a single JACK client
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+
+#include <jack/jack.h>
+
+/* the plugin, without inline-display */
+#undef DISPLAY_INTERFACE
+#include "../src/lv2.c"
+
+#include "control.h"
+#include "telemetry.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+#define MAX_INSTANCES 256
+#define MAX_WORKERS 64
+
+/* Every instance (channel-strip) is made up of one or two units.
+ * A unit is a plugin instance and is the smallest piece of work.
+ *
+ * Each worker owns a contiguous range of units, so a unit is usually
+ * processed by the same CPU core in every cycle. Workers that finish
+ * early steal remaining units from the other workers' ranges.
+ * The JACK process thread acts as worker 0.
+ */
+
+enum Layout {
+	LAYOUT_MONO,   // 1 channel per instance
+	LAYOUT_STEREO, // 2 independent channels, shared parameters
+	LAYOUT_LINKED  // stereo plugin, linked gain
+};
+
+typedef struct {
+	LV2_Handle handle;
+	uint32_t   n_ch;
+	float      meter[3]; // gain_min, gain_max, rms, written by the unit's run ()
+	float      tier;     // DARC_TIER_*, written by the unit's run ()
+
+	jack_port_t* port_in[2];
+	jack_port_t* port_out[2];
+	float*       in[2]; // buffers of the current cycle
+	float*       out[2];
+} DarcUnit;
+
+typedef struct {
+	float    ctrl[DARC_N_CTRL];
+	uint32_t first_unit;
+	uint32_t n_units;
+} DarcInstance;
+
+struct DarcMulti;
+
+typedef struct {
+	uint32_t next __attribute__ ((aligned (64))); // next unit, taken by fetch-add
+	uint32_t start;
+	uint32_t end;
+
+	/* statistics, written by the worker only */
+	uint64_t busy_ns __attribute__ ((aligned (64)));
+	uint64_t units;
+	uint64_t stolen;
+
+	struct DarcMulti*    self;
+	uint32_t             id;
+	int                  cpu;
+	sem_t                wake;
+	jack_native_thread_t thread;
+} DarcWorker;
+
+typedef struct DarcMulti {
+	const LV2_Descriptor* desc;
+	jack_client_t*        client;
+
+	enum Layout  layout;
+	DarcInstance inst[MAX_INSTANCES];
+	uint32_t     n_inst;
+	DarcUnit*    unit;
+	uint32_t     n_units;
+	float        budget; // per unit, share of the period
+
+	DarcWorker worker[MAX_WORKERS];
+	uint32_t   n_workers;
+	uint32_t   remaining __attribute__ ((aligned (64)));
+	uint32_t   n_samples;
+	bool       quit;
+
+	DarcCmdQueue queue;
+
+	/* counters, written by process () and the xrun callback */
+	uint64_t cycles;
+	uint64_t frames;
+	uint32_t xruns;
+} DarcMulti;
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void
+catchsig (int sig)
+{
+	keep_running = 0;
+}
+
+static void
+jack_shutdown (void* arg)
+{
+	fprintf (stderr, "JACK server shut down\n");
+	keep_running = 0;
+}
+
+static uint64_t
+now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void
+cpu_relax (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause ();
+#endif
+}
+
+/* ****************************************************************************
+ * realtime processing
+ */
+
+static void
+run_unit (DarcMulti* self, DarcUnit* u)
+{
+	for (uint32_t c = 0; c < u->n_ch; ++c) {
+		self->desc->connect_port (u->handle, DARC_INPUT0 + 2 * c, u->in[c]);
+		self->desc->connect_port (u->handle, DARC_OUTPUT0 + 2 * c, u->out[c]);
+	}
+	self->desc->run (u->handle, self->n_samples);
+}
+
+static void
+work (DarcMulti* self, uint32_t id)
+{
+	DarcWorker*    w      = &self->worker[id];
+	const uint64_t t0     = now_ns ();
+	uint64_t       done   = 0;
+	uint64_t       stolen = 0;
+
+	/* own range first, then steal from the others */
+	for (uint32_t k = 0; k < self->n_workers; ++k) {
+		DarcWorker* v = &self->worker[(id + k) % self->n_workers];
+		uint32_t    u;
+		while ((u = __atomic_fetch_add (&v->next, 1, __ATOMIC_ACQ_REL)) < v->end) {
+			run_unit (self, &self->unit[u]);
+			__atomic_sub_fetch (&self->remaining, 1, __ATOMIC_RELEASE);
+			++done;
+			stolen += k > 0;
+		}
+	}
+
+	__atomic_store_n (&w->busy_ns, w->busy_ns + now_ns () - t0, __ATOMIC_RELAXED);
+	__atomic_store_n (&w->units, w->units + done, __ATOMIC_RELAXED);
+	__atomic_store_n (&w->stolen, w->stolen + stolen, __ATOMIC_RELAXED);
+}
+
+static void*
+worker_thread (void* arg)
+{
+	DarcWorker* w    = (DarcWorker*)arg;
+	DarcMulti*  self = w->self;
+
+#ifdef __linux__
+	if (w->cpu >= 0) {
+		cpu_set_t cpuset;
+		CPU_ZERO (&cpuset);
+		CPU_SET (w->cpu, &cpuset);
+		if (pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t), &cpuset)) {
+			fprintf (stderr, "Cannot pin worker %u to CPU %d\n", w->id, w->cpu);
+		}
+	}
+#endif
+
+	while (true) {
+		sem_wait (&w->wake);
+		if (__atomic_load_n (&self->quit, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+		work (self, w->id);
+	}
+	return NULL;
+}
+
+static void
+apply_cmd (DarcMulti* self, const DarcCmd* cmd)
+{
+	if (cmd->instance == 0) {
+		for (uint32_t i = 0; i < self->n_inst; ++i) {
+			self->inst[i].ctrl[cmd->port] = cmd->value;
+		}
+	} else if (cmd->instance <= self->n_inst) {
+		self->inst[cmd->instance - 1].ctrl[cmd->port] = cmd->value;
+	}
+}
+
+static int
+process (jack_nframes_t n_samples, void* arg)
+{
+	DarcMulti* self = (DarcMulti*)arg;
+
+	DarcCmd cmd;
+	while (darc_cmdq_pop (&self->queue, &cmd)) {
+		apply_cmd (self, &cmd);
+	}
+
+	for (uint32_t i = 0; i < self->n_units; ++i) {
+		DarcUnit* u = &self->unit[i];
+		for (uint32_t c = 0; c < u->n_ch; ++c) {
+			u->in[c]  = (float*)jack_port_get_buffer (u->port_in[c], n_samples);
+			u->out[c] = (float*)jack_port_get_buffer (u->port_out[c], n_samples);
+		}
+	}
+
+	self->n_samples = n_samples;
+	__atomic_store_n (&self->remaining, self->n_units, __ATOMIC_RELAXED);
+
+	/* publish the work, then wake up helpers */
+	for (uint32_t k = 0; k < self->n_workers; ++k) {
+		__atomic_store_n (&self->worker[k].next, self->worker[k].start, __ATOMIC_RELEASE);
+	}
+	for (uint32_t k = 1; k < self->n_workers; ++k) {
+		sem_post (&self->worker[k].wake);
+	}
+
+	work (self, 0);
+
+	/* wait for units that are still being processed by helpers */
+	while (__atomic_load_n (&self->remaining, __ATOMIC_ACQUIRE) > 0) {
+		cpu_relax ();
+	}
+
+	__atomic_store_n (&self->cycles, self->cycles + 1, __ATOMIC_RELAXED);
+	__atomic_store_n (&self->frames, self->frames + n_samples, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static int
+xrun (void* arg)
+{
+	DarcMulti* self = (DarcMulti*)arg;
+	__atomic_add_fetch (&self->xruns, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/* ****************************************************************************
+ * control thread
+ */
+
+typedef struct {
+	uint64_t t;
+	uint64_t busy_ns[MAX_WORKERS];
+	uint64_t units[MAX_WORKERS];
+	uint64_t stolen[MAX_WORKERS];
+} LoadStats;
+
+static void
+print_load (DarcMulti* self, LoadStats* prev)
+{
+	const uint64_t t  = now_ns ();
+	const double   dt = (t - prev->t) * 1e-9;
+	prev->t           = t;
+
+	printf ("DSP load: %.1f%%\n", jack_cpu_load (self->client));
+	for (uint32_t k = 0; k < self->n_workers; ++k) {
+		DarcWorker*    w      = &self->worker[k];
+		const uint64_t busy   = __atomic_load_n (&w->busy_ns, __ATOMIC_RELAXED);
+		const uint64_t units  = __atomic_load_n (&w->units, __ATOMIC_RELAXED);
+		const uint64_t stolen = __atomic_load_n (&w->stolen, __ATOMIC_RELAXED);
+		const double   load   = dt > 0 ? 100. * (busy - prev->busy_ns[k]) * 1e-9 / dt : 0;
+
+		printf (" worker %2u (cpu %2d): load %5.1f%%, units %u..%u, processed %lu, stolen %lu\n",
+		        k, w->cpu, load, w->start + 1, w->end,
+		        (unsigned long)(units - prev->units[k]), (unsigned long)(stolen - prev->stolen[k]));
+
+		prev->busy_ns[k] = busy;
+		prev->units[k]   = units;
+		prev->stolen[k]  = stolen;
+	}
+	fflush (stdout);
+}
+
+static void
+print_status (DarcMulti* self)
+{
+	/* values are only written by process () */
+	for (uint32_t i = 0; i < self->n_inst; ++i) {
+		DarcInstance* inst = &self->inst[i];
+		float         gmin = 0, gmax = 0, rms = -100, tier = 0;
+		for (uint32_t j = 0; j < inst->n_units; ++j) {
+			const float* m = self->unit[inst->first_unit + j].meter;
+			gmin           = j == 0 || m[0] < gmin ? m[0] : gmin;
+			gmax           = j == 0 || m[1] > gmax ? m[1] : gmax;
+			rms            = j == 0 || m[2] > rms ? m[2] : rms;
+			tier           = fmaxf (tier, self->unit[inst->first_unit + j].tier);
+		}
+		printf ("%3u: ", i + 1);
+		for (int p = 0; p < DARC_N_CTRL; ++p) {
+			printf ("%s=%g ", darc_ctrl_ports[p].symbol, inst->ctrl[p]);
+		}
+		printf ("gain_min=%.1f gain_max=%.1f rms=%.1f tier=%.0f\n", gmin, gmax, rms, tier);
+	}
+	fflush (stdout);
+}
+
+static void
+publish_telemetry (DarcMulti* self, DarcTlm* tlm, bool running)
+{
+	DarcTlmStatus st;
+	memset (&st, 0, sizeof (st));
+	st.running  = running;
+	st.xruns    = __atomic_load_n (&self->xruns, __ATOMIC_RELAXED);
+	st.cycles   = __atomic_load_n (&self->cycles, __ATOMIC_RELAXED);
+	st.frames   = __atomic_load_n (&self->frames, __ATOMIC_RELAXED);
+	st.dsp_load = jack_cpu_load (self->client);
+	darc_tlm_set_status (tlm, &st);
+
+	/* values are only written by process () */
+	for (uint32_t i = 0; i < self->n_inst; ++i) {
+		DarcInstance* inst = &self->inst[i];
+		for (uint32_t j = 0; j < inst->n_units; ++j) {
+			const uint32_t k = inst->first_unit + j;
+			DarcUnit*      u = &self->unit[k];
+			DarcTlmMeter   m;
+			memset (&m, 0, sizeof (m));
+			m.instance = i + 1;
+			m.channels = u->n_ch;
+			m.gmin     = u->meter[0];
+			m.gmax     = u->meter[1];
+			m.rms      = u->meter[2];
+			memcpy (m.ctrl, inst->ctrl, sizeof (m.ctrl));
+			m.resets = __atomic_load_n (&((Darc*)u->handle)->dyncomp.n_reset, __ATOMIC_RELAXED);
+			m.tier   = u->tier;
+#ifdef DARC_INSTRUMENT
+			DarcInstrumentStats is;
+			if (get_stats (u->handle, &is)) {
+				m.cycles_spl = is.cycles_spl;
+			}
+#endif
+			darc_tlm_set_meter (tlm, k, &m);
+		}
+	}
+}
+
+/* there is no LV2 worker, print events of the trace rings */
+static void
+drain_traces (DarcMulti* self)
+{
+	DarcTraceEvent ev;
+	char           msg[128];
+
+	for (uint32_t i = 0; i < self->n_inst; ++i) {
+		const DarcInstance* inst = &self->inst[i];
+		for (uint32_t j = 0; j < inst->n_units; ++j) {
+			Darc*       d  = (Darc*)self->unit[inst->first_unit + j].handle;
+			const char* ch = inst->n_units > 1 ? (j == 0 ? "L" : "R") : "";
+
+			while (darc_trace_pop (&d->trace, &ev)) {
+				darc_trace_format (&ev, d->rate, msg, sizeof (msg));
+				fprintf (stderr, "x42-darc-multi: %u%s: %s\n", i + 1, ch, msg);
+			}
+
+			const uint32_t lost = darc_trace_lost (&d->trace);
+			if (lost > 0) {
+				fprintf (stderr, "x42-darc-multi: %u%s: %u trace event(s) lost\n", i + 1, ch, lost);
+			}
+		}
+	}
+}
+
+typedef struct {
+	DarcMulti* self;
+	LoadStats  load;
+} Control;
+
+static void
+handle_cmd (void* arg, const DarcCmd* cmd)
+{
+	Control* ctl = (Control*)arg;
+	darc_cmdq_push (&ctl->self->queue, cmd);
+}
+
+static void
+handle_line (void* arg, const char* line)
+{
+	Control* ctl = (Control*)arg;
+	DarcCmd  cmd;
+	if (!*line || *line == '#') {
+		return;
+	}
+	if (!strcmp (line, "status")) {
+		print_status (ctl->self);
+	} else if (!strcmp (line, "load")) {
+		print_load (ctl->self, &ctl->load);
+	} else if (!strcmp (line, "quit")) {
+		keep_running = 0;
+	} else if (!darc_ctrl_parse (line, &cmd) || cmd.instance > ctl->self->n_inst) {
+		fprintf (stderr, "Invalid command: '%s'\n", line);
+	} else if (!darc_cmdq_push (&ctl->self->queue, &cmd)) {
+		fprintf (stderr, "Command queue is full\n");
+	}
+}
+
+/* ****************************************************************************
+ * setup
+ */
+
+static int
+create_units (DarcMulti* self, double rate)
+{
+	static const LV2_Feature* features[] = { NULL };
+
+	const uint32_t upi = self->layout == LAYOUT_STEREO ? 2 : 1;
+	const uint32_t ch  = self->layout == LAYOUT_LINKED ? 2 : 1;
+
+	self->desc = lv2_descriptor (ch == 1 ? 0 : 1);
+	self->unit = (DarcUnit*)calloc (self->n_inst * upi, sizeof (DarcUnit));
+	if (!self->unit) {
+		return -1;
+	}
+	self->n_units = self->n_inst * upi;
+
+	for (uint32_t i = 0; i < self->n_inst; ++i) {
+		DarcInstance* inst = &self->inst[i];
+		inst->first_unit   = i * upi;
+		inst->n_units      = upi;
+
+		for (uint32_t j = 0; j < upi; ++j) {
+			DarcUnit* u = &self->unit[i * upi + j];
+			u->n_ch     = ch;
+			u->handle   = self->desc->instantiate (self->desc, rate, NULL, features);
+			if (!u->handle) {
+				return -1;
+			}
+			for (uint32_t p = 0; p < DARC_N_CTRL; ++p) {
+				self->desc->connect_port (u->handle, p, &inst->ctrl[p]);
+			}
+			for (uint32_t p = DARC_GMIN; p < DARC_INPUT0; ++p) {
+				self->desc->connect_port (u->handle, p, &u->meter[p - DARC_GMIN]);
+			}
+			self->desc->connect_port (u->handle, DARC_TIER - (ch == 1 ? DARC_CONTROL - DARC_INPUT1 : 0), &u->tier);
+			gov_set_budget (u->handle, self->budget);
+			self->desc->activate (u->handle);
+
+			for (uint32_t c = 0; c < ch; ++c) {
+				char        in[32];
+				char        out[32];
+				const char* sfx = "";
+				if (upi * ch == 2) {
+					sfx = (j + c) == 0 ? "L" : "R";
+				}
+				snprintf (in, sizeof (in), "in_%u%s", i + 1, sfx);
+				snprintf (out, sizeof (out), "out_%u%s", i + 1, sfx);
+				u->port_in[c]  = jack_port_register (self->client, in, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+				u->port_out[c] = jack_port_register (self->client, out, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+				if (!u->port_in[c] || !u->port_out[c]) {
+					fprintf (stderr, "Cannot register JACK ports\n");
+					return -1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static void
+destroy_units (DarcMulti* self)
+{
+	for (uint32_t i = 0; i < self->n_units; ++i) {
+		if (self->unit[i].handle) {
+			self->desc->cleanup (self->unit[i].handle);
+		}
+	}
+	free (self->unit);
+}
+
+static int
+start_workers (DarcMulti* self, int first_cpu)
+{
+	const int n_cpus   = sysconf (_SC_NPROCESSORS_ONLN);
+	const int priority = jack_client_real_time_priority (self->client);
+	const int rt       = jack_is_realtime (self->client);
+
+	for (uint32_t k = 0; k < self->n_workers; ++k) {
+		DarcWorker* w = &self->worker[k];
+		w->self       = self;
+		w->id         = k;
+		w->start      = k * self->n_units / self->n_workers;
+		w->end        = (k + 1) * self->n_units / self->n_workers;
+		w->next       = w->end;
+		w->cpu        = (first_cpu >= 0 && k > 0) ? (first_cpu + k) % n_cpus : -1;
+		sem_init (&w->wake, 0, 0);
+	}
+
+	for (uint32_t k = 1; k < self->n_workers; ++k) {
+		DarcWorker* w = &self->worker[k];
+		if (jack_client_create_thread (self->client, &w->thread, priority, rt, worker_thread, w)) {
+			fprintf (stderr, "Cannot start worker thread\n");
+			self->n_workers = k;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void
+stop_workers (DarcMulti* self)
+{
+	__atomic_store_n (&self->quit, true, __ATOMIC_RELEASE);
+	for (uint32_t k = 1; k < self->n_workers; ++k) {
+		sem_post (&self->worker[k].wake);
+		jack_client_stop_thread (self->client, self->worker[k].thread);
+	}
+	for (uint32_t k = 0; k < self->n_workers; ++k) {
+		sem_destroy (&self->worker[k].wake);
+	}
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-multi - x42 Dynamic Compressor, many instances in one JACK client.\n\n"
+	        "Usage: x42-darc-multi [OPTIONS] [[N/]symbol=value ...]\n\n"
+	        "Run N compressor instances in a single JACK client. Processing is\n"
+	        "distributed across a pool of worker threads that are pinned to CPU cores.\n"
+	        "Each worker processes a fixed range of instances and takes over\n"
+	        "remaining work from other workers when it is done.\n\n"
+	        "Parameters are given as LV2 port symbol=value pairs: enable, hold,\n"
+	        "inputgain, threshold, Ratio, attack, release. A \"N/\" prefix addresses\n"
+	        "instance N (1-based), without prefix all instances are set.\n"
+	        "At runtime, the same syntax can be used on stdin or via UDP, which\n"
+	        "also accepts OSC messages /darc/[N/]<symbol> with a float argument.\n"
+	        "The stdin commands \"status\", \"load\" and \"quit\" print parameters\n"
+	        "and meters, per worker CPU load, or terminate the client.\n\n"
+	        "Options:\n"
+	        "  -c, --count <N>         number of instances (default: 8)\n"
+	        "  -t, --type <layout>     mono, stereo (two independent channels) or\n"
+	        "                          linked (stereo, common gain); default: mono\n"
+	        "  -j, --workers <N>       number of worker threads (default: CPU count)\n"
+	        "  -a, --affinity <cpu>    pin worker K to CPU (cpu + K); default: 0\n"
+	        "  -A, --no-affinity       do not pin worker threads\n"
+	        "  -l, --load <sec>        print worker load periodically\n"
+	        "  -n, --name <name>       JACK client name (default: x42-darc-multi)\n"
+	        "  -u, --udp <port>        listen for commands on the given UDP port\n"
+	        "  -T, --telemetry <id>    publish meters and DSP load in shared memory\n"
+	        "                          " DARC_TLM_PREFIX "<id>, see x42-darc-telemetry\n"
+	        "  -B, --budget <percent>  share of the JACK period each instance may use\n"
+	        "                          before cheaper kernels are used (default: 10),\n"
+	        "                          0 disables the governor\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "count", required_argument, 0, 'c' },
+		{ "type", required_argument, 0, 't' },
+		{ "workers", required_argument, 0, 'j' },
+		{ "affinity", required_argument, 0, 'a' },
+		{ "no-affinity", no_argument, 0, 'A' },
+		{ "load", required_argument, 0, 'l' },
+		{ "name", required_argument, 0, 'n' },
+		{ "udp", required_argument, 0, 'u' },
+		{ "telemetry", required_argument, 0, 'T' },
+		{ "budget", required_argument, 0, 'B' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	static DarcMulti self;
+	self.n_inst = 8;
+	self.layout = LAYOUT_MONO;
+	self.budget = DARC_GOV_BUDGET;
+
+	const char* name      = "x42-darc-multi";
+	int         n_workers = sysconf (_SC_NPROCESSORS_ONLN);
+	int         first_cpu = 0;
+	double      interval  = 0;
+	int         udp_port  = 0;
+	const char* tlm_id    = NULL;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "c:t:j:a:Al:n:u:T:B:hV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'c':
+				self.n_inst = atoi (optarg);
+				break;
+			case 't':
+				if (!strcmp (optarg, "mono")) {
+					self.layout = LAYOUT_MONO;
+				} else if (!strcmp (optarg, "stereo")) {
+					self.layout = LAYOUT_STEREO;
+				} else if (!strcmp (optarg, "linked")) {
+					self.layout = LAYOUT_LINKED;
+				} else {
+					fprintf (stderr, "Invalid layout: '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'j':
+				n_workers = atoi (optarg);
+				break;
+			case 'a':
+				first_cpu = atoi (optarg);
+				break;
+			case 'A':
+				first_cpu = -1;
+				break;
+			case 'l':
+				interval = atof (optarg);
+				break;
+			case 'n':
+				name = optarg;
+				break;
+			case 'u':
+				udp_port = atoi (optarg);
+				break;
+			case 'T':
+				tlm_id = optarg;
+				break;
+			case 'B':
+				self.budget = atof (optarg) / 100.f;
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-multi version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	if (self.n_inst < 1 || self.n_inst > MAX_INSTANCES) {
+		fprintf (stderr, "Instance count must be between 1 and %d\n", MAX_INSTANCES);
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < self.n_inst; ++i) {
+		darc_ctrl_default (self.inst[i].ctrl);
+	}
+	for (int i = optind; i < argc; ++i) {
+		DarcCmd cmd;
+		if (!darc_ctrl_parse (argv[i], &cmd) || cmd.instance > self.n_inst) {
+			fprintf (stderr, "Invalid parameter: '%s'\n", argv[i]);
+			return 1;
+		}
+		apply_cmd (&self, &cmd);
+	}
+
+	Control ctl;
+	memset (&ctl, 0, sizeof (Control));
+	ctl.self = &self;
+
+	DarcCtrlIO io;
+	if (darc_ctrl_io_init (&io, udp_port)) {
+		fprintf (stderr, "Cannot bind to UDP port %d\n", udp_port);
+		return 1;
+	}
+
+	jack_status_t status;
+	self.client = jack_client_open (name, JackNoStartServer, &status);
+	if (!self.client) {
+		fprintf (stderr, "Cannot connect to JACK\n");
+		return 1;
+	}
+
+	char    tlm_name[256];
+	DarcTlm tlm;
+	memset (&tlm, 0, sizeof (DarcTlm));
+
+	int rv = 1;
+	if (create_units (&self, jack_get_sample_rate (self.client))) {
+		goto out;
+	}
+
+	if (tlm_id) {
+		snprintf (tlm_name, sizeof (tlm_name), DARC_TLM_PREFIX "%s", tlm_id);
+		if (darc_tlm_create (&tlm, tlm_name, self.n_units, jack_get_sample_rate (self.client), name)) {
+			fprintf (stderr, "Cannot create shared memory segment '%s'\n", tlm_name);
+			goto out;
+		}
+	}
+
+	if (n_workers < 1) {
+		n_workers = 1;
+	}
+	if (n_workers > MAX_WORKERS) {
+		n_workers = MAX_WORKERS;
+	}
+	if ((uint32_t)n_workers > self.n_units) {
+		n_workers = self.n_units;
+	}
+	self.n_workers = n_workers;
+
+	if (start_workers (&self, first_cpu)) {
+		goto out_workers;
+	}
+
+	jack_set_process_callback (self.client, process, &self);
+	jack_set_xrun_callback (self.client, xrun, &self);
+	jack_on_shutdown (self.client, jack_shutdown, NULL);
+
+	if (jack_activate (self.client)) {
+		fprintf (stderr, "Cannot activate JACK client\n");
+		goto out_workers;
+	}
+
+	signal (SIGINT, catchsig);
+	signal (SIGTERM, catchsig);
+	signal (SIGHUP, catchsig);
+
+	ctl.load.t     = now_ns ();
+	uint64_t t_out = ctl.load.t + interval * 1e9;
+
+	while (keep_running) {
+		darc_ctrl_io_poll (&io, 100, handle_line, handle_cmd, &ctl);
+		if (interval > 0 && now_ns () >= t_out) {
+			print_load (&self, &ctl.load);
+			t_out += interval * 1e9;
+		}
+		drain_traces (&self);
+		if (tlm.hdr) {
+			publish_telemetry (&self, &tlm, true);
+		}
+	}
+
+	jack_deactivate (self.client);
+	drain_traces (&self);
+	if (tlm.hdr) {
+		publish_telemetry (&self, &tlm, false);
+	}
+	rv = 0;
+
+out_workers:
+	stop_workers (&self);
+out:
+	if (tlm.hdr) {
+		darc_tlm_close (&tlm);
+		shm_unlink (tlm_name);
+	}
+	jack_client_close (self.client);
+	destroy_units (&self);
+	darc_ctrl_io_close (&io);
+	return rv;
+}
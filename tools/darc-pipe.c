@@ -0,0 +1,283 @@
+/* x42-darc-pipe -- stream processing from stdin to stdout
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "wavio.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+/* frames per block, memory use is constant:
+ * 3 * PIPE_BLOCK * n_channels floats */
+#define PIPE_BLOCK (4 * BLOCKSIZE)
+
+/* The input is read by a separate thread into one of two buffers,
+ * while the other one is processed and written.
+ */
+typedef struct {
+	WavFile         in;
+	float*          buf[2]; // interleaved
+	uint32_t        len[2]; // frames, 0: end of input
+	bool            full[2];
+	bool            quit;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+} Reader;
+
+static void*
+reader_thread (void* arg)
+{
+	Reader* r   = (Reader*)arg;
+	int     cur = 0;
+
+	for (;;) {
+		pthread_mutex_lock (&r->lock);
+		while (r->full[cur] && !r->quit) {
+			pthread_cond_wait (&r->cond, &r->lock);
+		}
+		const bool quit = r->quit;
+		pthread_mutex_unlock (&r->lock);
+
+		if (quit) {
+			break;
+		}
+
+		const uint32_t n = wav_read (&r->in, r->buf[cur], PIPE_BLOCK);
+
+		pthread_mutex_lock (&r->lock);
+		r->len[cur]  = n;
+		r->full[cur] = true;
+		pthread_cond_signal (&r->cond);
+		pthread_mutex_unlock (&r->lock);
+
+		if (n == 0) {
+			break;
+		}
+		cur ^= 1;
+	}
+	return NULL;
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-pipe - x42 Dynamic Compressor, stream filter.\n\n"
+	        "Usage: x42-darc-pipe [OPTIONS] [symbol=value ...]\n\n"
+	        "Read audio from stdin, process it and write the result to stdout.\n"
+	        "Input is a WAV file unless --raw is given, output uses the same\n"
+	        "container and sample format as the input.\n"
+	        "Parameters are given as LV2 port symbol=value pairs: inputgain,\n"
+	        "threshold, Ratio, attack, release, hold.\n\n"
+	        "Options:\n"
+	        "  -r, --raw                  read and write headerless PCM\n"
+	        "  -c, --channels <N>         number of channels of raw input (default 2)\n"
+	        "  -s, --rate <Hz>            sample-rate of raw input (default 48000)\n"
+	        "  -f, --format <fmt>         sample format of raw input: 16, 24, 32, float\n"
+	        "                             (default 16)\n"
+	        "  -o, --output-format <fmt>  output sample format (default: same as input)\n"
+	        "  -h, --help                 display this help and exit\n"
+	        "  -V, --version              print version information and exit\n"
+	        "\n"
+	        "Example:\n"
+	        "  sox in.flac -t wav - | x42-darc-pipe threshold=-30 Ratio=0.6 | flac -o out.flac -\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "raw", no_argument, 0, 'r' },
+		{ "channels", required_argument, 0, 'c' },
+		{ "rate", required_argument, 0, 's' },
+		{ "format", required_argument, 0, 'f' },
+		{ "output-format", required_argument, 0, 'o' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	bool      raw        = false;
+	int       n_channels = 2;
+	int       rate       = 48000;
+	WavFormat fmt        = WAV_INT16;
+	WavFormat ofmt       = WAV_INT16;
+	bool      set_ofmt   = false;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "rc:s:f:o:hV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'r':
+				raw = true;
+				break;
+			case 'c':
+				n_channels = atoi (optarg);
+				break;
+			case 's':
+				rate = atoi (optarg);
+				break;
+			case 'f':
+				if (!wav_parse_format (optarg, &fmt)) {
+					fprintf (stderr, "Invalid sample format: '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'o':
+				if (!wav_parse_format (optarg, &ofmt)) {
+					fprintf (stderr, "Invalid sample format: '%s'\n", optarg);
+					return 1;
+				}
+				set_ofmt = true;
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-pipe version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	DarcParams p = darc_default_params;
+	for (int i = optind; i < argc; ++i) {
+		if (!darc_params_parse (&p, argv[i])) {
+			fprintf (stderr, "Invalid parameter: '%s'\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!darc_params_clamp (&p)) {
+		fprintf (stderr, "Note: parameter(s) were clamped to valid range.\n");
+	}
+
+	Reader r;
+	memset (&r, 0, sizeof (Reader));
+
+	if (raw) {
+		if (n_channels < 1 || n_channels > MAX_CHANNELS || rate < 1) {
+			fprintf (stderr, "Invalid channel-count or sample-rate.\n");
+			return 1;
+		}
+		wav_open_raw (&r.in, stdin, rate, n_channels, fmt, false);
+	} else if (wav_open_read (&r.in, stdin)) {
+		fprintf (stderr, "Unsupported or invalid input format.\n");
+		return 1;
+	}
+
+	if (r.in.n_channels > MAX_CHANNELS) {
+		fprintf (stderr, "Too many channels (max %d)\n", MAX_CHANNELS);
+		return 1;
+	}
+
+	n_channels = r.in.n_channels;
+	if (!set_ofmt) {
+		ofmt = r.in.fmt;
+	}
+
+	WavFile out;
+	if (raw) {
+		wav_open_raw (&out, stdout, r.in.rate, n_channels, ofmt, true);
+	} else if (wav_open_write (&out, stdout, r.in.rate, n_channels, ofmt)) {
+		fprintf (stderr, "Cannot write to stdout.\n");
+		return 1;
+	}
+
+	float* pbuf[MAX_CHANNELS];
+	for (int i = 0; i < 2; ++i) {
+		r.buf[i] = (float*)malloc (PIPE_BLOCK * n_channels * sizeof (float));
+	}
+	for (int i = 0; i < n_channels; ++i) {
+		pbuf[i] = (float*)malloc (PIPE_BLOCK * sizeof (float));
+	}
+
+	Dyncomp dyncomp;
+	Dyncomp_init (&dyncomp, r.in.rate, n_channels);
+	darc_params_apply (&dyncomp, &p);
+
+	pthread_t thread;
+	pthread_mutex_init (&r.lock, NULL);
+	pthread_cond_init (&r.cond, NULL);
+	pthread_create (&thread, NULL, reader_thread, &r);
+
+	int rv  = 0;
+	int cur = 0;
+	for (;;) {
+		pthread_mutex_lock (&r.lock);
+		while (!r.full[cur]) {
+			pthread_cond_wait (&r.cond, &r.lock);
+		}
+		const uint32_t n = r.len[cur];
+		pthread_mutex_unlock (&r.lock);
+
+		if (n == 0) {
+			break;
+		}
+
+		deinterleave (pbuf, r.buf[cur], n_channels, n);
+		Dyncomp_process (&dyncomp, n, pbuf);
+		interleave (r.buf[cur], pbuf, n_channels, n);
+
+		if (wav_write (&out, r.buf[cur], n) != n) {
+			rv = 1;
+			break;
+		}
+
+		pthread_mutex_lock (&r.lock);
+		r.full[cur] = false;
+		pthread_cond_signal (&r.cond);
+		pthread_mutex_unlock (&r.lock);
+		cur ^= 1;
+	}
+
+	pthread_mutex_lock (&r.lock);
+	r.quit = true;
+	pthread_cond_signal (&r.cond);
+	pthread_mutex_unlock (&r.lock);
+
+	if (rv == 0) {
+		pthread_join (thread, NULL);
+	}
+
+	wav_close (&out);
+	if (rv == 0 && ferror (stdout)) {
+		rv = 1;
+	}
+
+	for (int i = 0; i < 2; ++i) {
+		free (r.buf[i]);
+	}
+	for (int i = 0; i < n_channels; ++i) {
+		free (pbuf[i]);
+	}
+	return rv;
+}
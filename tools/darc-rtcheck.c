@@ -0,0 +1,554 @@
+/* x42-darc-rtcheck -- verify that the plugin's run () is realtime-safe
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The plugin binary is loaded and driven through its LV2 descriptor, every
+ * call to run () is bracketed by rtcheck_enter () / rtcheck_leave ().
+ * Those are provided by the interposer library (tools/rtcheck.c), which
+ * has to be preloaded:
+ *
+ *   LD_PRELOAD=x42/x42-darc-rtcheck.so x42/x42-darc-rtcheck build/darc.so
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LV2_1_18_6
+#include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+#include <lv2/core/lv2.h>
+#include <lv2/log/log.h>
+#include <lv2/urid/urid.h>
+#include <lv2/worker/worker.h>
+#else
+#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/log/log.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
+#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
+#endif
+
+#ifdef DISPLAY_INTERFACE
+#include "lv2_rgext.h"
+#endif
+
+#include "../src/capture.h"
+#include "../src/darc.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+#define MAX_BLOCK 8192
+#define RATE 48000
+
+enum Signal {
+	SIG_SINE = 0,  // -12dBFS sine
+	SIG_AUTOMATED, // sine, all parameters change every block
+	SIG_SILENT,    // digital silence
+	SIG_DENORMAL,  // subnormal noise
+	SIG_NANBURST,  // sine, with a NaN burst every 16th block
+	SIG_UI,        // sine, meter stream toggles, notify buffer overflows
+	SIG_LAST
+};
+
+static const char* sig_names[SIG_LAST] = {
+	"sine", "automated", "silent", "denormal", "nanburst", "ui"
+};
+
+static const uint32_t block_sizes[] = { 1, 17, 64, 256, 1000, 4096, MAX_BLOCK };
+
+typedef void (*RtFn) (void);
+typedef const char* (*RtStat) (int, uint64_t*);
+
+static RtFn   rtcheck_enter;
+static RtFn   rtcheck_leave;
+static RtStat rtcheck_stat;
+
+static float    in_buf[2][MAX_BLOCK];
+static float    out_buf[2][MAX_BLOCK];
+static float    ctrl[DARC_INPUT0];
+static float    tier;
+static uint64_t ctl_buf[64];
+static uint64_t ntf_buf[2048];
+static uint8_t  cap_buf[1 << 17]; // smaller than the largest stereo block
+static uint32_t rng = 1;
+
+/* host callbacks */
+static bool     in_run;
+static uint32_t n_map_rt;
+static uint32_t n_queue_draw;
+static uint32_t n_schedule;
+static uint32_t n_log;
+static bool     work_pending;
+
+static const char* uri_table[32];
+static uint32_t    n_uris;
+
+static float
+randf (void)
+{
+	rng = rng * 1664525 + 1013904223;
+	return (rng >> 8) / 8388608.f - 1.f;
+}
+
+/* ****************************************************************************
+ * host features
+ */
+
+static LV2_URID
+urid_map (LV2_URID_Map_Handle handle, const char* uri)
+{
+	/* a host's map function is usually not realtime-safe */
+	if (in_run) {
+		++n_map_rt;
+	}
+	for (uint32_t i = 0; i < n_uris; ++i) {
+		if (!strcmp (uri_table[i], uri)) {
+			return i + 1;
+		}
+	}
+	if (n_uris == sizeof (uri_table) / sizeof (char*)) {
+		return 0;
+	}
+	uri_table[n_uris] = uri;
+	return ++n_uris;
+}
+
+static void
+queue_draw (void* handle)
+{
+	/* this is allowed from run (), the host only sets a flag */
+	++n_queue_draw;
+}
+
+static LV2_Worker_Status
+schedule_work (LV2_Worker_Schedule_Handle handle, uint32_t size, const void* data)
+{
+	/* a host copies the message to a ring-buffer, the worker runs after run () */
+	++n_schedule;
+	work_pending = true;
+	return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status
+work_respond (LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+{
+	return LV2_WORKER_SUCCESS;
+}
+
+/* trace messages are formatted by the worker, count and discard them */
+static int
+log_vprintf (LV2_Log_Handle handle, LV2_URID type, const char* fmt, va_list ap)
+{
+	++n_log;
+	return 0;
+}
+
+static int
+log_printf (LV2_Log_Handle handle, LV2_URID type, const char* fmt, ...)
+{
+	++n_log;
+	return 0;
+}
+
+/* ****************************************************************************
+ * test signals
+ */
+
+static void
+generate (enum Signal sig, uint32_t n_ch, uint32_t n, uint64_t pos, uint64_t block)
+{
+	for (uint32_t c = 0; c < n_ch; ++c) {
+		float* b = in_buf[c];
+		switch (sig) {
+			case SIG_SILENT:
+				memset (b, 0, n * sizeof (float));
+				break;
+			case SIG_DENORMAL:
+				for (uint32_t i = 0; i < n; ++i) {
+					b[i] = 1e-39f * randf ();
+				}
+				break;
+			default:
+				for (uint32_t i = 0; i < n; ++i) {
+					b[i] = .25f * sinf (2.f * M_PI * 997.f * ((pos + i) % RATE) / RATE + c);
+				}
+				if (sig == SIG_NANBURST && (block % 16) == 15) {
+					const uint32_t nb = n < 32 ? n : 32;
+					for (uint32_t i = 0; i < nb; ++i) {
+						b[(n - nb) / 2 + i] = NAN;
+					}
+				}
+				break;
+		}
+	}
+}
+
+static void
+automate (enum Signal sig, uint64_t block)
+{
+	ctrl[DARC_ENABLE]    = 1;
+	ctrl[DARC_HOLD]      = 0;
+	ctrl[DARC_INPUTGAIN] = 0;
+	ctrl[DARC_THRESHOLD] = -30;
+	ctrl[DARC_RATIO]     = .5;
+	ctrl[DARC_ATTACK]    = .01;
+	ctrl[DARC_RELEASE]   = .3;
+
+	if (sig != SIG_AUTOMATED) {
+		return;
+	}
+	ctrl[DARC_ENABLE]    = (block % 7) != 6;
+	ctrl[DARC_HOLD]      = block & 1;
+	ctrl[DARC_INPUTGAIN] = -20.f + (block % 61);
+	ctrl[DARC_THRESHOLD] = -50.f + (block % 51);
+	ctrl[DARC_RATIO]     = (block % 11) / 10.f;
+	ctrl[DARC_ATTACK]    = .001f + (block % 10) / 100.f;
+	ctrl[DARC_RELEASE]   = .03f + (block % 20) / 10.f;
+}
+
+/* control input: subscribe or unsubscribe the meter stream */
+static void
+control_message (LV2_URID_Map* map, const char* uri)
+{
+	LV2_Atom_Forge       forge;
+	LV2_Atom_Forge_Frame frame, obj;
+
+	lv2_atom_forge_init (&forge, map);
+	lv2_atom_forge_set_buffer (&forge, (uint8_t*)ctl_buf, sizeof (ctl_buf));
+	lv2_atom_forge_sequence_head (&forge, &frame, 0);
+	if (uri) {
+		lv2_atom_forge_frame_time (&forge, 0);
+		lv2_atom_forge_object (&forge, &obj, 0, urid_map (NULL, uri));
+		lv2_atom_forge_pop (&forge, &obj);
+	}
+	lv2_atom_forge_pop (&forge, &frame);
+}
+
+/* ****************************************************************************/
+
+static uint64_t
+violations (void)
+{
+	uint64_t    total = 0;
+	uint64_t    n;
+	const char* name;
+	for (int i = 0; (name = rtcheck_stat (i, &n)); ++i) {
+		total += n;
+	}
+	return total + n_map_rt;
+}
+
+static bool
+check (const LV2_Descriptor* desc, enum Signal sig, uint32_t bs, uint64_t n_samples)
+{
+	LV2_URID_Map        map    = { NULL, urid_map };
+	LV2_Feature         fmap   = { LV2_URID__map, &map };
+	LV2_Worker_Schedule sched  = { NULL, schedule_work };
+	LV2_Feature         fsched = { LV2_WORKER__schedule, &sched };
+	LV2_Log_Log         log    = { NULL, log_printf, log_vprintf };
+	LV2_Feature         flog   = { LV2_LOG__log, &log };
+#ifdef DISPLAY_INTERFACE
+	LV2_Inline_Display qdraw  = { NULL, queue_draw };
+	LV2_Feature         fdraw = { LV2_INLINEDISPLAY__queue_draw, &qdraw };
+
+	const LV2_Feature* features[] = { &fmap, &fsched, &flog, &fdraw, NULL };
+#else
+	const LV2_Feature* features[] = { &fmap, &fsched, &flog, NULL };
+#endif
+
+	const bool     mono = !strcmp (desc->URI, DARC_URI "mono");
+	const uint32_t n_ch = mono ? 1 : 2;
+
+	LV2_Handle handle = desc->instantiate (desc, RATE, NULL, features);
+	if (!handle) {
+		fprintf (stderr, "Cannot instantiate %s\n", desc->URI);
+		return false;
+	}
+
+#ifdef DISPLAY_INTERFACE
+	const LV2_Inline_Display_Interface* dpl = NULL;
+	if (desc->extension_data) {
+		dpl = (const LV2_Inline_Display_Interface*)desc->extension_data (LV2_INLINEDISPLAY__interface);
+	}
+#endif
+
+	const LV2_Worker_Interface* wif = NULL;
+	if (desc->extension_data) {
+		wif = (const LV2_Worker_Interface*)desc->extension_data (LV2_WORKER__interface);
+	}
+	work_pending = false;
+
+	LV2_Atom_Sequence* ntf = (LV2_Atom_Sequence*)ntf_buf;
+
+	for (uint32_t p = 0; p < DARC_INPUT0; ++p) {
+		desc->connect_port (handle, p, &ctrl[p]);
+	}
+	for (uint32_t c = 0; c < n_ch; ++c) {
+		desc->connect_port (handle, DARC_INPUT0 + 2 * c, in_buf[c]);
+		desc->connect_port (handle, DARC_OUTPUT0 + 2 * c, out_buf[c]);
+	}
+	const uint32_t cport = mono ? DARC_INPUT1 : DARC_CONTROL;
+	desc->connect_port (handle, cport, ctl_buf);
+	desc->connect_port (handle, cport + 1, ntf_buf);
+	desc->connect_port (handle, DARC_TIER - (mono ? DARC_CONTROL - DARC_INPUT1 : 0), &tier);
+
+	control_message (&map, sig == SIG_UI ? NULL : DARC__ui_on);
+	desc->activate (handle);
+
+	/* capture input, the ring is drained every other block */
+	const DarcCaptureInterface* cif = NULL;
+	DarcCapture                 cap;
+	memset (&cap, 0, sizeof (cap));
+	cap.buf  = cap_buf;
+	cap.size = sizeof (cap_buf);
+	if (desc->extension_data) {
+		cif = (const DarcCaptureInterface*)desc->extension_data (DARC__capture);
+	}
+	if (cif) {
+		cif->attach (handle, &cap);
+	}
+
+	/* always over budget, the governor switches through all kernels */
+	const DarcGovernorInterface* gov = NULL;
+	if (desc->extension_data) {
+		gov = (const DarcGovernorInterface*)desc->extension_data (DARC__governor);
+	}
+	if (gov) {
+		gov->set_budget (handle, 1e-9f);
+	}
+
+	const uint64_t before   = violations ();
+	const uint64_t n_blocks = n_samples / bs;
+
+	for (uint64_t b = 0; b < n_blocks; ++b) {
+		generate (sig, n_ch, bs, b * bs, b);
+		automate (sig, b);
+
+		uint32_t capacity = sizeof (ntf_buf) - sizeof (LV2_Atom);
+		if (sig == SIG_UI) {
+			if (b % 8 == 0) {
+				control_message (&map, (b / 8) & 1 ? DARC__ui_off : DARC__ui_on);
+			}
+			if (b % 3 == 2) {
+				capacity = 16; // not even a single event fits
+			}
+		}
+		ntf->atom.size = capacity;
+
+		in_run = true;
+		rtcheck_enter ();
+		desc->run (handle, bs);
+		rtcheck_leave ();
+		in_run = false;
+
+		/* every message is delivered once */
+		control_message (&map, NULL);
+
+		/* the host's worker thread */
+		if (work_pending && wif) {
+			work_pending = false;
+			wif->work (handle, work_respond, NULL, 1, "");
+		}
+
+		if (b & 1) {
+			cap.read = cap.write;
+		}
+
+#ifdef DISPLAY_INTERFACE
+		/* the host renders the inline display in the GUI thread */
+		if (dpl && b % 4 == 3) {
+			dpl->render (handle, 200, 100);
+		}
+#endif
+	}
+
+	if (desc->deactivate) {
+		desc->deactivate (handle);
+	}
+	desc->cleanup (handle);
+
+	const uint64_t n = violations () - before;
+	printf ("%s,%s,%u,%" PRIu64 ",%s\n", mono ? "mono" : "stereo", sig_names[sig], bs, n, n ? "FAIL" : "PASS");
+	fflush (stdout);
+	return n == 0;
+}
+
+/* make sure that the interposer catches violations */
+static bool
+self_test (void)
+{
+	rtcheck_enter ();
+	void* volatile p = malloc (32);
+	free (p);
+	rtcheck_leave ();
+	return violations () == 2;
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-rtcheck - verify that the DSP is realtime-safe.\n\n"
+	        "Usage: LD_PRELOAD=x42-darc-rtcheck.so x42-darc-rtcheck [OPTIONS] <plugin.so>\n\n"
+	        "Load the plugin and drive all its descriptors with various block-sizes\n"
+	        "and input signals, with meter stream, inline display and worker. Memory\n"
+	        "allocation, locks, sleep and I/O calls during run () are reported as\n"
+	        "violation, as well as calls to the host's URID map.\n\n"
+	        "Results are printed as CSV, one line per configuration:\n"
+	        "plugin,signal,blocksize,violations,result\n"
+	        "followed by a summary per function. Set RTCHECK_ABORT=1 to abort at\n"
+	        "the first violation, to get a backtrace. The exit code is non-zero\n"
+	        "if any violation was detected.\n\n"
+	        "Options:\n"
+	        "  -b, --blocksize <n>     only test the given block-size\n"
+	        "  -n, --samples <n>       samples per configuration (default: 65536)\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "blocksize", required_argument, 0, 'b' },
+		{ "samples", required_argument, 0, 'n' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	uint32_t only_bs   = 0;
+	uint64_t n_samples = 1 << 16;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "b:n:hV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'b':
+				only_bs = atoi (optarg);
+				if (only_bs < 1 || only_bs > MAX_BLOCK) {
+					fprintf (stderr, "Block-size must be between 1 and %d\n", MAX_BLOCK);
+					return 1;
+				}
+				break;
+			case 'n':
+				n_samples = strtoull (optarg, NULL, 10);
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-rtcheck version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		usage ();
+		return 1;
+	}
+
+	if (n_samples < MAX_BLOCK) {
+		n_samples = MAX_BLOCK;
+	}
+
+	*(void**)(&rtcheck_enter) = dlsym (RTLD_DEFAULT, "rtcheck_enter");
+	*(void**)(&rtcheck_leave) = dlsym (RTLD_DEFAULT, "rtcheck_leave");
+	*(void**)(&rtcheck_stat)  = dlsym (RTLD_DEFAULT, "rtcheck_stat");
+
+	if (!rtcheck_enter || !rtcheck_leave || !rtcheck_stat) {
+		fprintf (stderr, "The interposer library is not loaded, use LD_PRELOAD=x42-darc-rtcheck.so\n");
+		return 1;
+	}
+
+	if (!self_test ()) {
+		fprintf (stderr, "The interposer library does not detect malloc/free\n");
+		return 1;
+	}
+
+	void* lib = dlopen (argv[optind], RTLD_NOW | RTLD_LOCAL);
+	if (!lib) {
+		fprintf (stderr, "Cannot load plugin: %s\n", dlerror ());
+		return 1;
+	}
+
+	LV2_Descriptor_Function lv2_descriptor;
+	*(void**)(&lv2_descriptor) = dlsym (lib, "lv2_descriptor");
+	if (!lv2_descriptor) {
+		fprintf (stderr, "'%s' is not an LV2 plugin\n", argv[optind]);
+		dlclose (lib);
+		return 1;
+	}
+
+	/* exclude the self-test from the summary */
+	uint64_t    base[64];
+	uint64_t    n;
+	const char* name;
+	memset (base, 0, sizeof (base));
+	for (int i = 0; i < 64 && (name = rtcheck_stat (i, &n)); ++i) {
+		base[i] = n;
+	}
+
+	const uint64_t total = violations ();
+	bool           ok    = true;
+
+	printf ("plugin,signal,blocksize,violations,result\n");
+
+	const LV2_Descriptor* desc;
+	for (uint32_t i = 0; (desc = lv2_descriptor (i)); ++i) {
+		for (int s = 0; s < SIG_LAST; ++s) {
+			for (uint32_t k = 0; k < sizeof (block_sizes) / sizeof (uint32_t); ++k) {
+				const uint32_t bs = only_bs ? only_bs : block_sizes[k];
+				ok &= check (desc, (enum Signal)s, bs, n_samples);
+				if (only_bs) {
+					break;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < 64 && (name = rtcheck_stat (i, &n)); ++i) {
+		if (n > base[i]) {
+			fprintf (stderr, "%s: %" PRIu64 "\n", name, n - base[i]);
+		}
+	}
+	if (n_map_rt > 0) {
+		fprintf (stderr, "urid:map: %u\n", n_map_rt);
+	}
+	fprintf (stderr, "%" PRIu64 " violation(s), queue_draw called %u times, schedule_work %u times (%u log messages)\n",
+	         violations () - total, n_queue_draw, n_schedule, n_log);
+
+	dlclose (lib);
+	return ok ? 0 : 1;
+}
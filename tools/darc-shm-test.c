@@ -0,0 +1,250 @@
+/* x42-darc-shm-test -- test client for x42-darc-shm
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "shmring.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+#define MAX_QUEUE 64
+
+static double
+now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-shm-test - test client for x42-darc-shm.\n\n"
+	        "Usage: x42-darc-shm-test [OPTIONS] [symbol=value ...]\n\n"
+	        "Attach to a running x42-darc-shm engine, write a test signal\n"
+	        "(a sine alternating between -40 and -6 dBFS every 500ms) to the\n"
+	        "ring-buffer, read back the processed audio and report throughput\n"
+	        "and round-trip latency. Optional symbol=value pairs are sent to the\n"
+	        "engine before starting.\n\n"
+	        "Options:\n"
+	        "  -n, --name <name>       name of the segment (default: " DARC_SHM_NAME ")\n"
+	        "  -p, --period <frames>   frames per write (default 256)\n"
+	        "  -q, --queue <N>         periods in flight (default 2)\n"
+	        "  -d, --duration <sec>    duration of the test signal (default 10)\n"
+	        "  -r, --realtime          pace writes at the sample-rate\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "name", required_argument, 0, 'n' },
+		{ "period", required_argument, 0, 'p' },
+		{ "queue", required_argument, 0, 'q' },
+		{ "duration", required_argument, 0, 'd' },
+		{ "realtime", no_argument, 0, 'r' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	const char* name     = DARC_SHM_NAME;
+	int         period   = 256;
+	int         queue    = 2;
+	double      duration = 10;
+	bool        realtime = false;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "n:p:q:d:rhV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'n':
+				name = optarg;
+				break;
+			case 'p':
+				period = atoi (optarg);
+				break;
+			case 'q':
+				queue = atoi (optarg);
+				break;
+			case 'd':
+				duration = atof (optarg);
+				break;
+			case 'r':
+				realtime = true;
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-shm-test version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	DarcShm shm;
+	if (darc_shm_open (&shm, name)) {
+		fprintf (stderr, "Cannot attach to shared memory segment '%s'\n", name);
+		return 1;
+	}
+
+	DarcShmHeader* h          = shm.hdr;
+	const uint32_t n_channels = h->n_channels;
+	const uint32_t n_frames   = h->n_frames;
+	const double   rate       = h->sample_rate;
+
+	if (period < 1 || queue < 1 || queue > MAX_QUEUE || (uint32_t)(period * queue) > n_frames) {
+		fprintf (stderr, "Invalid period or queue size (ring-buffer: %u frames)\n", n_frames);
+		darc_shm_close (&shm);
+		return 1;
+	}
+
+	if (!shm_load (&h->running)) {
+		fprintf (stderr, "Engine is not running\n");
+		darc_shm_close (&shm);
+		return 1;
+	}
+
+	uint32_t w = shm_load (&h->write);
+	uint32_t r = shm_load (&h->read);
+	if (r != w || shm_load (&h->proc) != w) {
+		fprintf (stderr, "Ring-buffer is in use by another client\n");
+		darc_shm_close (&shm);
+		return 1;
+	}
+
+	if (optind < argc) {
+		DarcParams p = h->params;
+		for (int i = optind; i < argc; ++i) {
+			if (!darc_params_parse (&p, argv[i])) {
+				fprintf (stderr, "Invalid parameter: '%s'\n", argv[i]);
+				darc_shm_close (&shm);
+				return 1;
+			}
+		}
+		darc_params_clamp (&p);
+		darc_shm_set_params (&shm, &p);
+	}
+
+	const uint64_t total  = (uint64_t)ceil (duration * rate / period) * period;
+	const double   t_per  = period / rate;
+	uint64_t       n_sent = 0;
+	uint64_t       n_recv = 0;
+	double         t_sent[MAX_QUEUE];
+	double         lat_sum = 0;
+	double         lat_max = 0;
+	float          peak    = 0;
+	double         phase   = 0;
+	int            rv      = 0;
+
+	const double t_start = now ();
+
+	while (n_recv < total) {
+		/* write */
+		while (n_sent < total && n_sent - n_recv < (uint64_t)(period * queue)) {
+			if (realtime) {
+				const double  t = t_start + n_sent / rate;
+				struct timespec ts;
+				ts.tv_sec  = (time_t)t;
+				ts.tv_nsec = (long)((t - ts.tv_sec) * 1e9);
+				clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+			}
+			for (int i = 0; i < period; ++i) {
+				const uint64_t pos = n_sent + i;
+				const float    g   = (pos / (uint64_t)(rate * .5)) & 1 ? .5f : .01f;
+				const float    x   = g * sinf (phase);
+				phase += 2. * M_PI * 1000. / rate;
+				for (uint32_t ch = 0; ch < n_channels; ++ch) {
+					shm.data[ch][(w + i) & shm.mask] = x;
+				}
+			}
+			phase = fmod (phase, 2. * M_PI);
+
+			t_sent[(n_sent / period) % queue] = now ();
+			w += period;
+			n_sent += period;
+			shm_store (&h->write, w);
+			sem_post (&h->ready);
+		}
+
+		/* read back */
+		const uint32_t proc = shm_load (&h->proc);
+		if ((uint32_t)(proc - r) < (uint32_t)period) {
+			if (!darc_shm_wait (&h->done, 1000) && shm_load (&h->proc) == proc) {
+				fprintf (stderr, "Timeout, engine is not responding\n");
+				rv = 1;
+				break;
+			}
+			if (!shm_load (&h->running)) {
+				fprintf (stderr, "Engine terminated\n");
+				rv = 1;
+				break;
+			}
+			continue;
+		}
+
+		const double t = now ();
+		while ((uint32_t)(proc - r) >= (uint32_t)period) {
+			const double lat = t - t_sent[(n_recv / period) % queue];
+			lat_sum += lat;
+			if (lat > lat_max) {
+				lat_max = lat;
+			}
+			for (uint32_t ch = 0; ch < n_channels; ++ch) {
+				for (int i = 0; i < period; ++i) {
+					peak = fmaxf (peak, fabsf (shm.data[ch][(r + i) & shm.mask]));
+				}
+			}
+			r += period;
+			n_recv += period;
+		}
+		shm_store (&h->read, r);
+	}
+
+	const double elapsed  = now () - t_start;
+	const double n_period = n_recv / period;
+
+	printf ("Engine:     %u channels, %.0f Hz, buffer %u frames\n", n_channels, rate, n_frames);
+	printf ("Processed:  %lu frames in %.3f s (%.1fx realtime)\n",
+	        (unsigned long)n_recv, elapsed, elapsed > 0 ? n_recv / rate / elapsed : 0);
+	if (n_period > 0) {
+		printf ("Round-trip: avg %.1f us, max %.1f us (period %d frames = %.1f us)\n",
+		        1e6 * lat_sum / n_period, 1e6 * lat_max, period, 1e6 * t_per);
+	}
+	printf ("Meters:     gain %+.1f .. %+.1f dB, level %.1f dBFS, output peak %.1f dBFS\n",
+	        h->gmin, h->gmax, h->rms, peak > 0 ? 20.f * log10f (peak) : -100.f);
+
+	darc_shm_close (&shm);
+	return rv;
+}
@@ -0,0 +1,185 @@
+/* x42-darc-shm -- process audio in a shared memory ring-buffer
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "shmring.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+static volatile sig_atomic_t run = 1;
+
+static void
+catchsig (int sig)
+{
+	run = 0;
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-shm - x42 Dynamic Compressor, shared memory engine.\n\n"
+	        "Usage: x42-darc-shm [OPTIONS] [symbol=value ...]\n\n"
+	        "Create a POSIX shared memory segment with a ring-buffer and process\n"
+	        "audio written to it by a client process in place. Meters are\n"
+	        "published in the same segment. See tools/shmring.h for the layout.\n"
+	        "Parameters are given as LV2 port symbol=value pairs: inputgain,\n"
+	        "threshold, Ratio, attack, release, hold, and can later be changed\n"
+	        "by the client.\n\n"
+	        "Options:\n"
+	        "  -n, --name <name>       name of the segment (default: " DARC_SHM_NAME ")\n"
+	        "  -c, --channels <N>      number of channels (default 2)\n"
+	        "  -s, --rate <Hz>         sample-rate (default 48000)\n"
+	        "  -b, --buffer <frames>   ring-buffer size, power of two (default 8192)\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "name", required_argument, 0, 'n' },
+		{ "channels", required_argument, 0, 'c' },
+		{ "rate", required_argument, 0, 's' },
+		{ "buffer", required_argument, 0, 'b' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	const char* name       = DARC_SHM_NAME;
+	int         n_channels = 2;
+	int         rate       = 48000;
+	int         n_frames   = 8192;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "n:c:s:b:hV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'n':
+				name = optarg;
+				break;
+			case 'c':
+				n_channels = atoi (optarg);
+				break;
+			case 's':
+				rate = atoi (optarg);
+				break;
+			case 'b':
+				n_frames = atoi (optarg);
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-shm version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	DarcParams p = darc_default_params;
+	for (int i = optind; i < argc; ++i) {
+		if (!darc_params_parse (&p, argv[i])) {
+			fprintf (stderr, "Invalid parameter: '%s'\n", argv[i]);
+			return 1;
+		}
+	}
+	darc_params_clamp (&p);
+
+	if (rate < 1 || n_frames < 2 || n_frames & (n_frames - 1) || n_channels < 1 || n_channels > MAX_CHANNELS) {
+		fprintf (stderr, "Invalid channel-count, sample-rate or buffer-size.\n");
+		return 1;
+	}
+
+	DarcShm shm;
+	if (darc_shm_create (&shm, name, n_channels, rate, n_frames)) {
+		fprintf (stderr, "Cannot create shared memory segment '%s'\n", name);
+		return 1;
+	}
+
+	DarcShmHeader* h = shm.hdr;
+	h->params        = p;
+
+	Dyncomp dyncomp;
+	Dyncomp_init (&dyncomp, rate, n_channels);
+	darc_params_apply (&dyncomp, &p);
+
+	signal (SIGINT, catchsig);
+	signal (SIGTERM, catchsig);
+	signal (SIGHUP, catchsig);
+
+	shm_store (&h->running, 1);
+
+	uint32_t seq  = 0;
+	uint32_t proc = 0;
+
+	while (run) {
+		if (!darc_shm_wait (&h->ready, 100)) {
+			continue;
+		}
+
+		if (darc_shm_get_params (&shm, &seq, &p)) {
+			darc_params_clamp (&p);
+			darc_params_apply (&dyncomp, &p);
+		}
+
+		/* process all available audio in place */
+		const uint32_t write = shm_load (&h->write);
+		while (proc != write) {
+			const uint32_t off = proc & shm.mask;
+			uint32_t       n   = write - proc;
+			if (n > n_frames - off) {
+				n = n_frames - off;
+			}
+			float* io[MAX_CHANNELS];
+			for (int i = 0; i < n_channels; ++i) {
+				io[i] = &shm.data[i][off];
+			}
+			Dyncomp_process (&dyncomp, n, io);
+			proc += n;
+		}
+
+		Dyncomp_get_gain (&dyncomp, &h->gmin, &h->gmax, &h->rms);
+		shm_store (&h->proc, proc);
+		sem_post (&h->done);
+	}
+
+	shm_store (&h->running, 0);
+	sem_post (&h->done);
+
+	darc_shm_close (&shm);
+	shm_unlink (name);
+	return 0;
+}
@@ -0,0 +1,228 @@
+/* x42-darc-telemetry -- read meters published by the JACK clients
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "control.h"
+#include "telemetry.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+#define MAX_SEGMENTS 256
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void
+catchsig (int sig)
+{
+	keep_running = 0;
+}
+
+static uint64_t
+now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* all segments in /dev/shm, Linux only */
+static int
+find_segments (char** ids, int max)
+{
+	int  n   = 0;
+	DIR* dir = opendir ("/dev/shm");
+	if (!dir) {
+		return 0;
+	}
+	const size_t   len = strlen (DARC_TLM_PREFIX) - 1;
+	struct dirent* de;
+	while (n < max && (de = readdir (dir))) {
+		if (!strncmp (de->d_name, DARC_TLM_PREFIX + 1, len)) {
+			ids[n++] = strdup (de->d_name + len);
+		}
+	}
+	closedir (dir);
+	return n;
+}
+
+static void
+print_header (bool status)
+{
+	if (status) {
+		printf ("time,id,client,pid,running,age_ms,cycles,frames,xruns,dsp_load\n");
+		return;
+	}
+	printf ("time,id,instance,channels,gain_min,gain_max,rms");
+	for (int p = 0; p < DARC_N_CTRL; ++p) {
+		printf (",%s", darc_ctrl_ports[p].symbol);
+	}
+	printf (",cycles_spl,resets,tier\n");
+}
+
+static bool
+print_segment (const char* id, bool status, double t)
+{
+	char    name[256];
+	DarcTlm tlm;
+
+	snprintf (name, sizeof (name), DARC_TLM_PREFIX "%s", id);
+	if (darc_tlm_open (&tlm, name)) {
+		return false;
+	}
+
+	const DarcTlmHeader* h = tlm.hdr;
+
+	if (status) {
+		DarcTlmStatus st;
+		if (darc_tlm_get_status (&tlm, &st)) {
+			const double age = st.updated_ns > 0 ? (now_ns () - st.updated_ns) * 1e-6 : -1;
+			printf ("%.3f,%s,%.64s,%u,%u,%.0f,%lu,%lu,%u,%.1f\n",
+			        t, id, h->client, h->pid, st.running, age,
+			        (unsigned long)st.cycles, (unsigned long)st.frames, st.xruns, st.dsp_load);
+		}
+		darc_tlm_close (&tlm);
+		return true;
+	}
+
+	for (uint32_t i = 0; i < h->n_slots; ++i) {
+		DarcTlmMeter m;
+		if (!darc_tlm_get_meter (&tlm, i, &m)) {
+			continue;
+		}
+		printf ("%.3f,%s,%u,%u,%.2f,%.2f,%.2f", t, id, m.instance, m.channels, m.gmin, m.gmax, m.rms);
+		for (int p = 0; p < DARC_N_CTRL; ++p) {
+			printf (",%g", m.ctrl[p]);
+		}
+		printf (",%.2f,%u,%u\n", m.cycles_spl, m.resets, m.tier);
+	}
+	darc_tlm_close (&tlm);
+	return true;
+}
+
+static void
+usage (void)
+{
+	printf ("x42-darc-telemetry - read meters of x42-darc-headless and x42-darc-multi.\n\n"
+	        "Usage: x42-darc-telemetry [OPTIONS] [id ...]\n\n"
+	        "Print the gain, level and parameters of every compressor instance,\n"
+	        "that the JACK clients publish in shared memory when started with\n"
+	        "--telemetry <id>, as CSV. Without ids all segments found in /dev/shm\n"
+	        "are read. Reading does not involve the JACK clients.\n\n"
+	        "Options:\n"
+	        "  -i, --interval <sec>    repeat every <sec> seconds until interrupted\n"
+	        "  -s, --status            print DSP load and counters instead of meters\n"
+	        "  -H, --no-header         do not print the CSV header\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "interval", required_argument, 0, 'i' },
+		{ "status", no_argument, 0, 's' },
+		{ "no-header", no_argument, 0, 'H' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	double interval = 0;
+	bool   status   = false;
+	bool   header   = true;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "i:sHhV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'i':
+				interval = atof (optarg);
+				break;
+			case 's':
+				status = true;
+				break;
+			case 'H':
+				header = false;
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-telemetry version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	signal (SIGINT, catchsig);
+	signal (SIGTERM, catchsig);
+
+	if (header) {
+		print_header (status);
+	}
+
+	int rv = 0;
+	do {
+		char* ids[MAX_SEGMENTS];
+		int   n_ids;
+		bool  found = false;
+
+		if (optind < argc) {
+			n_ids = argc - optind < MAX_SEGMENTS ? argc - optind : MAX_SEGMENTS;
+			for (int i = 0; i < n_ids; ++i) {
+				ids[i] = strdup (argv[optind + i]);
+			}
+		} else {
+			n_ids = find_segments (ids, MAX_SEGMENTS);
+		}
+
+		const double t = now_ns () * 1e-9;
+		for (int i = 0; i < n_ids; ++i) {
+			if (print_segment (ids[i], status, t)) {
+				found = true;
+			} else if (optind < argc) {
+				fprintf (stderr, "Cannot read '" DARC_TLM_PREFIX "%s'\n", ids[i]);
+			}
+			free (ids[i]);
+		}
+		fflush (stdout);
+
+		rv = found ? 0 : 1;
+		if (interval > 0 && keep_running) {
+			usleep (interval * 1e6);
+		}
+	} while (interval > 0 && keep_running);
+
+	return rv;
+}
@@ -0,0 +1,1055 @@
+/* x42-darc-test -- golden-output regression and approximation-error tests
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+
+/* the plugin, without inline-display */
+#undef DISPLAY_INTERFACE
+#include "../src/lv2.c"
+
+#include "checkpoint.h"
+#include "dynbank.h"
+#include "gaintrack.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+#define RATE 48000
+#define N_SAMPLES (8 * RATE)
+#define REF_BLOCK 256
+#define CKPT_INTERVAL 12000
+#define GT_SETTLE 4 // gaintrack, decimation periods after an onset that are not compared
+
+/* Every test signal is rendered with Dyncomp_process () in blocks of
+ * REF_BLOCK samples, parameters are applied at block boundaries the same
+ * way as the plugin's run () does. This is the reference. Each path under
+ * test renders the same signal, and the difference to the reference is
+ * compared to the limits in the table below.
+ *
+ * Paths that only re-arrange the reference kernel must be bit-exact.
+ * Paths which change the block-size, decimate or approximate have a limit
+ * that is a small margin above the error observed when the limit was set.
+ * A decimated gain cannot follow an onset (level change or parameter step)
+ * within the decimation period, those are compared outside a window
+ * around every onset.
+ */
+
+enum Signal {
+	SIG_SWEEP = 0, // log sine sweep 20Hz..20kHz, level ramp -60..0 dBFS
+	SIG_BURSTS,    // 1kHz -3dBFS bursts over a -40dBFS floor
+	SIG_NOISE,     // -10dBFS white noise
+	SIG_SILENCE,   // digital silence
+	SIG_STEPS,     // level-alternating noise, steps in every control port
+	SIG_LAST
+};
+
+static const char* sig_names[SIG_LAST] = {
+	"sweep", "bursts", "noise", "silence", "steps"
+};
+
+/* control-port changes of SIG_STEPS */
+typedef struct {
+	float    t; // sec
+	uint32_t port;
+	float    val;
+} Step;
+
+static const Step steps[] = {
+	{ 0.5f, DARC_INPUTGAIN, 10.f },
+	{ 1.0f, DARC_THRESHOLD, -45.f },
+	{ 1.5f, DARC_RATIO, 1.f },
+	{ 2.0f, DARC_ATTACK, .001f },
+	{ 2.5f, DARC_RELEASE, .03f },
+	{ 3.0f, DARC_HOLD, 1.f },
+	{ 3.5f, DARC_ENABLE, 0.f },
+	{ 4.0f, DARC_ENABLE, 1.f },
+	{ 4.5f, DARC_INPUTGAIN, -10.f },
+	{ 5.0f, DARC_THRESHOLD, -20.f },
+	{ 5.5f, DARC_RATIO, 0.f },
+	{ 6.0f, DARC_ATTACK, .1f },
+	{ 6.5f, DARC_RELEASE, 2.f },
+	{ 7.0f, DARC_HOLD, 0.f },
+	{ 7.5f, DARC_RATIO, .8f },
+};
+
+static const uint32_t n_steps = sizeof (steps) / sizeof (Step);
+
+/* maximum error, a negative value means "not tested".
+ * The first entry that matches path and signal (NULL: any) applies. */
+typedef struct {
+	const char* path;
+	const char* signal;
+	double      max_abs; // linear, sample values
+	double      rms;     // linear
+	double      gain_db; // gain trajectory, or gain statistics
+} Limit;
+
+static const Limit limits[] = {
+	{ "run", NULL, 0, 0, -1 },
+	{ "run-stream", NULL, 0, 0, -1 },
+	{ "split", NULL, 2e-4, 2e-6, -1 },
+	{ "gain", NULL, 0, 0, -1 },
+	{ "gaintrack-d1", NULL, 0, 0, 0 },
+	/* except near onsets, see GT_SETTLE */
+	{ "gaintrack-d16", NULL, 2.5e-2, 5e-4, .4 },
+	{ "gaintrack-d64", NULL, 2e-2, 5e-4, .4 },
+	{ "checkpoint", NULL, 0, 0, -1 },
+	{ "seek", NULL, 0, 0, -1 },
+	{ "analyze", NULL, -1, -1, 1e-5 },
+	{ "bank", NULL, -1, -1, 1e-3 },
+	{ "tier-fast", NULL, 1e-6, 2e-8, -1 },
+	/* the gain is interpolated, except across transients */
+	{ "tier-ctrl", NULL, 1e-2, 2e-4, -1 },
+	{ "tier-switch", NULL, 1e-2, 2e-4, -1 },
+	{ "fast_logf", NULL, 2e-6, -1, -1 },
+	{ "fast_expf", NULL, 5e-6, -1, -1 },
+};
+
+static const uint32_t n_limits = sizeof (limits) / sizeof (Limit);
+
+typedef struct {
+	double max_abs;
+	double rms;
+	double gain_db;
+} Result;
+
+static float*   in_buf[2];
+static float*   ref_buf[2];
+static float*   out_buf[2];
+static float*   gain_ref; // per sample gain of the reference grid
+static float*   gain_out;
+static float*   v_buf; // detector input power
+static uint32_t rng;
+static int      n_fail;
+
+static float
+randf (void)
+{
+	rng = rng * 1664525 + 1013904223;
+	return (rng >> 8) / 8388608.f - 1.f;
+}
+
+static void
+generate (enum Signal sig, uint32_t n_ch)
+{
+	rng = 1;
+	for (uint32_t c = 0; c < n_ch; ++c) {
+		float* b = in_buf[c];
+		switch (sig) {
+			case SIG_SWEEP: {
+				const double k = log (1000.) / N_SAMPLES;
+				for (uint32_t i = 0; i < N_SAMPLES; ++i) {
+					const double ph  = 2. * M_PI * 20. * (exp (k * i) - 1.) / (k * RATE);
+					const float  lvl = -60.f + 60.f * i / N_SAMPLES;
+					b[i]             = powf (10.f, .05f * lvl) * sin (ph + c);
+				}
+			} break;
+			case SIG_BURSTS:
+				for (uint32_t i = 0; i < N_SAMPLES; ++i) {
+					const float a = (i % (RATE / 2)) < RATE / 10 ? .708f : .01f;
+					b[i]          = a * sinf (2.f * M_PI * 1000.f * (i % RATE) / RATE + c);
+				}
+				break;
+			case SIG_NOISE:
+				for (uint32_t i = 0; i < N_SAMPLES; ++i) {
+					b[i] = .316f * randf ();
+				}
+				break;
+			case SIG_SILENCE:
+				memset (b, 0, N_SAMPLES * sizeof (float));
+				break;
+			case SIG_STEPS:
+				for (uint32_t i = 0; i < N_SAMPLES; ++i) {
+					const float a = (i / (RATE / 8)) & 1 ? .5f : .032f;
+					b[i]          = a * randf ();
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/* control-port values at the given position */
+static void
+ctrl_at (enum Signal sig, uint64_t pos, float* ctrl)
+{
+	ctrl[DARC_ENABLE]    = 1;
+	ctrl[DARC_HOLD]      = 0;
+	ctrl[DARC_INPUTGAIN] = 0;
+	ctrl[DARC_THRESHOLD] = -30;
+	ctrl[DARC_RATIO]     = .6;
+	ctrl[DARC_ATTACK]    = .01;
+	ctrl[DARC_RELEASE]   = .3;
+
+	if (sig != SIG_STEPS) {
+		return;
+	}
+	for (uint32_t s = 0; s < n_steps; ++s) {
+		if (pos >= (uint64_t)(steps[s].t * RATE)) {
+			ctrl[steps[s].port] = steps[s].val;
+		}
+	}
+}
+
+/* samples since the last level change or parameter step */
+static uint64_t
+since_onset (enum Signal sig, uint64_t pos)
+{
+	uint64_t n = pos;
+	switch (sig) {
+		case SIG_BURSTS:
+			n = pos % (RATE / 2);
+			if (n >= RATE / 10) {
+				n -= RATE / 10;
+			}
+			break;
+		case SIG_STEPS:
+			n = pos % (RATE / 8);
+			for (uint32_t s = 0; s < n_steps; ++s) {
+				const uint64_t p = steps[s].t * RATE;
+				if (pos >= p && pos - p < n) {
+					n = pos - p;
+				}
+			}
+			break;
+		default:
+			break;
+	}
+	return n;
+}
+
+/* samples until the next parameter change, block boundary or
+ * checkpoint (interval > 0), whichever comes first */
+static uint32_t
+seg_len (enum Signal sig, uint64_t pos, uint32_t bs, uint32_t interval)
+{
+	uint64_t n = N_SAMPLES - pos;
+	if (n > bs - pos % bs) {
+		n = bs - pos % bs;
+	}
+	if (interval > 0 && n > interval - pos % interval) {
+		n = interval - pos % interval;
+	}
+	if (sig == SIG_STEPS) {
+		for (uint32_t s = 0; s < n_steps; ++s) {
+			const uint64_t p = steps[s].t * RATE;
+			if (p > pos && p - pos < n) {
+				n = p - pos;
+			}
+		}
+	}
+	return n;
+}
+
+/* same as run () */
+static void
+ctrl_apply (Dyncomp* d, const float* ctrl)
+{
+	if (ctrl[DARC_ENABLE] > 0) {
+		Dyncomp_set_inputgain (d, ctrl[DARC_INPUTGAIN]);
+		Dyncomp_set_threshold (d, ctrl[DARC_THRESHOLD]);
+		Dyncomp_set_ratio (d, ctrl[DARC_RATIO]);
+		Dyncomp_set_hold (d, ctrl[DARC_HOLD] > 0);
+	} else {
+		Dyncomp_set_inputgain (d, 0);
+		Dyncomp_set_threshold (d, -10.f);
+		Dyncomp_set_ratio (d, 0);
+		Dyncomp_set_hold (d, false);
+	}
+	Dyncomp_set_attack (d, ctrl[DARC_ATTACK]);
+	Dyncomp_set_release (d, ctrl[DARC_RELEASE]);
+}
+
+static void
+copy_input (float** dst, uint32_t n_ch)
+{
+	for (uint32_t c = 0; c < n_ch; ++c) {
+		memcpy (dst[c], in_buf[c], N_SAMPLES * sizeof (float));
+	}
+}
+
+/* ****************************************************************************
+ * error measurement
+ */
+
+/* true if an onset is less than `pre` samples ahead, or less than
+ * `post` samples ago */
+static bool
+near_onset (enum Signal sig, uint64_t pos, uint32_t pre, uint32_t post)
+{
+	return since_onset (sig, pos) < post || (pre > 0 && since_onset (sig, pos + pre) < pre);
+}
+
+/* compare (), skipping samples near an onset */
+static void
+compare_settled (float** a, float** b, uint32_t n_ch, enum Signal sig, uint32_t pre, uint32_t post, Result* r)
+{
+	double   sum = 0;
+	uint64_t n   = 0;
+	r->max_abs   = 0;
+	for (uint64_t i = 0; i < N_SAMPLES; ++i) {
+		if (near_onset (sig, i, pre, post)) {
+			continue;
+		}
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			const double d = fabs ((double)a[c][i] - (double)b[c][i]);
+			if (!(d <= r->max_abs)) {
+				r->max_abs = d; // also NaN
+			}
+			sum += d * d;
+		}
+		++n;
+	}
+	r->rms = sqrt (sum / (n_ch * n));
+}
+
+static void
+compare (float** a, float** b, uint32_t n_ch, uint64_t start, uint64_t end, Result* r)
+{
+	double sum = 0;
+	r->max_abs = 0;
+	for (uint32_t c = 0; c < n_ch; ++c) {
+		for (uint64_t i = start; i < end; ++i) {
+			const double d = fabs ((double)a[c][i] - (double)b[c][i]);
+			if (!(d <= r->max_abs)) {
+				r->max_abs = d; // also NaN
+			}
+			sum += d * d;
+		}
+	}
+	r->rms = sqrt (sum / (n_ch * (end - start)));
+}
+
+static double
+compare_gain (const float* a, const float* b, enum Signal sig, uint32_t pre, uint32_t post)
+{
+	double err = 0;
+	for (uint64_t i = 0; i < N_SAMPLES; ++i) {
+		if (near_onset (sig, i, pre, post)) {
+			continue;
+		}
+		if (a[i] < 1e-20f && b[i] < 1e-20f) {
+			continue;
+		}
+		const double d = fabs (20. * log10 ((double)a[i] / (double)b[i]));
+		if (!(d <= err)) {
+			err = d;
+		}
+	}
+	return err;
+}
+
+static void
+report (const char* path, const char* sig, uint32_t n_ch, const Result* r)
+{
+	const Limit* l = NULL;
+	for (uint32_t i = 0; i < n_limits && !l; ++i) {
+		if (!strcmp (limits[i].path, path) && (!limits[i].signal || !strcmp (limits[i].signal, sig))) {
+			l = &limits[i];
+		}
+	}
+	bool ok = l != NULL;
+	if (l && l->max_abs >= 0 && !(r->max_abs <= l->max_abs)) {
+		ok = false;
+	}
+	if (l && l->rms >= 0 && !(r->rms <= l->rms)) {
+		ok = false;
+	}
+	if (l && l->gain_db >= 0 && !(r->gain_db <= l->gain_db)) {
+		ok = false;
+	}
+	if (!ok) {
+		++n_fail;
+	}
+
+	printf ("%s,%s,%u", path, sig, n_ch);
+	if (r->max_abs >= 0 || isnan (r->max_abs)) {
+		printf (",%.3e", r->max_abs);
+	} else {
+		printf (",-");
+	}
+	if (r->rms >= 0 || isnan (r->rms)) {
+		printf (",%.3e", r->rms);
+	} else {
+		printf (",-");
+	}
+	if (r->gain_db >= 0 || isnan (r->gain_db)) {
+		printf (",%.3e", r->gain_db);
+	} else {
+		printf (",-");
+	}
+	printf (",%s\n", ok ? "PASS" : "FAIL");
+	fflush (stdout);
+}
+
+/* ****************************************************************************
+ * renderers
+ */
+
+static void
+render_ref (enum Signal sig, uint32_t n_ch)
+{
+	Dyncomp d;
+	float   ctrl[DARC_INPUT0];
+
+	copy_input (ref_buf, n_ch);
+	Dyncomp_init (&d, RATE, n_ch);
+
+	for (uint64_t pos = 0; pos < N_SAMPLES;) {
+		const uint32_t n = seg_len (sig, pos, REF_BLOCK, 0);
+		float*         io[2];
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			io[c] = &ref_buf[c][pos];
+		}
+		ctrl_at (sig, pos, ctrl);
+		ctrl_apply (&d, ctrl);
+		Dyncomp_process (&d, n, io);
+		pos += n;
+	}
+}
+
+/* Dyncomp_process () with random block-sizes */
+static void
+test_split (enum Signal sig, uint32_t n_ch)
+{
+	Dyncomp d;
+	Result  r = { 0, 0, -1 };
+	float   ctrl[DARC_INPUT0];
+
+	copy_input (out_buf, n_ch);
+	Dyncomp_init (&d, RATE, n_ch);
+
+	uint32_t seed = 4711;
+	for (uint64_t pos = 0; pos < N_SAMPLES;) {
+		seed       = seed * 1664525 + 1013904223;
+		uint32_t n = seg_len (sig, pos, N_SAMPLES, 0);
+		if (n > 1 + (seed >> 22)) {
+			n = 1 + (seed >> 22); // 1..1024
+		}
+		float* io[2];
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			io[c] = &out_buf[c][pos];
+		}
+		ctrl_at (sig, pos, ctrl);
+		ctrl_apply (&d, ctrl);
+		Dyncomp_process (&d, n, io);
+		pos += n;
+	}
+
+	compare (out_buf, ref_buf, n_ch, 0, N_SAMPLES, &r);
+	report ("split", sig_names[sig], n_ch, &r);
+}
+
+/* Dyncomp_process () with a cheaper kernel, on the reference grid.
+ * DARC_TIER_LAST cycles through all kernels, changing every block.
+ */
+static void
+test_tier (enum Signal sig, uint32_t n_ch, uint32_t tier)
+{
+	static const char* names[DARC_TIER_LAST + 1] = {
+		"tier-full", "tier-fast", "tier-ctrl", "tier-switch"
+	};
+
+	Dyncomp d;
+	Result  r = { 0, 0, -1 };
+	float   ctrl[DARC_INPUT0];
+
+	copy_input (out_buf, n_ch);
+	Dyncomp_init (&d, RATE, n_ch);
+
+	uint32_t blk = 0;
+	for (uint64_t pos = 0; pos < N_SAMPLES; ++blk) {
+		const uint32_t n = seg_len (sig, pos, REF_BLOCK, 0);
+		float*         io[2];
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			io[c] = &out_buf[c][pos];
+		}
+		ctrl_at (sig, pos, ctrl);
+		ctrl_apply (&d, ctrl);
+		d.tier = tier < DARC_TIER_LAST ? tier : blk % DARC_TIER_LAST;
+		Dyncomp_process (&d, n, io);
+		pos += n;
+	}
+
+	compare (out_buf, ref_buf, n_ch, 0, N_SAMPLES, &r);
+	report (names[tier], sig_names[sig], n_ch, &r);
+}
+
+/* Dyncomp_process_gain (), on the reference grid */
+static void
+render_gain (enum Signal sig, uint32_t n_ch)
+{
+	Dyncomp d;
+	float   ctrl[DARC_INPUT0];
+
+	Dyncomp_init (&d, RATE, n_ch);
+
+	for (uint64_t pos = 0; pos < N_SAMPLES;) {
+		const uint32_t n = seg_len (sig, pos, REF_BLOCK, 0);
+		float*         in[2];
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			in[c] = &in_buf[c][pos];
+		}
+		ctrl_at (sig, pos, ctrl);
+		ctrl_apply (&d, ctrl);
+		Dyncomp_process_gain (&d, n, in, &gain_ref[pos]);
+		pos += n;
+	}
+}
+
+/* gain applied by the test, requires render_gain () */
+static void
+test_gain (enum Signal sig, uint32_t n_ch)
+{
+	Result r = { 0, 0, -1 };
+
+	for (uint32_t c = 0; c < n_ch; ++c) {
+		for (uint64_t i = 0; i < N_SAMPLES; ++i) {
+			out_buf[c][i] = in_buf[c][i] * gain_ref[i];
+		}
+	}
+
+	compare (out_buf, ref_buf, n_ch, 0, N_SAMPLES, &r);
+	report ("gain", sig_names[sig], n_ch, &r);
+}
+
+/* gain-export to a file and gain-apply, requires render_gain () */
+static void
+test_gaintrack (enum Signal sig, uint32_t n_ch, uint32_t decimation)
+{
+	GainTrackWriter gw;
+	GainTrack       gt;
+	Result          r = { 0, 0, 0 };
+	char            path[] = "/tmp/x42-darc-test-XXXXXX";
+	char            name[32];
+
+	snprintf (name, sizeof (name), "gaintrack-d%u", decimation);
+
+	int fd = mkstemp (path);
+	if (fd < 0) {
+		r.max_abs = r.rms = r.gain_db = NAN;
+		report (name, sig_names[sig], n_ch, &r);
+		return;
+	}
+	close (fd);
+
+	/* write in blocks, to test the decimation phase */
+	bool ok = 0 == gaintrack_create (&gw, path, RATE, decimation);
+	for (uint64_t pos = 0; ok && pos < N_SAMPLES; pos += 1000) {
+		ok = 0 == gaintrack_write (&gw, &gain_ref[pos], 1000);
+	}
+	ok = ok && 0 == gaintrack_close (&gw);
+	ok = ok && 0 == gaintrack_open (&gt, path);
+	unlink (path);
+
+	if (!ok) {
+		r.max_abs = r.rms = r.gain_db = NAN;
+		report (name, sig_names[sig], n_ch, &r);
+		return;
+	}
+
+	/* the tool applies the gain to interleaved audio */
+	float* buf = (float*)malloc (BLOCKSIZE * n_ch * sizeof (float));
+	for (uint64_t pos = 0; pos < N_SAMPLES; pos += BLOCKSIZE) {
+		const uint32_t n = N_SAMPLES - pos < BLOCKSIZE ? N_SAMPLES - pos : BLOCKSIZE;
+		for (uint32_t i = 0; i < n; ++i) {
+			for (uint32_t c = 0; c < n_ch; ++c) {
+				buf[i * n_ch + c] = in_buf[c][pos + i];
+			}
+		}
+		gaintrack_get (&gt, pos, n, &gain_out[pos]);
+		gaintrack_apply (buf, &gain_out[pos], n_ch, n);
+		for (uint32_t i = 0; i < n; ++i) {
+			for (uint32_t c = 0; c < n_ch; ++c) {
+				out_buf[c][pos + i] = buf[i * n_ch + c];
+			}
+		}
+	}
+	free (buf);
+	gaintrack_close_map (&gt);
+
+	/* the interpolation starts to follow an onset one decimation period
+	 * early, and the attack takes a few periods */
+	const uint32_t pre    = decimation > 1 ? decimation : 0;
+	const uint32_t settle = pre * GT_SETTLE;
+	compare_settled (out_buf, ref_buf, n_ch, sig, pre, settle, &r);
+	r.gain_db = compare_gain (gain_out, gain_ref, sig, pre, settle);
+	report (name, sig_names[sig], n_ch, &r);
+}
+
+/* continuous render recording checkpoints, then re-render regions
+ * after restoring a checkpoint */
+static void
+test_checkpoint (enum Signal sig, uint32_t n_ch)
+{
+	static const float regions[] = { 1.3f, 3.7f, 6.1f }; // start, sec
+	Checkpoints        cp;
+	Dyncomp            d;
+	Result             r = { 0, 0, -1 };
+	float              ctrl[DARC_INPUT0];
+
+	copy_input (out_buf, n_ch);
+	Dyncomp_init (&d, RATE, n_ch);
+	checkpoints_init (&cp, &d, &darc_default_params, CKPT_INTERVAL);
+
+	bool ok = true;
+	for (uint64_t pos = 0; ok && pos < N_SAMPLES;) {
+		const uint32_t n = seg_len (sig, pos, REF_BLOCK, 0);
+		float*         io[2];
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			io[c] = &out_buf[c][pos];
+		}
+		ctrl_at (sig, pos, ctrl);
+		ctrl_apply (&d, ctrl);
+		ok = checkpoints_process (&cp, &d, pos, n, io);
+		pos += n;
+	}
+
+	if (!ok) {
+		r.max_abs = r.rms = NAN;
+	} else {
+		compare (out_buf, ref_buf, n_ch, 0, N_SAMPLES, &r);
+	}
+	report ("checkpoint", sig_names[sig], n_ch, &r);
+
+	/* the continuous render is the reference for the regions */
+	Result rs = { 0, 0, -1 };
+	for (uint32_t k = 0; ok && k < sizeof (regions) / sizeof (float); ++k) {
+		const uint64_t start = regions[k] * RATE;
+		const uint64_t end   = start + RATE;
+		float*         buf[2];
+		Result         rr;
+
+		Dyncomp_init (&d, RATE, n_ch);
+		const int64_t cpos = checkpoints_seek (&cp, &d, start);
+		if (cpos < 0) {
+			ok = false;
+			break;
+		}
+
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			buf[c] = (float*)malloc (N_SAMPLES * sizeof (float));
+			memcpy (buf[c], in_buf[c], N_SAMPLES * sizeof (float));
+		}
+
+		for (uint64_t pos = cpos; pos < end;) {
+			const uint32_t n = seg_len (sig, pos, REF_BLOCK, CKPT_INTERVAL);
+			float*         io[2];
+			for (uint32_t c = 0; c < n_ch; ++c) {
+				io[c] = &buf[c][pos];
+			}
+			ctrl_at (sig, pos, ctrl);
+			ctrl_apply (&d, ctrl);
+			Dyncomp_process (&d, n, io);
+			pos += n;
+		}
+
+		compare (buf, out_buf, n_ch, start, end, &rr);
+		rs.max_abs = fmax (rs.max_abs, rr.max_abs);
+		rs.rms     = fmax (rs.rms, rr.rms);
+
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			free (buf[c]);
+		}
+	}
+
+	if (!ok) {
+		rs.max_abs = rs.rms = NAN;
+	}
+	report ("seek", sig_names[sig], n_ch, &rs);
+	checkpoints_free (&cp);
+}
+
+/* Detector-only statistics, compared to the reference gain of every
+ * DARC_ANALYSIS_STRIDE'th sample. Requires render_gain () and 0dB input gain. */
+static void
+test_analyze (enum Signal sig, uint32_t n_ch)
+{
+	Dyncomp      d;
+	DyncompStats st;
+	Result       r = { -1, -1, 0 };
+	float        ctrl[DARC_INPUT0];
+
+	Dyncomp_init (&d, RATE, n_ch);
+	DyncompStats_reset (&st);
+
+	for (uint64_t pos = 0; pos < N_SAMPLES;) {
+		const uint32_t n = seg_len (sig, pos, REF_BLOCK, 0);
+		float*         in[2];
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			in[c] = &in_buf[c][pos];
+		}
+		ctrl_at (sig, pos, ctrl);
+		ctrl_apply (&d, ctrl);
+		Dyncomp_analyze (&d, n, in, &st);
+		pos += n;
+	}
+
+	double gsum = 0;
+	float  gmin = 100.f;
+	float  gmax = -100.f;
+	for (uint64_t i = 0; i < N_SAMPLES; i += DARC_ANALYSIS_STRIDE) {
+		const float g = 8.68589f * logf (gain_ref[i]);
+		gsum += g * DARC_ANALYSIS_STRIDE;
+		gmin = fminf (gmin, g);
+		gmax = fmaxf (gmax, g);
+	}
+
+	r.gain_db = fabs (gsum / N_SAMPLES - st.gain_sum / st.n_samples);
+	r.gain_db = fmax (r.gain_db, fabs (gmin - st.gain_min));
+	r.gain_db = fmax (r.gain_db, fabs (gmax - st.gain_max));
+	report ("analyze", sig_names[sig], n_ch, &r);
+}
+
+/* Approximated, vectorized detector of the sweep mode. Lanes start
+ * settled, so the reference is rendered likewise. */
+static void
+test_bank (enum Signal sig, uint32_t n_ch)
+{
+	Dyncomp     d;
+	DyncompBank bank;
+	Result      r = { -1, -1, 0 };
+	float       ctrl[DARC_INPUT0];
+
+	Dyncomp_init (&d, RATE, n_ch);
+	ctrl_at (sig, 0, ctrl);
+	ctrl_apply (&d, ctrl);
+
+	DyncompState s;
+	Dyncomp_get_state (&d, &s);
+	s.igain = d.p_ign;
+	s.ratio = d.p_rat;
+	Dyncomp_set_state (&d, &s);
+
+	DyncompBank_init (&bank, RATE);
+	DyncompBank_set_lane (&bank, 0, &d);
+
+	for (uint64_t i = 0; i < N_SAMPLES; ++i) {
+		float p = 0;
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			p += in_buf[c][i] * in_buf[c][i];
+		}
+		v_buf[i] = p * d.norm_input;
+	}
+
+	for (uint64_t pos = 0; pos < N_SAMPLES; pos += BLOCKSIZE) {
+		const uint32_t n = N_SAMPLES - pos < BLOCKSIZE ? N_SAMPLES - pos : BLOCKSIZE;
+		DyncompBank_process (&bank, n, &v_buf[pos], &v_buf[pos]);
+	}
+
+	for (uint64_t pos = 0; pos < N_SAMPLES;) {
+		const uint32_t n = seg_len (sig, pos, REF_BLOCK, 0);
+		float*         in[2];
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			in[c] = &in_buf[c][pos];
+		}
+		Dyncomp_process_gain (&d, n, in, &gain_out[pos]);
+		pos += n;
+	}
+
+	double gsum = 0;
+	float  gmin = 100.f;
+	for (uint64_t i = 0; i < N_SAMPLES; ++i) {
+		const float g = 8.68589f * logf (gain_out[i] / d.p_ign);
+		gsum += g;
+		gmin = fminf (gmin, g);
+	}
+
+	r.gain_db = fabs (gsum / N_SAMPLES - DyncompBank_gain_avg (&bank, 0));
+	r.gain_db = fmax (r.gain_db, fabs (gmin - DyncompBank_gain_min (&bank, 0)));
+	report ("bank", sig_names[sig], n_ch, &r);
+
+	DyncompBank_free (&bank);
+}
+
+/* ****************************************************************************
+ * the plugin
+ */
+
+static const char* uri_table[16];
+static uint32_t    n_uris;
+
+static LV2_URID
+urid_map (LV2_URID_Map_Handle handle, const char* uri)
+{
+	for (uint32_t i = 0; i < n_uris; ++i) {
+		if (!strcmp (uri_table[i], uri)) {
+			return i + 1;
+		}
+	}
+	if (n_uris == sizeof (uri_table) / sizeof (char*)) {
+		return 0;
+	}
+	uri_table[n_uris] = uri;
+	return ++n_uris;
+}
+
+/* run () with control-ports, optionally with the meter stream to the UI
+ * enabled, which must not change the output */
+static void
+test_run (enum Signal sig, uint32_t n_ch, bool stream)
+{
+	LV2_URID_Map map  = { NULL, urid_map };
+	LV2_Feature  fmap = { LV2_URID__map, &map };
+
+	const LV2_Feature* features[] = { &fmap, NULL };
+	const LV2_Feature* no_features[] = { NULL };
+
+	const LV2_Descriptor* desc   = lv2_descriptor (n_ch == 1 ? 0 : 1);
+	LV2_Handle            handle = desc->instantiate (desc, RATE, NULL, stream ? features : no_features);
+
+	Result r = { 0, 0, -1 };
+	float  ctrl[DARC_INPUT0];
+
+	/* 64bit aligned atom buffers */
+	uint64_t ctl_buf[64];
+	uint64_t ntf_buf[1024];
+
+	LV2_Atom_Sequence* ctl = (LV2_Atom_Sequence*)ctl_buf;
+	LV2_Atom_Sequence* ntf = (LV2_Atom_Sequence*)ntf_buf;
+
+	if (stream) {
+		LV2_Atom_Forge       forge;
+		LV2_Atom_Forge_Frame frame, obj;
+		lv2_atom_forge_init (&forge, &map);
+		lv2_atom_forge_set_buffer (&forge, (uint8_t*)ctl_buf, sizeof (ctl_buf));
+		lv2_atom_forge_sequence_head (&forge, &frame, 0);
+		lv2_atom_forge_frame_time (&forge, 0);
+		lv2_atom_forge_object (&forge, &obj, 0, urid_map (NULL, DARC__ui_on));
+		lv2_atom_forge_pop (&forge, &obj);
+		lv2_atom_forge_pop (&forge, &frame);
+
+		const uint32_t cport = n_ch == 1 ? DARC_INPUT1 : DARC_CONTROL;
+		desc->connect_port (handle, cport, ctl);
+		desc->connect_port (handle, cport + 1, ntf);
+	}
+
+	for (uint32_t p = 0; p < DARC_INPUT0; ++p) {
+		desc->connect_port (handle, p, &ctrl[p]);
+	}
+
+	/* the governor is off by default, run () uses the full kernel only */
+	desc->activate (handle);
+
+	for (uint64_t pos = 0; pos < N_SAMPLES;) {
+		const uint32_t n = seg_len (sig, pos, REF_BLOCK, 0);
+		for (uint32_t c = 0; c < n_ch; ++c) {
+			desc->connect_port (handle, DARC_INPUT0 + 2 * c, &in_buf[c][pos]);
+			desc->connect_port (handle, DARC_OUTPUT0 + 2 * c, &out_buf[c][pos]);
+		}
+		ctrl_at (sig, pos, ctrl);
+		ntf->atom.size = sizeof (ntf_buf) - sizeof (LV2_Atom);
+		desc->run (handle, n);
+		/* subscribe once */
+		ctl->atom.size = sizeof (LV2_Atom_Sequence_Body);
+		pos += n;
+	}
+
+	desc->cleanup (handle);
+
+	compare (out_buf, ref_buf, n_ch, 0, N_SAMPLES, &r);
+	report (stream ? "run-stream" : "run", sig_names[sig], n_ch, &r);
+}
+
+/* ****************************************************************************
+ * approximations
+ */
+
+static void
+test_fastmath (void)
+{
+	Result rl = { 0, -1, -1 };
+	Result re = { 0, -1, -1 };
+
+	/* beyond that the rounding of the result dominates */
+	for (float x = 1e-10f; x < 1e10f; x *= 1.0001f) {
+		const double e = fabs (fast_logf (x) - log ((double)x));
+		if (!(e <= rl.max_abs)) {
+			rl.max_abs = e;
+		}
+	}
+	report ("fast_logf", "-", 0, &rl);
+
+	for (float x = -87.f; x < 87.f; x += 1e-3f) {
+		const double e = fabs (fast_expf (x) / exp ((double)x) - 1.);
+		if (!(e <= re.max_abs)) {
+			re.max_abs = e;
+		}
+	}
+	report ("fast_expf", "-", 0, &re);
+}
+
+/* ****************************************************************************/
+
+static void
+usage (void)
+{
+	printf ("x42-darc-test - x42 Dynamic Compressor regression tests.\n\n"
+	        "Usage: x42-darc-test [OPTIONS]\n\n"
+	        "Render deterministic test signals (sweep, bursts, noise, silence and\n"
+	        "steps of all control parameters) with the reference Dyncomp_process (),\n"
+	        "and compare it to the output of all other processing paths:\n"
+	        "the plugin's run () with and without meter stream, random block-sizes,\n"
+	        "gain-export/apply, checkpoints, as well as the analysis and sweep\n"
+	        "detectors and the log/exp approximations.\n\n"
+	        "Results are printed as CSV, one line per test:\n"
+	        "path,signal,channels,max_abs,rms,gain_db,result\n"
+	        "max_abs and rms are the difference of the sample values, gain_db is\n"
+	        "the difference of the gain trajectory or the gain statistics.\n"
+	        "The exit code is non-zero if any result exceeds its limit.\n\n"
+	        "Options:\n"
+	        "  -p, --path <name>       only run the given (group of) tests\n"
+	        "  -s, --signal <name>     only test the given signal\n"
+	        "  -h, --help              display this help and exit\n"
+	        "  -V, --version           print version information and exit\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+/* test if a group of tests is selected, "gaintrack" selects all
+ * decimations, "gaintrack-d16" selects the group */
+static bool
+want (const char* only, const char* group)
+{
+	if (!only) {
+		return true;
+	}
+	const size_t lo = strlen (only);
+	const size_t lg = strlen (group);
+	return !strncmp (only, group, lo < lg ? lo : lg);
+}
+
+int
+main (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "path", required_argument, 0, 'p' },
+		{ "signal", required_argument, 0, 's' },
+		{ "help", no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	const char* only_path = NULL;
+	int         only_sig  = -1;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "p:s:hV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'p':
+				only_path = optarg;
+				break;
+			case 's':
+				for (int i = 0; i < SIG_LAST; ++i) {
+					if (!strcmp (optarg, sig_names[i])) {
+						only_sig = i;
+					}
+				}
+				if (only_sig < 0) {
+					fprintf (stderr, "Unknown signal: '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'h':
+				usage ();
+				return 0;
+			case 'V':
+				printf ("x42-darc-test version %s\n", VERSION);
+				return 0;
+			default:
+				usage ();
+				return 1;
+		}
+	}
+
+	for (uint32_t c = 0; c < 2; ++c) {
+		in_buf[c]  = (float*)malloc (N_SAMPLES * sizeof (float));
+		ref_buf[c] = (float*)malloc (N_SAMPLES * sizeof (float));
+		out_buf[c] = (float*)malloc (N_SAMPLES * sizeof (float));
+	}
+	gain_ref = (float*)malloc (N_SAMPLES * sizeof (float));
+	gain_out = (float*)malloc (N_SAMPLES * sizeof (float));
+	v_buf    = (float*)malloc (N_SAMPLES * sizeof (float));
+
+	printf ("path,signal,channels,max_abs,rms,gain_db,result\n");
+
+	for (int s = 0; s < SIG_LAST; ++s) {
+		if (only_sig >= 0 && s != only_sig) {
+			continue;
+		}
+		const enum Signal sig = (enum Signal)s;
+		for (uint32_t n_ch = 1; n_ch <= 2; ++n_ch) {
+			generate (sig, n_ch);
+			render_ref (sig, n_ch);
+			render_gain (sig, n_ch);
+
+			if (want (only_path, "gain")) {
+				test_gain (sig, n_ch);
+			}
+			if (want (only_path, "run")) {
+				test_run (sig, n_ch, false);
+				test_run (sig, n_ch, true);
+			}
+			if (want (only_path, "split")) {
+				test_split (sig, n_ch);
+			}
+			if (want (only_path, "tier")) {
+				test_tier (sig, n_ch, DARC_TIER_FAST);
+				test_tier (sig, n_ch, DARC_TIER_CTRL);
+				test_tier (sig, n_ch, DARC_TIER_LAST);
+			}
+			if (want (only_path, "gaintrack")) {
+				test_gaintrack (sig, n_ch, 1);
+				test_gaintrack (sig, n_ch, 16);
+				test_gaintrack (sig, n_ch, 64);
+			}
+			if (want (only_path, "checkpoint") || want (only_path, "seek")) {
+				test_checkpoint (sig, n_ch);
+			}
+			if (sig != SIG_STEPS && want (only_path, "analyze")) {
+				test_analyze (sig, n_ch);
+			}
+			if (sig != SIG_STEPS && want (only_path, "bank")) {
+				test_bank (sig, n_ch);
+			}
+		}
+	}
+
+	if (want (only_path, "fast_logf") || want (only_path, "fast_expf")) {
+		test_fastmath ();
+	}
+
+	for (uint32_t c = 0; c < 2; ++c) {
+		free (in_buf[c]);
+		free (ref_buf[c]);
+		free (out_buf[c]);
+	}
+	free (gain_ref);
+	free (gain_out);
+	free (v_buf);
+
+	fprintf (stderr, "%d test(s) failed\n", n_fail);
+	return n_fail > 0 ? 1 : 0;
+}
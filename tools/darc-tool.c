@@ -0,0 +1,1495 @@
+/* x42-darc-tool -- offline processing and analysis
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capfile.h"
+#include "checkpoint.h"
+#include "common.h"
+#include "dynbank.h"
+#include "gaintrack.h"
+#include "wavio.h"
+
+#ifndef VERSION
+#define VERSION "0"
+#endif
+
+/* ****************************************************************************
+ * common helpers
+ */
+
+typedef struct {
+	WavFile  in;
+	Dyncomp  dyncomp;
+	float*   ibuf;              // interleaved
+	float*   pbuf[MAX_CHANNELS]; // planar
+	uint32_t n_channels;
+} Session;
+
+static int
+session_open (Session* s, const char* path, const DarcParams* p)
+{
+	memset (s, 0, sizeof (Session));
+	FILE* f = strcmp (path, "-") ? fopen (path, "rb") : stdin;
+	if (!f) {
+		fprintf (stderr, "Cannot open '%s'\n", path);
+		return -1;
+	}
+	if (wav_open_read (&s->in, f)) {
+		fprintf (stderr, "Unsupported or invalid file format: '%s'\n", path);
+		if (f != stdin) {
+			fclose (f);
+		}
+		return -1;
+	}
+	if (s->in.n_channels > MAX_CHANNELS) {
+		fprintf (stderr, "Too many channels (max %d)\n", MAX_CHANNELS);
+		wav_close (&s->in);
+		return -1;
+	}
+	s->n_channels = s->in.n_channels;
+	s->ibuf       = (float*)malloc (BLOCKSIZE * s->n_channels * sizeof (float));
+	for (uint32_t c = 0; c < s->n_channels; ++c) {
+		s->pbuf[c] = (float*)malloc (BLOCKSIZE * sizeof (float));
+	}
+
+	Dyncomp_init (&s->dyncomp, s->in.rate, s->n_channels);
+	darc_params_apply (&s->dyncomp, p);
+	return 0;
+}
+
+static void
+session_close (Session* s)
+{
+	wav_close (&s->in);
+	free (s->ibuf);
+	for (uint32_t c = 0; c < s->n_channels; ++c) {
+		free (s->pbuf[c]);
+	}
+}
+
+/* read and deinterleave the next block, returns number of samples */
+static uint32_t
+session_read (Session* s, uint32_t n_samples)
+{
+	if (n_samples > BLOCKSIZE) {
+		n_samples = BLOCKSIZE;
+	}
+	uint32_t n = wav_read (&s->in, s->ibuf, n_samples);
+	deinterleave (s->pbuf, s->ibuf, s->n_channels, n);
+	return n;
+}
+
+static int
+open_output (WavFile* out, const char* path, const Session* s)
+{
+	FILE* f = strcmp (path, "-") ? fopen (path, "wb") : stdout;
+	if (!f) {
+		fprintf (stderr, "Cannot open '%s' for writing\n", path);
+		return -1;
+	}
+	return wav_open_write (out, f, s->in.rate, s->n_channels, s->in.fmt);
+}
+
+static bool
+parse_param_args (DarcParams* p, int argc, char** argv)
+{
+	for (int i = 0; i < argc; ++i) {
+		if (!darc_params_parse (p, argv[i])) {
+			fprintf (stderr, "Invalid parameter: '%s'\n", argv[i]);
+			return false;
+		}
+	}
+	if (!darc_params_clamp (p)) {
+		fprintf (stderr, "Note: parameter(s) were clamped to valid range.\n");
+	}
+	return true;
+}
+
+/* ****************************************************************************
+ * render
+ */
+
+static void
+usage_render (void)
+{
+	printf ("x42-darc-tool render [OPTIONS] <input> <output> [symbol=value ...]\n\n"
+	        "Process an audio file. Parameters are given as LV2 port symbol=value\n"
+	        "pairs: inputgain, threshold, Ratio, attack, release, hold.\n\n"
+	        "Options:\n"
+	        "  -C, --write-checkpoints <file>  record envelope checkpoints\n"
+	        "  -c, --checkpoints <file>        use checkpoints to seek to --start\n"
+	        "  -I, --interval <sec>            checkpoint interval (default 1.0)\n"
+	        "  -s, --start <sec>               start of region to render\n"
+	        "  -e, --end <sec>                 end of region to render\n"
+	        "  -h, --help                      display this help and exit\n");
+}
+
+static int
+mode_render (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "write-checkpoints", required_argument, 0, 'C' },
+		{ "checkpoints", required_argument, 0, 'c' },
+		{ "interval", required_argument, 0, 'I' },
+		{ "start", required_argument, 0, 's' },
+		{ "end", required_argument, 0, 'e' },
+		{ "help", no_argument, 0, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	const char* ckpt_out = NULL;
+	const char* ckpt_in  = NULL;
+	double      interval = 1.0;
+	double      t_start  = 0;
+	double      t_end    = -1;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "C:c:I:s:e:h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'C':
+				ckpt_out = optarg;
+				break;
+			case 'c':
+				ckpt_in = optarg;
+				break;
+			case 'I':
+				interval = atof (optarg);
+				break;
+			case 's':
+				t_start = atof (optarg);
+				break;
+			case 'e':
+				t_end = atof (optarg);
+				break;
+			case 'h':
+				usage_render ();
+				return 0;
+			default:
+				usage_render ();
+				return 1;
+		}
+	}
+
+	if (argc - optind < 2 || interval <= 0 || t_start < 0) {
+		usage_render ();
+		return 1;
+	}
+
+	DarcParams p = darc_default_params;
+	if (!parse_param_args (&p, argc - optind - 2, &argv[optind + 2])) {
+		return 1;
+	}
+
+	if (ckpt_out && (t_start > 0 || ckpt_in)) {
+		fprintf (stderr, "Checkpoints can only be recorded when rendering from the start.\n");
+		return 1;
+	}
+
+	Session s;
+	if (session_open (&s, argv[optind], &p)) {
+		return 1;
+	}
+
+	const uint64_t start = rint (t_start * s.in.rate);
+	const uint64_t end   = t_end < 0 ? UINT64_MAX : rint (t_end * s.in.rate);
+	uint64_t       pos   = 0;
+
+	Checkpoints cp;
+	memset (&cp, 0, sizeof (Checkpoints));
+
+	if (ckpt_out) {
+		checkpoints_init (&cp, &s.dyncomp, &p, rint (interval * s.in.rate));
+	}
+
+	/* seek using checkpoints, process remaining pre-roll */
+	if (ckpt_in && start > 0) {
+		if (checkpoints_load (&cp, ckpt_in) || !checkpoints_match (&cp, &s.dyncomp, &p)) {
+			fprintf (stderr, "Checkpoint file is invalid or does not match the parameters.\n");
+			session_close (&s);
+			return 1;
+		}
+		int64_t cpos = checkpoints_seek (&cp, &s.dyncomp, start);
+		if (cpos < 0 || wav_seek (&s.in, cpos)) {
+			fprintf (stderr, "Cannot seek to checkpoint.\n");
+			checkpoints_free (&cp);
+			session_close (&s);
+			return 1;
+		}
+		pos = cpos;
+	}
+
+	while (pos < start) {
+		uint64_t n = start - pos;
+		n          = session_read (&s, n > BLOCKSIZE ? BLOCKSIZE : n);
+		if (n == 0) {
+			break;
+		}
+		Dyncomp_process (&s.dyncomp, n, s.pbuf);
+		pos += n;
+	}
+
+	WavFile out;
+	if (open_output (&out, argv[optind + 1], &s)) {
+		checkpoints_free (&cp);
+		session_close (&s);
+		return 1;
+	}
+
+	int rv = 0;
+	while (pos < end) {
+		uint64_t n = end - pos;
+		n          = session_read (&s, n > BLOCKSIZE ? BLOCKSIZE : n);
+		if (n == 0) {
+			break;
+		}
+		if (!ckpt_out) {
+			Dyncomp_process (&s.dyncomp, n, s.pbuf);
+		} else if (!checkpoints_process (&cp, &s.dyncomp, pos, n, s.pbuf)) {
+			fprintf (stderr, "Failed to record checkpoints, render aborted\n");
+			rv = 1;
+			break;
+		}
+		interleave (s.ibuf, s.pbuf, s.n_channels, n);
+		if (wav_write (&out, s.ibuf, n) != n) {
+			fprintf (stderr, "Short write, render aborted\n");
+			rv = 1;
+			break;
+		}
+		pos += n;
+	}
+
+	if (wav_close (&out) && rv == 0) {
+		fprintf (stderr, "Failed to write '%s'\n", argv[optind + 1]);
+		rv = 1;
+	}
+	session_close (&s);
+
+	if (rv == 0 && ckpt_out && checkpoints_save (&cp, ckpt_out)) {
+		fprintf (stderr, "Failed to write checkpoints to '%s'\n", ckpt_out);
+		rv = 1;
+	}
+	checkpoints_free (&cp);
+	return rv;
+}
+
+/* ****************************************************************************
+ * gain track export/apply
+ */
+
+static void
+usage_gain_export (void)
+{
+	printf ("x42-darc-tool gain-export [OPTIONS] <input> <track> [symbol=value ...]\n\n"
+	        "Analyze an audio file and write the gain computed by the compressor\n"
+	        "to a gain-track file. No audio is written.\n\n"
+	        "Options:\n"
+	        "  -d, --decimation <N>   store one gain value every N samples (default 1)\n"
+	        "  -h, --help             display this help and exit\n");
+}
+
+static int
+mode_gain_export (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "decimation", required_argument, 0, 'd' },
+		{ "help", no_argument, 0, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int decimation = 1;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "d:h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'd':
+				decimation = atoi (optarg);
+				break;
+			case 'h':
+				usage_gain_export ();
+				return 0;
+			default:
+				usage_gain_export ();
+				return 1;
+		}
+	}
+
+	if (argc - optind < 2 || decimation < 1) {
+		usage_gain_export ();
+		return 1;
+	}
+
+	DarcParams p = darc_default_params;
+	if (!parse_param_args (&p, argc - optind - 2, &argv[optind + 2])) {
+		return 1;
+	}
+
+	Session s;
+	if (session_open (&s, argv[optind], &p)) {
+		return 1;
+	}
+
+	GainTrackWriter gt;
+	if (gaintrack_create (&gt, argv[optind + 1], s.in.rate, decimation)) {
+		fprintf (stderr, "Cannot create gain-track '%s'\n", argv[optind + 1]);
+		session_close (&s);
+		return 1;
+	}
+
+	float gain[BLOCKSIZE];
+	int   rv = 0;
+
+	uint32_t n;
+	while ((n = session_read (&s, BLOCKSIZE)) > 0) {
+		Dyncomp_process_gain (&s.dyncomp, n, s.pbuf, gain);
+		if (gaintrack_write (&gt, gain, n)) {
+			rv = 1;
+			break;
+		}
+	}
+
+	if (gaintrack_close (&gt) || rv) {
+		fprintf (stderr, "Error writing gain-track '%s'\n", argv[optind + 1]);
+		rv = 1;
+	}
+	session_close (&s);
+	return rv;
+}
+
+static void
+usage_gain_apply (void)
+{
+	printf ("x42-darc-tool gain-apply <track> <input> <output> [<input> <output> ...]\n\n"
+	        "Multiply one or more audio files (e.g. stems of the mix that the\n"
+	        "track was exported from) with a gain-track.\n");
+}
+
+static int
+mode_gain_apply (int argc, char** argv)
+{
+	if (argc < 4 || (argc - 2) % 2 || !strcmp (argv[1], "-h") || !strcmp (argv[1], "--help")) {
+		usage_gain_apply ();
+		return argc < 4 ? 1 : 0;
+	}
+
+	GainTrack gt;
+	if (gaintrack_open (&gt, argv[1])) {
+		fprintf (stderr, "Cannot open gain-track '%s'\n", argv[1]);
+		return 1;
+	}
+
+	float* gain = (float*)malloc (BLOCKSIZE * sizeof (float));
+	float* buf  = (float*)malloc (BLOCKSIZE * MAX_CHANNELS * sizeof (float));
+	int    rv   = 0;
+
+	for (int i = 2; i < argc; i += 2) {
+		WavFile in, out;
+		FILE*   f = fopen (argv[i], "rb");
+		if (!f || wav_open_read (&in, f)) {
+			fprintf (stderr, "Cannot read '%s'\n", argv[i]);
+			if (f) {
+				fclose (f);
+			}
+			rv = 1;
+			continue;
+		}
+		if (in.rate != gt.hdr.sample_rate || in.n_channels > MAX_CHANNELS) {
+			fprintf (stderr, "Sample-rate or channel-count mismatch: '%s'\n", argv[i]);
+			wav_close (&in);
+			rv = 1;
+			continue;
+		}
+		if (in.n_frames > gt.hdr.n_samples) {
+			fprintf (stderr, "Note: '%s' is longer than the gain-track.\n", argv[i]);
+		}
+
+		f = fopen (argv[i + 1], "wb");
+		if (!f || wav_open_write (&out, f, in.rate, in.n_channels, in.fmt)) {
+			fprintf (stderr, "Cannot write '%s'\n", argv[i + 1]);
+			if (f) {
+				fclose (f);
+			}
+			wav_close (&in);
+			rv = 1;
+			continue;
+		}
+
+		uint64_t pos = 0;
+		uint32_t n;
+		bool     ok = true;
+		while ((n = wav_read (&in, buf, BLOCKSIZE)) > 0) {
+			gaintrack_get (&gt, pos, n, gain);
+			gaintrack_apply (buf, gain, in.n_channels, n);
+			if (wav_write (&out, buf, n) != n) {
+				ok = false;
+				break;
+			}
+			pos += n;
+		}
+
+		if (wav_close (&out) || !ok) {
+			fprintf (stderr, "Failed to write '%s'\n", argv[i + 1]);
+			rv = 1;
+		}
+		wav_close (&in);
+	}
+
+	free (gain);
+	free (buf);
+	gaintrack_close_map (&gt);
+	return rv;
+}
+
+/* ****************************************************************************
+ * analyze
+ */
+
+static void
+usage_analyze (void)
+{
+	printf ("x42-darc-tool analyze [OPTIONS] <input> [symbol=value ...]\n\n"
+	        "Run the level detector only and report statistics of the gain\n"
+	        "that would be applied. No audio is written.\n\n"
+	        "Options:\n"
+	        "  -H, --no-histogram   only print the summary\n"
+	        "  -h, --help           display this help and exit\n");
+}
+
+static int
+mode_analyze (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "no-histogram", no_argument, 0, 'H' },
+		{ "help", no_argument, 0, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	bool histogram = true;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "Hh", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'H':
+				histogram = false;
+				break;
+			case 'h':
+				usage_analyze ();
+				return 0;
+			default:
+				usage_analyze ();
+				return 1;
+		}
+	}
+
+	if (argc - optind < 1) {
+		usage_analyze ();
+		return 1;
+	}
+
+	DarcParams p = darc_default_params;
+	if (!parse_param_args (&p, argc - optind - 1, &argv[optind + 1])) {
+		return 1;
+	}
+
+	Session s;
+	if (session_open (&s, argv[optind], &p)) {
+		return 1;
+	}
+
+	DyncompStats st;
+	DyncompStats_reset (&st);
+
+	uint32_t n;
+	while ((n = session_read (&s, BLOCKSIZE)) > 0) {
+		Dyncomp_analyze (&s.dyncomp, n, s.pbuf, &st);
+	}
+
+	const double sr = s.in.rate;
+	session_close (&s);
+
+	uint64_t total = 0;
+	for (int i = 0; i < DARC_HIST_BINS; ++i) {
+		total += st.hist[i];
+	}
+
+	if (st.n_samples == 0 || total == 0) {
+		fprintf (stderr, "No audio data.\n");
+		return 1;
+	}
+
+	printf ("Parameters:     ");
+	darc_params_print (stdout, &p);
+	printf ("Duration:       %.2f s\n", st.n_samples / sr);
+	printf ("Above thresh.:  %.2f s (%.1f%%)\n", st.n_above / sr, 100. * st.n_above / st.n_samples);
+	printf ("Hold engaged:   %.2f s (%.1f%%)\n", st.n_hold / sr, 100. * st.n_hold / st.n_samples);
+	printf ("Gain min/avg/max: %+.1f / %+.1f / %+.1f dB\n",
+	        st.gain_min, st.gain_sum / total, st.gain_max);
+
+	if (!histogram) {
+		return 0;
+	}
+
+	printf ("\nGain histogram [dB]:\n");
+	for (int i = 0; i < DARC_HIST_BINS; ++i) {
+		if (st.hist[i] == 0) {
+			continue;
+		}
+		const double pc = 100. * st.hist[i] / total;
+		printf ("%+3d..%+3d: %5.1f%% ", i + DARC_HIST_MIN, i + DARC_HIST_MIN + 1, pc);
+		for (int b = 0; b < rint (pc / 2); ++b) {
+			putchar ('#');
+		}
+		putchar ('\n');
+	}
+	return 0;
+}
+
+/* ****************************************************************************
+ * parameter sweep
+ */
+
+#define SWEEP_MAX_VALUES 64
+
+typedef struct {
+	float    val[6][SWEEP_MAX_VALUES]; // in DarcParams order
+	uint32_t n_val[6];
+} SweepGrid;
+
+/* parse "symbol=a,b,c" or "symbol=start:end:step" */
+static bool
+sweep_parse (SweepGrid* grid, const char* arg)
+{
+	static const char* sym[6] = { "inputgain", "threshold", "Ratio", "attack", "release", "hold" };
+
+	const char* eq = strchr (arg, '=');
+	if (!eq) {
+		return false;
+	}
+	int p = -1;
+	for (int i = 0; i < 6; ++i) {
+		if (strlen (sym[i]) == (size_t)(eq - arg) && !strncasecmp (arg, sym[i], eq - arg)) {
+			p = i;
+		}
+	}
+	if (p < 0) {
+		return false;
+	}
+
+	uint32_t    n = 0;
+	const char* v = eq + 1;
+	float       a, b, step;
+
+	if (3 == sscanf (v, "%f:%f:%f", &a, &b, &step)) {
+		if (step <= 0 || b < a) {
+			return false;
+		}
+		for (float x = a; x <= b + 1e-4f * step && n < SWEEP_MAX_VALUES; x = a + n * step) {
+			grid->val[p][n++] = x;
+		}
+	} else {
+		while (*v && n < SWEEP_MAX_VALUES) {
+			char* end;
+			grid->val[p][n++] = strtof (v, &end);
+			if (end == v) {
+				return false;
+			}
+			v = (*end == ',') ? end + 1 : end;
+		}
+	}
+	grid->n_val[p] = n;
+	return n > 0;
+}
+
+static void
+sweep_params (const SweepGrid* grid, uint32_t idx, DarcParams* p)
+{
+	float* f = (float*)p;
+	for (int i = 5; i >= 0; --i) {
+		f[i] = grid->val[i][idx % grid->n_val[i]];
+		idx /= grid->n_val[i];
+	}
+}
+
+typedef struct {
+	DyncompBank*      banks;
+	uint32_t          n_banks;
+	uint32_t          n_threads;
+	pthread_barrier_t barrier;
+	const float*      v;
+	const float*      k;
+	uint32_t          n_samples;
+	bool              quit;
+} SweepEngine;
+
+typedef struct {
+	SweepEngine* e;
+	uint32_t     id;
+} SweepWorker;
+
+static void*
+sweep_worker (void* arg)
+{
+	SweepWorker* w = (SweepWorker*)arg;
+	SweepEngine* e = w->e;
+	for (;;) {
+		pthread_barrier_wait (&e->barrier);
+		if (e->quit) {
+			break;
+		}
+		for (uint32_t b = w->id; b < e->n_banks; b += e->n_threads) {
+			DyncompBank_process (&e->banks[b], e->n_samples, e->v, e->k);
+		}
+		pthread_barrier_wait (&e->barrier);
+	}
+	return NULL;
+}
+
+/* read a block, and compute the signal power as used by the level
+ * detector as well as the K-weighted power for loudness measurement */
+static uint32_t
+sweep_read (Session* s, KWeight* kw, float* v, float* k)
+{
+	const uint32_t n = session_read (s, BLOCKSIZE);
+	kweight_process (kw, s->pbuf, s->n_channels, n, k);
+	for (uint32_t j = 0; j < n; ++j) {
+		float p = 0;
+		for (uint32_t c = 0; c < s->n_channels; ++c) {
+			p += s->pbuf[c][j] * s->pbuf[c][j];
+		}
+		v[j] = p * s->dyncomp.norm_input;
+	}
+	return n;
+}
+
+static void
+usage_sweep (void)
+{
+	printf ("x42-darc-tool sweep [OPTIONS] <input> [symbol=values ...]\n\n"
+	        "Evaluate a grid of parameter sets in a single pass over the input.\n"
+	        "Values are given as comma separated list or as start:end:step range, e.g.\n"
+	        "  threshold=-40:-20:2 Ratio=0.5,0.66,0.75,0.8 release=0.1,0.3,1\n"
+	        "No audio is rendered; for every parameter set the loudness of the\n"
+	        "output and the gain statistics are printed as CSV.\n\n"
+	        "Options:\n"
+	        "  -j, --threads <N>    number of worker threads (default: CPU count)\n"
+	        "  -h, --help           display this help and exit\n");
+}
+
+static int
+mode_sweep (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "threads", required_argument, 0, 'j' },
+		{ "help", no_argument, 0, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	long n_threads = sysconf (_SC_NPROCESSORS_ONLN);
+
+	int c;
+	while ((c = getopt_long (argc, argv, "j:h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'j':
+				n_threads = atoi (optarg);
+				break;
+			case 'h':
+				usage_sweep ();
+				return 0;
+			default:
+				usage_sweep ();
+				return 1;
+		}
+	}
+
+	if (argc - optind < 1) {
+		usage_sweep ();
+		return 1;
+	}
+
+	SweepGrid  grid;
+	DarcParams dflt = darc_default_params;
+	for (int i = 0; i < 6; ++i) {
+		grid.val[i][0] = ((float*)&dflt)[i];
+		grid.n_val[i]  = 1;
+	}
+	for (int i = optind + 1; i < argc; ++i) {
+		if (!sweep_parse (&grid, argv[i])) {
+			fprintf (stderr, "Invalid parameter range: '%s'\n", argv[i]);
+			return 1;
+		}
+	}
+
+	/* at most 64^6, does not overflow */
+	uint64_t n_grid = 1;
+	for (int i = 0; i < 6; ++i) {
+		n_grid *= grid.n_val[i];
+	}
+	if (n_grid > 65536) {
+		fprintf (stderr, "Parameter grid is too large (%llu sets).\n", (unsigned long long)n_grid);
+		return 1;
+	}
+	const uint32_t n_sets = n_grid;
+
+	Session s;
+	if (session_open (&s, argv[optind], &dflt)) {
+		return 1;
+	}
+
+	SweepEngine e;
+	memset (&e, 0, sizeof (SweepEngine));
+	e.n_banks = (n_sets + DARC_LANES - 1) / DARC_LANES;
+	e.banks   = (DyncompBank*)malloc (e.n_banks * sizeof (DyncompBank));
+
+	for (uint32_t b = 0; b < e.n_banks; ++b) {
+		DyncompBank_init (&e.banks[b], s.in.rate);
+	}
+	for (uint32_t i = 0; i < n_sets; ++i) {
+		DarcParams p;
+		Dyncomp    d;
+		sweep_params (&grid, i, &p);
+		darc_params_clamp (&p);
+		Dyncomp_init (&d, s.in.rate, s.n_channels);
+		darc_params_apply (&d, &p);
+		DyncompBank_set_lane (&e.banks[i / DARC_LANES], i % DARC_LANES, &d);
+	}
+
+	if (n_threads < 1) {
+		n_threads = 1;
+	}
+	if (n_threads > e.n_banks) {
+		n_threads = e.n_banks;
+	}
+	e.n_threads = n_threads;
+
+	/* double-buffered: read the next block while the workers process */
+	float*  v[2];
+	float*  k[2];
+	KWeight kw;
+	kweight_init (&kw, s.in.rate);
+	for (int i = 0; i < 2; ++i) {
+		v[i] = (float*)malloc (BLOCKSIZE * sizeof (float));
+		k[i] = (float*)malloc (BLOCKSIZE * sizeof (float));
+	}
+
+	pthread_barrier_init (&e.barrier, NULL, n_threads + 1);
+	pthread_t*   threads = (pthread_t*)malloc (n_threads * sizeof (pthread_t));
+	SweepWorker* workers = (SweepWorker*)malloc (n_threads * sizeof (SweepWorker));
+	for (uint32_t t = 0; t < e.n_threads; ++t) {
+		workers[t].e  = &e;
+		workers[t].id = t;
+		pthread_create (&threads[t], NULL, sweep_worker, &workers[t]);
+	}
+
+	int      cur = 0;
+	uint32_t n   = sweep_read (&s, &kw, v[cur], k[cur]);
+	while (n > 0) {
+		e.v         = v[cur];
+		e.k         = k[cur];
+		e.n_samples = n;
+		pthread_barrier_wait (&e.barrier);
+		cur ^= 1;
+		n = sweep_read (&s, &kw, v[cur], k[cur]);
+		pthread_barrier_wait (&e.barrier);
+	}
+
+	e.quit = true;
+	pthread_barrier_wait (&e.barrier);
+	for (uint32_t t = 0; t < e.n_threads; ++t) {
+		pthread_join (threads[t], NULL);
+	}
+	pthread_barrier_destroy (&e.barrier);
+
+	printf ("inputgain,threshold,Ratio,attack,release,hold,integrated_lufs,lra_lu,gain_avg_db,gain_min_db,above_threshold_pct\n");
+	for (uint32_t i = 0; i < n_sets; ++i) {
+		DarcParams         p;
+		const DyncompBank* b = &e.banks[i / DARC_LANES];
+		const uint32_t     l = i % DARC_LANES;
+		sweep_params (&grid, i, &p);
+		darc_params_clamp (&p);
+		printf ("%.2f,%.2f,%.4f,%.4f,%.4f,%.0f,%.2f,%.2f,%.2f,%.2f,%.1f\n",
+		        p.inputgain, p.threshold, p.ratio, p.attack, p.release, p.hold,
+		        loudness_integrated (&b->lufs[l]), loudness_range (&b->lufs[l]),
+		        DyncompBank_gain_avg (b, l), DyncompBank_gain_min (b, l),
+		        b->n_samples > 0 ? 100. * b->n_above[l] / b->n_samples : 0);
+	}
+
+	for (uint32_t b = 0; b < e.n_banks; ++b) {
+		DyncompBank_free (&e.banks[b]);
+	}
+	for (int i = 0; i < 2; ++i) {
+		free (v[i]);
+		free (k[i]);
+	}
+	free (e.banks);
+	free (threads);
+	free (workers);
+	session_close (&s);
+	return 0;
+}
+
+/* ****************************************************************************
+ * fit loudness range
+ */
+
+/* The search runs the detector on a decimated copy of the input:
+ * signal power is averaged over blocks of samples, which is sufficient
+ * for loudness measurement and retains the envelope for attack >= 1ms.
+ */
+#define FIT_RATE 1000
+#define FIT_MAX_PASSES 16
+#define FIT_MAX_RATIOS 32
+
+typedef struct {
+	DyncompBank  bank;
+	const float* v;
+	const float* k;
+	uint32_t     n_samples;
+} FitJob;
+
+typedef struct {
+	float  thr; // threshold at 0dB input-gain
+	double lra;
+	double lufs;
+	bool   valid;
+} FitPoint;
+
+static void*
+fit_worker (void* arg)
+{
+	FitJob* j = (FitJob*)arg;
+	DyncompBank_process (&j->bank, j->n_samples, j->v, j->k);
+	return NULL;
+}
+
+static void
+usage_fit (void)
+{
+	printf ("x42-darc-tool fit [OPTIONS] -L <LU> <input> [symbol=value ...]\n\n"
+	        "Find threshold and ratio that result in the given loudness range.\n"
+	        "The file is read once, and the level detector is evaluated on a\n"
+	        "decimated copy, no audio is rendered. The resulting parameters are\n"
+	        "printed as LV2 port settings. Attack, release and hold can be set\n"
+	        "using symbol=value pairs and are not modified.\n\n"
+	        "Options:\n"
+	        "  -L, --lra <LU>          target loudness range (required)\n"
+	        "  -I, --integrated <LUFS> target integrated loudness, set input-gain\n"
+	        "  -R, --ratios <list>     comma separated ratios to consider\n"
+	        "                          (default: 0.3,0.4,...,1.0)\n"
+	        "  -t, --tolerance <LU>    acceptable LRA deviation (default 0.5)\n"
+	        "  -j, --threads <N>       number of worker threads (default: CPU count)\n"
+	        "  -h, --help              display this help and exit\n");
+}
+
+static int
+mode_fit (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "lra", required_argument, 0, 'L' },
+		{ "integrated", required_argument, 0, 'I' },
+		{ "ratios", required_argument, 0, 'R' },
+		{ "tolerance", required_argument, 0, 't' },
+		{ "threads", required_argument, 0, 'j' },
+		{ "help", no_argument, 0, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	float    target_lra  = -1;
+	float    target_lufs = 0;
+	bool     set_lufs    = false;
+	float    tolerance   = .5f;
+	float    ratio[FIT_MAX_RATIOS];
+	uint32_t n_ratio   = 0;
+	long     n_threads = sysconf (_SC_NPROCESSORS_ONLN);
+
+	int c;
+	while ((c = getopt_long (argc, argv, "L:I:R:t:j:h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'L':
+				target_lra = atof (optarg);
+				break;
+			case 'I':
+				target_lufs = atof (optarg);
+				set_lufs    = true;
+				break;
+			case 'R':
+				for (const char* v = optarg; *v && n_ratio < FIT_MAX_RATIOS;) {
+					char* end;
+					float r = strtof (v, &end);
+					if (end == v || r < 0 || r > 1) {
+						fprintf (stderr, "Invalid ratio list: '%s'\n", optarg);
+						return 1;
+					}
+					ratio[n_ratio++] = r;
+					v = (*end == ',') ? end + 1 : end;
+				}
+				break;
+			case 't':
+				tolerance = atof (optarg);
+				break;
+			case 'j':
+				n_threads = atoi (optarg);
+				break;
+			case 'h':
+				usage_fit ();
+				return 0;
+			default:
+				usage_fit ();
+				return 1;
+		}
+	}
+
+	if (argc - optind < 1 || target_lra <= 0) {
+		usage_fit ();
+		return 1;
+	}
+
+	if (n_ratio == 0) {
+		for (n_ratio = 0; n_ratio < 8; ++n_ratio) {
+			ratio[n_ratio] = .3f + .1f * n_ratio;
+		}
+	}
+
+	DarcParams p = darc_default_params;
+	if (!parse_param_args (&p, argc - optind - 1, &argv[optind + 1])) {
+		return 1;
+	}
+	p.inputgain = 0;
+
+	Session s;
+	if (session_open (&s, argv[optind], &p)) {
+		return 1;
+	}
+
+	/* read and decimate the input */
+	const uint32_t dec  = s.in.rate > FIT_RATE ? s.in.rate / FIT_RATE : 1;
+	const double   rate = s.in.rate / (double)dec;
+
+	size_t   n_samples = 0;
+	size_t   alloc     = 0;
+	float*   v         = NULL;
+	float*   k         = NULL;
+	float*   vb        = (float*)malloc (BLOCKSIZE * sizeof (float));
+	float*   kb        = (float*)malloc (BLOCKSIZE * sizeof (float));
+	float    vs        = 0;
+	float    ks        = 0;
+	uint32_t phase     = 0;
+
+	KWeight kw;
+	kweight_init (&kw, s.in.rate);
+
+	uint32_t n;
+	while ((n = sweep_read (&s, &kw, vb, kb)) > 0) {
+		for (uint32_t j = 0; j < n; ++j) {
+			vs += vb[j];
+			ks += kb[j];
+			if (++phase < dec) {
+				continue;
+			}
+			if (n_samples == alloc) {
+				alloc = alloc ? 2 * alloc : 65536;
+				v     = (float*)realloc (v, alloc * sizeof (float));
+				k     = (float*)realloc (k, alloc * sizeof (float));
+				if (!v || !k) {
+					fprintf (stderr, "Out of memory\n");
+					return 1;
+				}
+			}
+			v[n_samples] = vs / dec;
+			k[n_samples] = ks / dec;
+			++n_samples;
+			vs    = 0;
+			ks    = 0;
+			phase = 0;
+		}
+	}
+
+	const uint32_t n_channels = s.n_channels;
+	free (vb);
+	free (kb);
+	session_close (&s);
+
+	if (n_samples == 0) {
+		fprintf (stderr, "No audio data.\n");
+		return 1;
+	}
+
+	/* loudness of the input */
+	Loudness src;
+	loudness_init (&src, rate);
+	for (size_t i = 0; i + src.seg_len <= n_samples; i += src.seg_len) {
+		double sum = 0;
+		for (uint32_t j = 0; j < src.seg_len; ++j) {
+			sum += k[i + j];
+		}
+		loudness_add_segment (&src, sum / src.seg_len);
+	}
+	const double src_lufs = loudness_integrated (&src);
+	const double src_lra  = loudness_range (&src);
+	loudness_free (&src);
+
+	printf ("Input:          I = %.1f LUFS, LRA = %.1f LU\n", src_lufs, src_lra);
+
+	if (src_lra <= target_lra) {
+		fprintf (stderr, "The loudness range of the input is already below the target.\n");
+		free (v);
+		free (k);
+		return 1;
+	}
+
+	/* Input-gain `g` is equivalent to a threshold of `threshold - g`
+	 * and a gain of `g * (1 - ratio)` applied to the output.
+	 * Search that threshold for each ratio, the result is mapped to
+	 * input-gain and threshold afterwards.
+	 */
+	const float thr_min = set_lufs ? -80.f : -50.f;
+	const float thr_max = set_lufs ? 0.f : -10.f;
+
+	float    lo[FIT_MAX_RATIOS];
+	float    hi[FIT_MAX_RATIOS];
+	FitPoint best[FIT_MAX_RATIOS];
+
+	for (uint32_t i = 0; i < n_ratio; ++i) {
+		lo[i]         = thr_min;
+		hi[i]         = thr_max;
+		best[i].valid = false;
+	}
+
+	if (n_threads < 1) {
+		n_threads = 1;
+	}
+
+	uint32_t n_banks = (n_ratio + DARC_LANES - 1) / DARC_LANES;
+	if (n_banks < n_threads) {
+		n_banks = n_threads;
+	}
+
+	const uint32_t per     = n_banks * DARC_LANES / n_ratio; // points per ratio and pass
+	FitJob*        jobs    = (FitJob*)malloc (n_banks * sizeof (FitJob));
+	pthread_t*     threads = (pthread_t*)malloc (n_banks * sizeof (pthread_t));
+
+	for (int pass = 0; pass < FIT_MAX_PASSES; ++pass) {
+		for (uint32_t b = 0; b < n_banks; ++b) {
+			DyncompBank_init (&jobs[b].bank, rate);
+			jobs[b].v         = v;
+			jobs[b].k         = k;
+			jobs[b].n_samples = n_samples;
+		}
+
+		for (uint32_t i = 0; i < n_ratio; ++i) {
+			for (uint32_t j = 0; j < per; ++j) {
+				const uint32_t q = i * per + j;
+				Dyncomp        d;
+				p.threshold = lo[i] + (hi[i] - lo[i]) * (j + 1.f) / (per + 1.f);
+				p.ratio     = ratio[i];
+				Dyncomp_init (&d, rate, n_channels);
+				darc_params_apply (&d, &p);
+				DyncompBank_set_lane (&jobs[q / DARC_LANES].bank, q % DARC_LANES, &d);
+			}
+		}
+
+		for (uint32_t b = 1; b < n_banks; ++b) {
+			pthread_create (&threads[b], NULL, fit_worker, &jobs[b]);
+		}
+		fit_worker (&jobs[0]);
+		for (uint32_t b = 1; b < n_banks; ++b) {
+			pthread_join (threads[b], NULL);
+		}
+
+		/* LRA increases with threshold, narrow down the interval */
+		bool done = true;
+		for (uint32_t i = 0; i < n_ratio; ++i) {
+			float nlo = lo[i];
+			float nhi = hi[i];
+			for (uint32_t j = 0; j < per; ++j) {
+				const uint32_t     q = i * per + j;
+				const DyncompBank* b = &jobs[q / DARC_LANES].bank;
+				const uint32_t     l = q % DARC_LANES;
+
+				FitPoint pt;
+				pt.thr      = lo[i] + (hi[i] - lo[i]) * (j + 1.f) / (per + 1.f);
+				pt.lra      = loudness_range (&b->lufs[l]);
+				pt.lufs     = loudness_integrated (&b->lufs[l]);
+				pt.valid    = true;
+
+				if (!best[i].valid || fabs (pt.lra - target_lra) < fabs (best[i].lra - target_lra)) {
+					best[i] = pt;
+				}
+				if (pt.lra <= target_lra) {
+					nlo = pt.thr;
+				} else if (pt.thr < nhi) {
+					nhi = pt.thr;
+				}
+			}
+			lo[i] = nlo;
+			hi[i] = nhi;
+			if (hi[i] - lo[i] > .1f && fabs (best[i].lra - target_lra) > .05) {
+				done = false;
+			}
+		}
+
+		for (uint32_t b = 0; b < n_banks; ++b) {
+			DyncompBank_free (&jobs[b].bank);
+		}
+		if (done) {
+			break;
+		}
+	}
+
+	free (jobs);
+	free (threads);
+	free (v);
+	free (k);
+
+	/* map to port values, prefer the lowest ratio */
+	int        sel = -1;
+	DarcParams res = p;
+	double     res_lufs = 0, res_lra = 0;
+
+	for (uint32_t i = 0; i < n_ratio; ++i) {
+		const FitPoint* pt = &best[i];
+		if (!pt->valid || fabs (pt->lra - target_lra) > tolerance) {
+			continue;
+		}
+		float g = 0;
+		if (set_lufs) {
+			if (ratio[i] < 1) {
+				g = (target_lufs - pt->lufs) / (1.f - ratio[i]);
+			} else if (fabs (target_lufs - pt->lufs) > tolerance) {
+				continue;
+			}
+		}
+		DarcParams cand = p;
+		cand.inputgain  = g;
+		cand.threshold  = pt->thr + g;
+		cand.ratio      = ratio[i];
+		if (!darc_params_clamp (&cand)) {
+			continue;
+		}
+		if (sel < 0 || ratio[i] < ratio[sel]) {
+			sel      = i;
+			res      = cand;
+			res_lra  = pt->lra;
+			res_lufs = pt->lufs + (1.f - ratio[i]) * g;
+		}
+	}
+
+	if (sel < 0) {
+		fprintf (stderr, "No parameter set within range meets the target.\n");
+		return 1;
+	}
+
+	printf ("Result:         I = %.1f LUFS, LRA = %.1f LU (estimated)\n", res_lufs, res_lra);
+	printf ("Port settings:  ");
+	darc_params_print (stdout, &res);
+	return 0;
+}
+
+/* ****************************************************************************
+ * replay a capture of x42-darc-headless
+ */
+
+static void
+usage_replay (void)
+{
+	printf ("x42-darc-tool replay [OPTIONS] <capture>\n\n"
+	        "Process the input and parameter changes that were captured by a\n"
+	        "running plugin (x42-darc-headless --capture) and verify that the\n"
+	        "output is bit-identical to the live output.\n\n"
+	        "Options:\n"
+	        "  -o, --output <file>    write the replayed output (32bit float WAV)\n"
+	        "  -i, --input <file>     write the captured input (32bit float WAV)\n"
+	        "  -v, --verbose          print every mismatching block\n"
+	        "  -h, --help             display this help and exit\n");
+}
+
+static double
+replay_time (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static int
+replay_wav (WavFile* w, const char* path, const DarcCapHeader* hdr)
+{
+	FILE* f = strcmp (path, "-") ? fopen (path, "wb") : stdout;
+	if (!f) {
+		fprintf (stderr, "Cannot open '%s' for writing\n", path);
+		return -1;
+	}
+	return wav_open_write (w, f, hdr->sample_rate, hdr->n_channels, WAV_FLOAT32);
+}
+
+/* process a block like run () */
+static void
+replay_block (Dyncomp* d, const DarcCapRecord* rec, float* io[2])
+{
+	darc_cap_set_coef (d, &rec->coef);
+	Dyncomp_process (d, rec->n_samples, io);
+}
+
+static int
+mode_replay (int argc, char** argv)
+{
+	const struct option long_options[] = {
+		{ "output", required_argument, 0, 'o' },
+		{ "input", required_argument, 0, 'i' },
+		{ "verbose", no_argument, 0, 'v' },
+		{ "help", no_argument, 0, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	const char* out_path = NULL;
+	const char* in_path  = NULL;
+	bool        verbose  = false;
+
+	int c;
+	while ((c = getopt_long (argc, argv, "o:i:vh", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'o':
+				out_path = optarg;
+				break;
+			case 'i':
+				in_path = optarg;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 'h':
+				usage_replay ();
+				return 0;
+			default:
+				usage_replay ();
+				return 1;
+		}
+	}
+
+	if (argc - optind != 1) {
+		usage_replay ();
+		return 1;
+	}
+
+	DarcCapReader cr;
+	if (darc_capreader_open (&cr, argv[optind])) {
+		fprintf (stderr, "Cannot read capture file '%s'\n", argv[optind]);
+		return 1;
+	}
+
+	const DarcCapHeader* hdr = &cr.hdr;
+
+	WavFile out, in;
+	memset (&out, 0, sizeof (WavFile));
+	memset (&in, 0, sizeof (WavFile));
+	if ((out_path && replay_wav (&out, out_path, hdr)) || (in_path && replay_wav (&in, in_path, hdr))) {
+		darc_capreader_close (&cr);
+		return 1;
+	}
+
+	Dyncomp  d;
+	bool     synced     = false;
+	uint64_t n_blocks   = 0;
+	uint64_t n_mismatch = 0;
+	uint64_t n_skipped  = 0;
+	uint64_t n_gaps     = 0;
+	uint64_t n_dropped  = 0;
+	uint64_t n_degraded = 0;
+	uint64_t n_samples  = 0;
+	double   dsp_time   = 0;
+	float*   ibuf       = NULL;
+	uint32_t ialloc     = 0;
+	int      rv         = 0;
+
+	Dyncomp_init (&d, hdr->sample_rate, hdr->n_channels);
+
+	DarcCapRecord rec;
+	int           rc;
+	while ((rc = darc_capreader_next (&cr, &rec)) > 0) {
+		if (rec.type == DARC_CAP_STATE) {
+			Dyncomp_init (&d, hdr->sample_rate, hdr->n_channels);
+			synced = Dyncomp_set_state (&d, &cr.state);
+			continue;
+		}
+		if (rec.type == DARC_CAP_GAP) {
+			++n_gaps;
+			n_dropped += rec.n_samples;
+			synced = false; // followed by a state record
+			continue;
+		}
+		if (!synced) {
+			++n_skipped;
+			continue;
+		}
+
+		float* io[2] = { cr.data[0], hdr->n_channels > 1 ? cr.data[1] : NULL };
+
+		if (in_path || out_path) {
+			if (rec.n_samples > ialloc) {
+				free (ibuf);
+				ialloc = rec.n_samples;
+				ibuf   = (float*)malloc (ialloc * hdr->n_channels * sizeof (float));
+			}
+			if (!ibuf) {
+				fprintf (stderr, "Out of memory.\n");
+				rv = 1;
+				break;
+			}
+		}
+		if (in_path) {
+			interleave (ibuf, io, hdr->n_channels, rec.n_samples);
+			if (wav_write (&in, ibuf, rec.n_samples) != rec.n_samples) {
+				fprintf (stderr, "Failed to write '%s'\n", in_path);
+				rv = 1;
+				break;
+			}
+		}
+
+		const double t0 = replay_time ();
+		replay_block (&d, &rec, io);
+		dsp_time += replay_time () - t0;
+
+		++n_blocks;
+		n_samples += rec.n_samples;
+		if (rec.coef.tier != DARC_TIER_FULL) {
+			++n_degraded;
+		}
+
+		const uint32_t hash = darc_cap_hash (io, hdr->n_channels, rec.n_samples);
+		if (hash != rec.hash) {
+			if (verbose) {
+				fprintf (stderr, "Mismatch at %.3fs (%llu), %u samples\n",
+				         rec.pos / hdr->sample_rate, (unsigned long long)rec.pos, rec.n_samples);
+			}
+			++n_mismatch;
+		}
+
+		if (out_path) {
+			interleave (ibuf, io, hdr->n_channels, rec.n_samples);
+			if (wav_write (&out, ibuf, rec.n_samples) != rec.n_samples) {
+				fprintf (stderr, "Failed to write '%s'\n", out_path);
+				rv = 1;
+				break;
+			}
+		}
+	}
+
+	if (rc < 0) {
+		fprintf (stderr, "Capture file is truncated or invalid.\n");
+		rv = 1;
+	}
+
+	if (out_path && wav_close (&out) && rv == 0) {
+		fprintf (stderr, "Failed to write '%s'\n", out_path);
+		rv = 1;
+	}
+	if (in_path && wav_close (&in) && rv == 0) {
+		fprintf (stderr, "Failed to write '%s'\n", in_path);
+		rv = 1;
+	}
+	const double sr = hdr->sample_rate;
+
+	free (ibuf);
+	darc_capreader_close (&cr);
+
+	printf ("Blocks:         %llu (%.2f s)\n", (unsigned long long)n_blocks, n_samples / sr);
+	printf ("Gaps:           %llu, %llu dropped block(s)\n", (unsigned long long)n_gaps, (unsigned long long)n_dropped);
+	if (n_skipped > 0) {
+		printf ("Skipped:        %llu block(s) without state\n", (unsigned long long)n_skipped);
+	}
+	if (n_degraded > 0) {
+		printf ("Degraded:       %llu block(s) with a cheaper kernel\n", (unsigned long long)n_degraded);
+	}
+	printf ("Mismatches:     %llu\n", (unsigned long long)n_mismatch);
+	if (n_samples > 0) {
+		printf ("DSP time:       %.3f ms (%.1f ns/sample)\n", 1e3 * dsp_time, 1e9 * dsp_time / n_samples);
+	}
+
+	return (rv || n_mismatch > 0) ? 1 : 0;
+}
+
+/* ****************************************************************************
+ * main
+ */
+
+struct Mode {
+	const char* name;
+	int (*main) (int, char**);
+	const char* desc;
+};
+
+static const struct Mode modes[] = {
+	{ "render", mode_render, "process an audio file" },
+	{ "gain-export", mode_gain_export, "analyze a file, write gain-track" },
+	{ "gain-apply", mode_gain_apply, "apply a gain-track to one or more files" },
+	{ "analyze", mode_analyze, "report gain statistics, without rendering" },
+	{ "sweep", mode_sweep, "evaluate a grid of parameters in one pass" },
+	{ "fit", mode_fit, "find parameters for a target loudness range" },
+	{ "replay", mode_replay, "verify a capture of the realtime client" },
+};
+
+static void
+usage (void)
+{
+	printf ("x42-darc-tool - x42 Dynamic Compressor, offline tool.\n\n"
+	        "Usage: x42-darc-tool <mode> [OPTIONS] ...\n\n"
+	        "Modes:\n");
+	for (size_t i = 0; i < sizeof (modes) / sizeof (struct Mode); ++i) {
+		printf ("  %-12s %s\n", modes[i].name, modes[i].desc);
+	}
+	printf ("\nUse 'x42-darc-tool <mode> --help' for mode specific options.\n"
+	        "\n"
+	        "Report bugs to <https://github.com/x42/darc.lv2/issues>\n"
+	        "Website: <https://github.com/x42/darc.lv2/>\n");
+}
+
+int
+main (int argc, char** argv)
+{
+	if (argc < 2) {
+		usage ();
+		return 1;
+	}
+	if (!strcmp (argv[1], "-h") || !strcmp (argv[1], "--help")) {
+		usage ();
+		return 0;
+	}
+	if (!strcmp (argv[1], "-V") || !strcmp (argv[1], "--version")) {
+		printf ("x42-darc-tool version %s\n", VERSION);
+		return 0;
+	}
+	for (size_t i = 0; i < sizeof (modes) / sizeof (struct Mode); ++i) {
+		if (!strcmp (argv[1], modes[i].name)) {
+			return modes[i].main (argc - 1, &argv[1]);
+		}
+	}
+	fprintf (stderr, "Unknown mode: '%s'\n", argv[1]);
+	usage ();
+	return 1;
+}
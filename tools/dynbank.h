@@ -0,0 +1,197 @@
+/* darc.lv2 -- bank of compressors evaluated side by side
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_DYNBANK_H
+#define _DARC_DYNBANK_H
+
+/* DyncompBank runs the Dyncomp detector for DARC_LANES parameter sets
+ * in a structure-of-arrays layout, so that the compiler can vectorize
+ * across lanes. To allow for that, the gain is computed using the
+ * approximations from fastmath.h.
+ *
+ * Parameters are taken from a configured Dyncomp, but unlike Dyncomp_run()
+ * input-gain and ratio are not interpolated, lanes start settled.
+ * The output is not rendered: per sample the bank takes the (normalized)
+ * signal power and the K-weighted power of the input, and accumulates the
+ * loudness of the virtual output as well as gain statistics.
+ */
+
+#include "../src/dyncomp.h"
+#include "../src/fastmath.h"
+#include "loudness.h"
+
+#define DARC_LANES 8
+
+typedef struct {
+	uint32_t n_lanes; // active lanes
+
+	/* parameters */
+	float g2[DARC_LANES]; // input gain, squared
+	float p_thr[DARC_LANES];
+	float p_hold[DARC_LANES];
+	float p_rat[DARC_LANES];
+	float w_att[DARC_LANES];
+	float w_rel[DARC_LANES];
+
+	/* state */
+	float za1[DARC_LANES];
+	float zr1[DARC_LANES];
+	float zr2[DARC_LANES];
+
+	/* statistics */
+	double   gain_sum[DARC_LANES]; // dB
+	float    gain_min[DARC_LANES]; // dB
+	uint64_t n_above[DARC_LANES];
+	uint64_t n_samples;
+
+	/* loudness */
+	Loudness lufs[DARC_LANES];
+	float    seg_acc[DARC_LANES];
+	uint32_t seg_pos;
+} DyncompBank;
+
+static void
+DyncompBank_init (DyncompBank* self, double rate)
+{
+	memset (self, 0, sizeof (DyncompBank));
+	for (uint32_t l = 0; l < DARC_LANES; ++l) {
+		loudness_init (&self->lufs[l], rate);
+		self->gain_min[l] = 100.f;
+		/* unused lanes run with a benign configuration */
+		self->p_thr[l] = self->za1[l] = self->zr1[l] = self->zr2[l] = 0.05f;
+	}
+}
+
+static void
+DyncompBank_free (DyncompBank* self)
+{
+	for (uint32_t l = 0; l < DARC_LANES; ++l) {
+		loudness_free (&self->lufs[l]);
+	}
+}
+
+/* configure lane `l` using the parameters and state of a Dyncomp */
+static void
+DyncompBank_set_lane (DyncompBank* self, uint32_t l, const Dyncomp* d)
+{
+	self->g2[l]     = d->p_ign * d->p_ign;
+	self->p_thr[l]  = d->p_thr;
+	self->p_hold[l] = d->hold ? 2.f * d->p_thr : 0.f;
+	self->p_rat[l]  = d->p_rat;
+	self->w_att[l]  = d->w_att;
+	self->w_rel[l]  = d->w_rel;
+	self->za1[l]    = d->za1;
+	self->zr1[l]    = d->zr1;
+	self->zr2[l]    = d->zr2;
+	if (l >= self->n_lanes) {
+		self->n_lanes = l + 1;
+	}
+}
+
+/* v: per sample input power, normalized by the number of channels
+ *    (as used by the Dyncomp level detector, without input gain).
+ * k: per sample sum of the squared K-weighted input of all channels.
+ */
+static void
+DyncompBank_process (DyncompBank* self, uint32_t n_samples, const float* v, const float* k)
+{
+	/* local copies, allow the compiler to assume there is no aliasing */
+	float g2[DARC_LANES], p_thr[DARC_LANES], p_hold[DARC_LANES];
+	float p_rat[DARC_LANES], w_att[DARC_LANES], w_rel[DARC_LANES];
+	float za1[DARC_LANES], zr1[DARC_LANES], zr2[DARC_LANES];
+	float acc[DARC_LANES], gsum[DARC_LANES], gmin[DARC_LANES];
+	int32_t above[DARC_LANES];
+
+	const uint32_t seg_len = self->lufs[0].seg_len;
+
+	memcpy (g2, self->g2, sizeof (g2));
+	memcpy (p_thr, self->p_thr, sizeof (p_thr));
+	memcpy (p_hold, self->p_hold, sizeof (p_hold));
+	memcpy (p_rat, self->p_rat, sizeof (p_rat));
+	memcpy (w_att, self->w_att, sizeof (w_att));
+	memcpy (w_rel, self->w_rel, sizeof (w_rel));
+	memcpy (za1, self->za1, sizeof (za1));
+	memcpy (zr1, self->zr1, sizeof (zr1));
+	memcpy (zr2, self->zr2, sizeof (zr2));
+	memcpy (acc, self->seg_acc, sizeof (acc));
+	memcpy (gmin, self->gain_min, sizeof (gmin));
+	memset (gsum, 0, sizeof (gsum));
+	memset (above, 0, sizeof (above));
+
+	uint32_t seg_pos = self->seg_pos;
+
+	for (uint32_t j = 0; j < n_samples; ++j) {
+		const float vj = v[j];
+		const float kj = k[j];
+
+		for (uint32_t l = 0; l < DARC_LANES; ++l) {
+			/* branch-free, so that the loop can be vectorized */
+			const float a  = za1[l] + w_att[l] * (p_thr[l] + g2[l] * vj - za1[l]);
+			const float r1 = zr1[l] < a ? a : (a < p_hold[l] ? zr1[l] : zr1[l] - w_rel[l] * zr1[l]);
+			const float r2 = zr2[l] < a ? a : (a < p_hold[l] ? zr2[l] : zr2[l] + w_rel[l] * (r1 - zr2[l]));
+			const float pg = -p_rat[l] * fast_logf (20.f * r2);
+
+			acc[l] += g2[l] * kj * fast_expf (2.f * pg);
+			gsum[l] += pg;
+			gmin[l] = gmin[l] < pg ? gmin[l] : pg;
+			above[l] += a >= 2.f * p_thr[l];
+
+			za1[l] = a;
+			zr1[l] = r1;
+			zr2[l] = r2;
+		}
+
+		if (++seg_pos == seg_len) {
+			seg_pos = 0;
+			for (uint32_t l = 0; l < self->n_lanes; ++l) {
+				loudness_add_segment (&self->lufs[l], acc[l] / seg_len);
+				acc[l] = 0;
+			}
+		}
+	}
+
+	for (uint32_t l = 0; l < DARC_LANES; ++l) {
+		if (!isfinite (za1[l])) {
+			za1[l] = zr1[l] = zr2[l] = p_thr[l];
+		}
+		self->gain_sum[l] += gsum[l] * 8.68589f; // 20 / log(10)
+		self->n_above[l] += above[l];
+	}
+
+	memcpy (self->za1, za1, sizeof (za1));
+	memcpy (self->zr1, zr1, sizeof (zr1));
+	memcpy (self->zr2, zr2, sizeof (zr2));
+	memcpy (self->seg_acc, acc, sizeof (acc));
+	memcpy (self->gain_min, gmin, sizeof (gmin));
+	self->seg_pos = seg_pos;
+	self->n_samples += n_samples;
+}
+
+static inline float
+DyncompBank_gain_min (const DyncompBank* self, uint32_t l)
+{
+	return self->gain_min[l] * 8.68589f;
+}
+
+static inline float
+DyncompBank_gain_avg (const DyncompBank* self, uint32_t l)
+{
+	return self->n_samples > 0 ? self->gain_sum[l] / self->n_samples : 0;
+}
+
+#endif
@@ -0,0 +1,220 @@
+/* darc.lv2 -- gain track files
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_GAINTRACK_H
+#define _DARC_GAINTRACK_H
+
+/* A gain track is the linear gain-factor computed by Dyncomp, stored
+ * every `decimation` samples as native float, following a fixed-size header.
+ * Intermediate values are linearly interpolated when applying the track.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define GAINTRACK_VERSION 1
+
+typedef struct {
+	char     magic[8]; // "DarcGain"
+	uint32_t version;
+	uint32_t decimation;
+	float    sample_rate;
+	uint32_t reserved;
+	uint64_t n_samples; // length of the analyzed audio
+	uint64_t n_points;  // number of stored gain values
+} GainTrackHeader;
+
+typedef struct {
+	GainTrackHeader hdr;
+	FILE*           f;
+	uint32_t        phase; // samples until next point is stored
+} GainTrackWriter;
+
+typedef struct {
+	GainTrackHeader hdr;
+	void*           map;
+	size_t          len;
+	const float*    gain;
+} GainTrack;
+
+static int
+gaintrack_create (GainTrackWriter* self, const char* path, float sample_rate, uint32_t decimation)
+{
+	memset (self, 0, sizeof (GainTrackWriter));
+	memcpy (self->hdr.magic, "DarcGain", 8);
+	self->hdr.version     = GAINTRACK_VERSION;
+	self->hdr.decimation  = decimation;
+	self->hdr.sample_rate = sample_rate;
+
+	self->f = fopen (path, "wb");
+	if (!self->f) {
+		return -1;
+	}
+	/* header is updated on close */
+	if (fwrite (&self->hdr, sizeof (GainTrackHeader), 1, self->f) != 1) {
+		fclose (self->f);
+		return -1;
+	}
+	return 0;
+}
+
+static int
+gaintrack_write (GainTrackWriter* self, const float* gain, uint32_t n_samples)
+{
+	const uint32_t dec = self->hdr.decimation;
+	if (dec == 1) {
+		self->hdr.n_points += n_samples;
+		self->hdr.n_samples += n_samples;
+		return fwrite (gain, sizeof (float), n_samples, self->f) == n_samples ? 0 : -1;
+	}
+	for (uint32_t i = self->phase; i < n_samples; i += dec) {
+		if (fwrite (&gain[i], sizeof (float), 1, self->f) != 1) {
+			return -1;
+		}
+		++self->hdr.n_points;
+	}
+	self->phase = (self->phase + dec - n_samples % dec) % dec;
+	self->hdr.n_samples += n_samples;
+	return 0;
+}
+
+static int
+gaintrack_close (GainTrackWriter* self)
+{
+	int rv = 0;
+	if (fseek (self->f, 0, SEEK_SET) || fwrite (&self->hdr, sizeof (GainTrackHeader), 1, self->f) != 1) {
+		rv = -1;
+	}
+	if (fclose (self->f)) {
+		rv = -1;
+	}
+	self->f = NULL;
+	return rv;
+}
+
+static int
+gaintrack_open (GainTrack* self, const char* path)
+{
+	struct stat st;
+	memset (self, 0, sizeof (GainTrack));
+
+	int fd = open (path, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat (fd, &st) || (size_t)st.st_size < sizeof (GainTrackHeader)) {
+		close (fd);
+		return -1;
+	}
+
+	self->len = st.st_size;
+	self->map = mmap (NULL, self->len, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if (self->map == MAP_FAILED) {
+		self->map = NULL;
+		return -1;
+	}
+
+	memcpy (&self->hdr, self->map, sizeof (GainTrackHeader));
+	self->gain = (const float*)((const char*)self->map + sizeof (GainTrackHeader));
+
+	if (memcmp (self->hdr.magic, "DarcGain", 8)
+	    || self->hdr.version != GAINTRACK_VERSION
+	    || self->hdr.decimation == 0
+	    || self->hdr.n_points == 0
+	    || self->hdr.n_points > (self->len - sizeof (GainTrackHeader)) / sizeof (float)) {
+		munmap (self->map, self->len);
+		self->map = NULL;
+		return -1;
+	}
+
+	madvise (self->map, self->len, MADV_SEQUENTIAL);
+	return 0;
+}
+
+static void
+gaintrack_close_map (GainTrack* self)
+{
+	if (self->map) {
+		munmap (self->map, self->len);
+	}
+	self->map = NULL;
+}
+
+/* expand gain values for samples [pos, pos + n_samples) */
+static void
+gaintrack_get (const GainTrack* self, uint64_t pos, uint32_t n_samples, float* out)
+{
+	const uint64_t np  = self->hdr.n_points;
+	const uint32_t dec = self->hdr.decimation;
+
+	if (dec == 1) {
+		uint32_t n = 0;
+		if (pos < np) {
+			n = np - pos < n_samples ? np - pos : n_samples;
+			memcpy (out, &self->gain[pos], n * sizeof (float));
+		}
+		/* hold the last value */
+		for (uint32_t i = n; i < n_samples; ++i) {
+			out[i] = self->gain[np - 1];
+		}
+		return;
+	}
+
+	const float rdec = 1.f / dec;
+	for (uint32_t i = 0; i < n_samples; ++i) {
+		const uint64_t p = pos + i;
+		const uint64_t k = p / dec;
+		if (k + 1 >= np) {
+			out[i] = self->gain[np - 1];
+		} else {
+			const float f  = (p - k * dec) * rdec;
+			const float g0 = self->gain[k];
+			out[i]         = g0 + f * (self->gain[k + 1] - g0);
+		}
+	}
+}
+
+/* multiply interleaved audio with gain, in place */
+static void
+gaintrack_apply (float* buf, const float* gain, uint32_t n_channels, uint32_t n_samples)
+{
+	if (n_channels == 1) {
+		for (uint32_t i = 0; i < n_samples; ++i) {
+			buf[i] *= gain[i];
+		}
+	} else if (n_channels == 2) {
+		for (uint32_t i = 0; i < n_samples; ++i) {
+			buf[2 * i] *= gain[i];
+			buf[2 * i + 1] *= gain[i];
+		}
+	} else {
+		for (uint32_t i = 0; i < n_samples; ++i) {
+			for (uint32_t c = 0; c < n_channels; ++c) {
+				buf[i * n_channels + c] *= gain[i];
+			}
+		}
+	}
+}
+
+#endif
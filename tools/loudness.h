@@ -0,0 +1,245 @@
+/* darc.lv2 -- ITU-R BS.1770 / EBU R128 loudness measurement
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_LOUDNESS_H
+#define _DARC_LOUDNESS_H
+
+/* K-weighting filter and a gated loudness accumulator.
+ *
+ * The accumulator collects the mean (K-weighted) power of consecutive
+ * 100ms segments. Integrated loudness uses 400ms blocks (4 segments, 75%
+ * overlap), loudness range uses 3s short-term windows at 10Hz.
+ * All channels are weighted equally.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+typedef struct {
+	double b0, b1, b2, a1, a2;
+} KBiquad;
+
+typedef struct {
+	KBiquad shelf;
+	KBiquad hpf;
+	double  z[MAX_CHANNELS][4];
+} KWeight;
+
+static void
+kweight_init (KWeight* self, double rate)
+{
+	memset (self, 0, sizeof (KWeight));
+
+	/* high shelf, +4dB */
+	double f0 = 1681.974450955533;
+	double G  = 3.999843853973347;
+	double Q  = 0.7071752369554196;
+	double K  = tan (M_PI * f0 / rate);
+	double Vh = pow (10.0, G / 20.0);
+	double Vb = pow (Vh, 0.4996667741545416);
+	double a0 = 1.0 + K / Q + K * K;
+
+	self->shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+	self->shelf.b1 = 2.0 * (K * K - Vh) / a0;
+	self->shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+	self->shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+	self->shelf.a2 = (1.0 - K / Q + K * K) / a0;
+
+	/* RLB high-pass */
+	f0 = 38.13547087602444;
+	Q  = 0.5003270373238773;
+	K  = tan (M_PI * f0 / rate);
+	a0 = 1.0 + K / Q + K * K;
+
+	self->hpf.b0 = 1.0;
+	self->hpf.b1 = -2.0;
+	self->hpf.b2 = 1.0;
+	self->hpf.a1 = 2.0 * (K * K - 1.0) / a0;
+	self->hpf.a2 = (1.0 - K / Q + K * K) / a0;
+}
+
+/* sum of the squared K-weighted signal of all channels */
+static void
+kweight_process (KWeight* self, float* const* in, uint32_t n_channels, uint32_t n_samples, float* kpow)
+{
+	const KBiquad s = self->shelf;
+	const KBiquad h = self->hpf;
+
+	memset (kpow, 0, n_samples * sizeof (float));
+
+	for (uint32_t c = 0; c < n_channels; ++c) {
+		double*      z = self->z[c];
+		const float* x = in[c];
+		for (uint32_t i = 0; i < n_samples; ++i) {
+			/* transposed direct form II */
+			const double y1 = s.b0 * x[i] + z[0];
+			z[0]            = s.b1 * x[i] - s.a1 * y1 + z[1];
+			z[1]            = s.b2 * x[i] - s.a2 * y1;
+			const double y2 = h.b0 * y1 + z[2];
+			z[2]            = h.b1 * y1 - h.a1 * y2 + z[3];
+			z[3]            = h.b2 * y1 - h.a2 * y2;
+			kpow[i] += y2 * y2;
+		}
+		/* denormal protection */
+		for (int k = 0; k < 4; ++k) {
+			if (fabs (z[k]) < 1e-20) {
+				z[k] = 0;
+			}
+		}
+	}
+}
+
+typedef struct {
+	float*   seg; // mean power of 100ms segments
+	size_t   n_seg;
+	size_t   alloc;
+	uint32_t seg_len; // samples per segment
+} Loudness;
+
+static void
+loudness_init (Loudness* self, double rate)
+{
+	memset (self, 0, sizeof (Loudness));
+	self->seg_len = rint (rate * .1);
+}
+
+static void
+loudness_free (Loudness* self)
+{
+	free (self->seg);
+	self->seg   = NULL;
+	self->alloc = 0;
+	self->n_seg = 0;
+}
+
+static void
+loudness_add_segment (Loudness* self, float power)
+{
+	if (self->n_seg == self->alloc) {
+		size_t alloc = self->alloc ? 2 * self->alloc : 4096;
+		float* seg   = (float*)realloc (self->seg, alloc * sizeof (float));
+		if (!seg) {
+			return;
+		}
+		self->seg   = seg;
+		self->alloc = alloc;
+	}
+	self->seg[self->n_seg++] = power;
+}
+
+static inline double
+loudness_lufs (double power)
+{
+	return power > 1e-20 ? -0.691 + 10.0 * log10 (power) : -200;
+}
+
+static int
+loudness_cmp (const void* a, const void* b)
+{
+	const double x = *(const double*)a;
+	const double y = *(const double*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* integrated loudness in LUFS, -200 if all gated */
+static double
+loudness_integrated (const Loudness* self)
+{
+	const double gate_abs = pow (10.0, (-70.0 + 0.691) / 10.0);
+	double       sum      = 0;
+	size_t       cnt      = 0;
+
+	for (size_t i = 3; i < self->n_seg; ++i) {
+		const double p = .25 * (self->seg[i - 3] + self->seg[i - 2] + self->seg[i - 1] + self->seg[i]);
+		if (p > gate_abs) {
+			sum += p;
+			++cnt;
+		}
+	}
+	if (cnt == 0) {
+		return -200;
+	}
+
+	const double gate_rel = .1 * sum / cnt; // -10 LU
+	sum                   = 0;
+	cnt                   = 0;
+	for (size_t i = 3; i < self->n_seg; ++i) {
+		const double p = .25 * (self->seg[i - 3] + self->seg[i - 2] + self->seg[i - 1] + self->seg[i]);
+		if (p > gate_abs && p > gate_rel) {
+			sum += p;
+			++cnt;
+		}
+	}
+	return cnt > 0 ? loudness_lufs (sum / cnt) : -200;
+}
+
+/* loudness range in LU */
+static double
+loudness_range (const Loudness* self)
+{
+	if (self->n_seg < 30) {
+		return 0;
+	}
+
+	const double gate_abs = pow (10.0, (-70.0 + 0.691) / 10.0);
+	const size_t n_st     = self->n_seg - 29;
+	double*      st       = (double*)malloc (n_st * sizeof (double));
+	double       sum      = 0;
+	double       win      = 0;
+	size_t       cnt      = 0;
+
+	if (!st) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < 29; ++i) {
+		win += self->seg[i];
+	}
+	for (size_t i = 29; i < self->n_seg; ++i) {
+		win += self->seg[i];
+		const double p = win / 30.0;
+		if (p > gate_abs) {
+			st[cnt++] = p;
+			sum += p;
+		}
+		win -= self->seg[i - 29];
+	}
+
+	const double gate_rel = .01 * sum / (cnt > 0 ? cnt : 1); // -20 LU
+	size_t       n        = 0;
+	for (size_t i = 0; i < cnt; ++i) {
+		if (st[i] > gate_rel) {
+			st[n++] = st[i];
+		}
+	}
+
+	double lra = 0;
+	if (n > 1) {
+		qsort (st, n, sizeof (double), loudness_cmp);
+		const double lo = st[(size_t)rint ((n - 1) * .10)];
+		const double hi = st[(size_t)rint ((n - 1) * .95)];
+		lra             = 10.0 * log10 (hi / lo);
+	}
+	free (st);
+	return lra;
+}
+
+#endif
@@ -0,0 +1,577 @@
+/* darc.lv2 -- LD_PRELOAD interposer to detect non realtime-safe calls
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This library wraps memory allocation, locking and common system calls.
+ * Between rtcheck_enter () and rtcheck_leave () on the same thread, every
+ * call is counted as violation. With RTCHECK_ABORT set in the environment
+ * the first violation calls abort (), to get a backtrace in a debugger.
+ *
+ * The calls are forwarded to the next definition (usually libc). While
+ * those are looked up, allocations are served from a small static heap.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RTCHECK_EXPORT __attribute__ ((visibility ("default")))
+
+enum RtFn {
+	RT_MALLOC = 0,
+	RT_CALLOC,
+	RT_REALLOC,
+	RT_FREE,
+	RT_POSIX_MEMALIGN,
+	RT_ALIGNED_ALLOC,
+	RT_MEMALIGN,
+	RT_MUTEX_LOCK,
+	RT_MUTEX_TRYLOCK,
+	RT_MUTEX_UNLOCK,
+	RT_COND_WAIT,
+	RT_COND_TIMEDWAIT,
+	RT_COND_SIGNAL,
+	RT_COND_BROADCAST,
+	RT_RWLOCK_RDLOCK,
+	RT_RWLOCK_WRLOCK,
+	RT_RWLOCK_UNLOCK,
+	RT_SEM_WAIT,
+	RT_SEM_POST,
+	RT_OPEN,
+	RT_CLOSE,
+	RT_READ,
+	RT_WRITE,
+	RT_FOPEN,
+	RT_FWRITE,
+	RT_FFLUSH,
+	RT_MMAP,
+	RT_MUNMAP,
+	RT_POLL,
+	RT_SELECT,
+	RT_USLEEP,
+	RT_NANOSLEEP,
+	RT_CLOCK_NANOSLEEP,
+	RT_SCHED_YIELD,
+	RT_LAST
+};
+
+static const char* rt_names[RT_LAST] = {
+	"malloc", "calloc", "realloc", "free",
+	"posix_memalign", "aligned_alloc", "memalign",
+	"pthread_mutex_lock", "pthread_mutex_trylock", "pthread_mutex_unlock",
+	"pthread_cond_wait", "pthread_cond_timedwait",
+	"pthread_cond_signal", "pthread_cond_broadcast",
+	"pthread_rwlock_rdlock", "pthread_rwlock_wrlock", "pthread_rwlock_unlock",
+	"sem_wait", "sem_post",
+	"open", "close", "read", "write",
+	"fopen", "fwrite", "fflush",
+	"mmap", "munmap", "poll", "select",
+	"usleep", "nanosleep", "clock_nanosleep", "sched_yield"
+};
+
+static uint64_t rt_count[RT_LAST];
+static bool     rt_abort = false;
+
+static __thread int rt_depth __attribute__ ((tls_model ("initial-exec")));
+
+static inline void
+rt_hit (enum RtFn f)
+{
+	if (rt_depth > 0) {
+		__atomic_fetch_add (&rt_count[f], 1, __ATOMIC_RELAXED);
+		if (rt_abort) {
+			rt_depth = 0;
+			abort ();
+		}
+	}
+}
+
+/* ****************************************************************************
+ * public API, looked up by the test driver
+ */
+
+RTCHECK_EXPORT void
+rtcheck_enter (void)
+{
+	++rt_depth;
+}
+
+RTCHECK_EXPORT void
+rtcheck_leave (void)
+{
+	--rt_depth;
+}
+
+/* number of violations of the given function, returns NULL at the end */
+RTCHECK_EXPORT const char*
+rtcheck_stat (int i, uint64_t* n)
+{
+	if (i < 0 || i >= RT_LAST) {
+		return NULL;
+	}
+	*n = __atomic_load_n (&rt_count[i], __ATOMIC_RELAXED);
+	return rt_names[i];
+}
+
+/* ****************************************************************************
+ * symbol lookup
+ */
+
+static void* (*real_malloc) (size_t);
+static void* (*real_calloc) (size_t, size_t);
+static void* (*real_realloc) (void*, size_t);
+static void (*real_free) (void*);
+static int (*real_posix_memalign) (void**, size_t, size_t);
+static void* (*real_aligned_alloc) (size_t, size_t);
+static void* (*real_memalign) (size_t, size_t);
+
+static int (*real_mutex_lock) (pthread_mutex_t*);
+static int (*real_mutex_trylock) (pthread_mutex_t*);
+static int (*real_mutex_unlock) (pthread_mutex_t*);
+static int (*real_cond_wait) (pthread_cond_t*, pthread_mutex_t*);
+static int (*real_cond_timedwait) (pthread_cond_t*, pthread_mutex_t*, const struct timespec*);
+static int (*real_cond_signal) (pthread_cond_t*);
+static int (*real_cond_broadcast) (pthread_cond_t*);
+static int (*real_rwlock_rdlock) (pthread_rwlock_t*);
+static int (*real_rwlock_wrlock) (pthread_rwlock_t*);
+static int (*real_rwlock_unlock) (pthread_rwlock_t*);
+static int (*real_sem_wait) (sem_t*);
+static int (*real_sem_post) (sem_t*);
+
+static int (*real_open) (const char*, int, ...);
+static int (*real_close) (int);
+static ssize_t (*real_read) (int, void*, size_t);
+static ssize_t (*real_write) (int, const void*, size_t);
+static FILE* (*real_fopen) (const char*, const char*);
+static size_t (*real_fwrite) (const void*, size_t, size_t, FILE*);
+static int (*real_fflush) (FILE*);
+static void* (*real_mmap) (void*, size_t, int, int, int, off_t);
+static int (*real_munmap) (void*, size_t);
+static int (*real_poll) (struct pollfd*, nfds_t, int);
+static int (*real_select) (int, fd_set*, fd_set*, fd_set*, struct timeval*);
+static int (*real_usleep) (useconds_t);
+static int (*real_nanosleep) (const struct timespec*, struct timespec*);
+static int (*real_clock_nanosleep) (clockid_t, int, const struct timespec*, struct timespec*);
+static int (*real_sched_yield) (void);
+
+/* dlsym () may allocate before malloc is resolved */
+static char   boot_heap[8192] __attribute__ ((aligned (16)));
+static size_t boot_used;
+static int    resolving;
+
+static void*
+boot_alloc (size_t n)
+{
+	n = (n + 15) & ~(size_t)15;
+	if (boot_used + n > sizeof (boot_heap)) {
+		return NULL;
+	}
+	void* p = &boot_heap[boot_used];
+	boot_used += n;
+	return p;
+}
+
+static inline bool
+is_boot (const void* p)
+{
+	return (const char*)p >= boot_heap && (const char*)p < boot_heap + sizeof (boot_heap);
+}
+
+#define RESOLVE(VAR, NAME) \
+	*(void**)(&VAR) = dlsym (RTLD_NEXT, NAME)
+
+static void
+rt_resolve (void)
+{
+	if (real_malloc || resolving) {
+		return;
+	}
+	resolving = 1;
+	RESOLVE (real_malloc, "malloc");
+	RESOLVE (real_calloc, "calloc");
+	RESOLVE (real_realloc, "realloc");
+	RESOLVE (real_free, "free");
+	RESOLVE (real_posix_memalign, "posix_memalign");
+	RESOLVE (real_aligned_alloc, "aligned_alloc");
+	RESOLVE (real_memalign, "memalign");
+	RESOLVE (real_mutex_lock, "pthread_mutex_lock");
+	RESOLVE (real_mutex_trylock, "pthread_mutex_trylock");
+	RESOLVE (real_mutex_unlock, "pthread_mutex_unlock");
+	RESOLVE (real_cond_wait, "pthread_cond_wait");
+	RESOLVE (real_cond_timedwait, "pthread_cond_timedwait");
+	RESOLVE (real_cond_signal, "pthread_cond_signal");
+	RESOLVE (real_cond_broadcast, "pthread_cond_broadcast");
+	RESOLVE (real_rwlock_rdlock, "pthread_rwlock_rdlock");
+	RESOLVE (real_rwlock_wrlock, "pthread_rwlock_wrlock");
+	RESOLVE (real_rwlock_unlock, "pthread_rwlock_unlock");
+	RESOLVE (real_sem_wait, "sem_wait");
+	RESOLVE (real_sem_post, "sem_post");
+	RESOLVE (real_open, "open");
+	RESOLVE (real_close, "close");
+	RESOLVE (real_read, "read");
+	RESOLVE (real_write, "write");
+	RESOLVE (real_fopen, "fopen");
+	RESOLVE (real_fwrite, "fwrite");
+	RESOLVE (real_fflush, "fflush");
+	RESOLVE (real_mmap, "mmap");
+	RESOLVE (real_munmap, "munmap");
+	RESOLVE (real_poll, "poll");
+	RESOLVE (real_select, "select");
+	RESOLVE (real_usleep, "usleep");
+	RESOLVE (real_nanosleep, "nanosleep");
+	RESOLVE (real_clock_nanosleep, "clock_nanosleep");
+	RESOLVE (real_sched_yield, "sched_yield");
+	resolving = 0;
+}
+
+__attribute__ ((constructor)) static void
+rt_init (void)
+{
+	rt_resolve ();
+	rt_abort = getenv ("RTCHECK_ABORT") != NULL;
+}
+
+/* ****************************************************************************
+ * memory
+ */
+
+RTCHECK_EXPORT void*
+malloc (size_t n)
+{
+	rt_resolve ();
+	if (!real_malloc || resolving) {
+		return boot_alloc (n);
+	}
+	rt_hit (RT_MALLOC);
+	return real_malloc (n);
+}
+
+RTCHECK_EXPORT void*
+calloc (size_t n, size_t s)
+{
+	rt_resolve ();
+	if (!real_calloc || resolving) {
+		return boot_alloc (n * s); // static, zero initialized
+	}
+	rt_hit (RT_CALLOC);
+	return real_calloc (n, s);
+}
+
+RTCHECK_EXPORT void*
+realloc (void* p, size_t n)
+{
+	rt_resolve ();
+	if (!real_realloc || resolving) {
+		return NULL;
+	}
+	rt_hit (RT_REALLOC);
+	if (is_boot (p)) {
+		void* r = real_malloc (n);
+		if (r) {
+			const size_t avail = boot_heap + sizeof (boot_heap) - (char*)p;
+			memcpy (r, p, n < avail ? n : avail);
+		}
+		return r;
+	}
+	return real_realloc (p, n);
+}
+
+RTCHECK_EXPORT void
+free (void* p)
+{
+	if (!p || is_boot (p)) {
+		return;
+	}
+	rt_resolve ();
+	if (!real_free) {
+		return;
+	}
+	rt_hit (RT_FREE);
+	real_free (p);
+}
+
+RTCHECK_EXPORT int
+posix_memalign (void** p, size_t a, size_t n)
+{
+	rt_resolve ();
+	rt_hit (RT_POSIX_MEMALIGN);
+	return real_posix_memalign (p, a, n);
+}
+
+RTCHECK_EXPORT void*
+aligned_alloc (size_t a, size_t n)
+{
+	rt_resolve ();
+	rt_hit (RT_ALIGNED_ALLOC);
+	return real_aligned_alloc (a, n);
+}
+
+RTCHECK_EXPORT void*
+memalign (size_t a, size_t n)
+{
+	rt_resolve ();
+	rt_hit (RT_MEMALIGN);
+	return real_memalign (a, n);
+}
+
+/* ****************************************************************************
+ * locks
+ */
+
+RTCHECK_EXPORT int
+pthread_mutex_lock (pthread_mutex_t* m)
+{
+	rt_resolve ();
+	rt_hit (RT_MUTEX_LOCK);
+	return real_mutex_lock (m);
+}
+
+RTCHECK_EXPORT int
+pthread_mutex_trylock (pthread_mutex_t* m)
+{
+	rt_resolve ();
+	rt_hit (RT_MUTEX_TRYLOCK);
+	return real_mutex_trylock (m);
+}
+
+RTCHECK_EXPORT int
+pthread_mutex_unlock (pthread_mutex_t* m)
+{
+	rt_resolve ();
+	rt_hit (RT_MUTEX_UNLOCK);
+	return real_mutex_unlock (m);
+}
+
+RTCHECK_EXPORT int
+pthread_cond_wait (pthread_cond_t* c, pthread_mutex_t* m)
+{
+	rt_resolve ();
+	rt_hit (RT_COND_WAIT);
+	return real_cond_wait (c, m);
+}
+
+RTCHECK_EXPORT int
+pthread_cond_timedwait (pthread_cond_t* c, pthread_mutex_t* m, const struct timespec* t)
+{
+	rt_resolve ();
+	rt_hit (RT_COND_TIMEDWAIT);
+	return real_cond_timedwait (c, m, t);
+}
+
+RTCHECK_EXPORT int
+pthread_cond_signal (pthread_cond_t* c)
+{
+	rt_resolve ();
+	rt_hit (RT_COND_SIGNAL);
+	return real_cond_signal (c);
+}
+
+RTCHECK_EXPORT int
+pthread_cond_broadcast (pthread_cond_t* c)
+{
+	rt_resolve ();
+	rt_hit (RT_COND_BROADCAST);
+	return real_cond_broadcast (c);
+}
+
+RTCHECK_EXPORT int
+pthread_rwlock_rdlock (pthread_rwlock_t* l)
+{
+	rt_resolve ();
+	rt_hit (RT_RWLOCK_RDLOCK);
+	return real_rwlock_rdlock (l);
+}
+
+RTCHECK_EXPORT int
+pthread_rwlock_wrlock (pthread_rwlock_t* l)
+{
+	rt_resolve ();
+	rt_hit (RT_RWLOCK_WRLOCK);
+	return real_rwlock_wrlock (l);
+}
+
+RTCHECK_EXPORT int
+pthread_rwlock_unlock (pthread_rwlock_t* l)
+{
+	rt_resolve ();
+	rt_hit (RT_RWLOCK_UNLOCK);
+	return real_rwlock_unlock (l);
+}
+
+RTCHECK_EXPORT int
+sem_wait (sem_t* s)
+{
+	rt_resolve ();
+	rt_hit (RT_SEM_WAIT);
+	return real_sem_wait (s);
+}
+
+RTCHECK_EXPORT int
+sem_post (sem_t* s)
+{
+	rt_resolve ();
+	rt_hit (RT_SEM_POST);
+	return real_sem_post (s);
+}
+
+/* ****************************************************************************
+ * system calls and stdio
+ */
+
+RTCHECK_EXPORT int
+open (const char* path, int flags, ...)
+{
+	mode_t mode = 0;
+	if (flags & O_CREAT) {
+		va_list ap;
+		va_start (ap, flags);
+		mode = va_arg (ap, int);
+		va_end (ap);
+	}
+	rt_resolve ();
+	rt_hit (RT_OPEN);
+	return real_open (path, flags, mode);
+}
+
+RTCHECK_EXPORT int
+close (int fd)
+{
+	rt_resolve ();
+	rt_hit (RT_CLOSE);
+	return real_close (fd);
+}
+
+RTCHECK_EXPORT ssize_t
+read (int fd, void* buf, size_t n)
+{
+	rt_resolve ();
+	rt_hit (RT_READ);
+	return real_read (fd, buf, n);
+}
+
+RTCHECK_EXPORT ssize_t
+write (int fd, const void* buf, size_t n)
+{
+	rt_resolve ();
+	rt_hit (RT_WRITE);
+	return real_write (fd, buf, n);
+}
+
+RTCHECK_EXPORT FILE*
+fopen (const char* path, const char* mode)
+{
+	rt_resolve ();
+	rt_hit (RT_FOPEN);
+	return real_fopen (path, mode);
+}
+
+RTCHECK_EXPORT size_t
+fwrite (const void* p, size_t s, size_t n, FILE* f)
+{
+	rt_resolve ();
+	rt_hit (RT_FWRITE);
+	return real_fwrite (p, s, n, f);
+}
+
+RTCHECK_EXPORT int
+fflush (FILE* f)
+{
+	rt_resolve ();
+	rt_hit (RT_FFLUSH);
+	return real_fflush (f);
+}
+
+RTCHECK_EXPORT void*
+mmap (void* addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+	rt_resolve ();
+	rt_hit (RT_MMAP);
+	return real_mmap (addr, len, prot, flags, fd, off);
+}
+
+RTCHECK_EXPORT int
+munmap (void* addr, size_t len)
+{
+	rt_resolve ();
+	rt_hit (RT_MUNMAP);
+	return real_munmap (addr, len);
+}
+
+RTCHECK_EXPORT int
+poll (struct pollfd* fds, nfds_t n, int timeout)
+{
+	rt_resolve ();
+	rt_hit (RT_POLL);
+	return real_poll (fds, n, timeout);
+}
+
+RTCHECK_EXPORT int
+select (int n, fd_set* r, fd_set* w, fd_set* e, struct timeval* t)
+{
+	rt_resolve ();
+	rt_hit (RT_SELECT);
+	return real_select (n, r, w, e, t);
+}
+
+RTCHECK_EXPORT int
+usleep (useconds_t us)
+{
+	rt_resolve ();
+	rt_hit (RT_USLEEP);
+	return real_usleep (us);
+}
+
+RTCHECK_EXPORT int
+nanosleep (const struct timespec* req, struct timespec* rem)
+{
+	rt_resolve ();
+	rt_hit (RT_NANOSLEEP);
+	return real_nanosleep (req, rem);
+}
+
+RTCHECK_EXPORT int
+clock_nanosleep (clockid_t clk, int flags, const struct timespec* req, struct timespec* rem)
+{
+	rt_resolve ();
+	rt_hit (RT_CLOCK_NANOSLEEP);
+	return real_clock_nanosleep (clk, flags, req, rem);
+}
+
+RTCHECK_EXPORT int
+sched_yield (void)
+{
+	rt_resolve ();
+	rt_hit (RT_SCHED_YIELD);
+	return real_sched_yield ();
+}
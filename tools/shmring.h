@@ -0,0 +1,257 @@
+/* darc.lv2 -- shared memory ring-buffer
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_SHMRING_H
+#define _DARC_SHMRING_H
+
+/* A POSIX shared memory segment holding a header and one planar audio
+ * ring-buffer per channel. The ring has three positions:
+ *
+ *   read <= proc <= write
+ *
+ * The client writes audio at `write`, the engine processes [proc, write)
+ * in place and the client reads processed audio from [read, proc).
+ * Each position has a single writer, so no locks are required.
+ * Positions are free-running frame counters, the buffer-size is a
+ * power of two.
+ *
+ * Semaphores are only used to wake up the other side.
+ */
+
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define DARC_SHM_VERSION 1
+#define DARC_SHM_NAME "/x42-darc"
+
+typedef struct {
+	char     magic[8]; // "DarcShm"
+	uint32_t version;
+	uint32_t n_channels;
+	uint32_t sample_rate;
+	uint32_t n_frames; // ring-buffer size, power of two
+
+	/* parameters, written by the client (seqlock) */
+	uint32_t   params_seq;
+	DarcParams params;
+
+	/* meters, written by the engine */
+	float    gmin; // dB
+	float    gmax; // dB
+	float    rms;  // dBFS
+	uint32_t running;
+
+	sem_t ready; // client -> engine: audio was written
+	sem_t done;  // engine -> client: audio was processed
+
+	/* ring positions, each in a separate cache-line */
+	uint32_t write __attribute__ ((aligned (64))); // client
+	uint32_t proc __attribute__ ((aligned (64)));  // engine
+	uint32_t read __attribute__ ((aligned (64)));  // client
+} DarcShmHeader;
+
+typedef struct {
+	DarcShmHeader* hdr;
+	float*         data[MAX_CHANNELS];
+	size_t         len;
+	uint32_t       mask;
+} DarcShm;
+
+static inline uint32_t
+shm_load (const uint32_t* p)
+{
+	return __atomic_load_n (p, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+shm_store (uint32_t* p, uint32_t v)
+{
+	__atomic_store_n (p, v, __ATOMIC_RELEASE);
+}
+
+static size_t
+darc_shm_size (uint32_t n_channels, uint32_t n_frames)
+{
+	const size_t hdr = (sizeof (DarcShmHeader) + 63) & ~(size_t)63;
+	return hdr + (size_t)n_channels * n_frames * sizeof (float);
+}
+
+static void
+darc_shm_map_channels (DarcShm* self)
+{
+	float* d = (float*)((char*)self->hdr + ((sizeof (DarcShmHeader) + 63) & ~(size_t)63));
+	for (uint32_t c = 0; c < self->hdr->n_channels; ++c) {
+		self->data[c] = d + (size_t)c * self->hdr->n_frames;
+	}
+	self->mask = self->hdr->n_frames - 1;
+}
+
+/* create and initialize a segment, used by the engine */
+static int
+darc_shm_create (DarcShm* self, const char* name, uint32_t n_channels, uint32_t sample_rate, uint32_t n_frames)
+{
+	memset (self, 0, sizeof (DarcShm));
+
+	if (n_channels < 1 || n_channels > MAX_CHANNELS || n_frames < 2 || (n_frames & (n_frames - 1))) {
+		return -1;
+	}
+
+	int fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		return -1;
+	}
+
+	self->len = darc_shm_size (n_channels, n_frames);
+	if (ftruncate (fd, self->len)) {
+		close (fd);
+		shm_unlink (name);
+		return -1;
+	}
+
+	self->hdr = (DarcShmHeader*)mmap (NULL, self->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if (self->hdr == MAP_FAILED) {
+		self->hdr = NULL;
+		shm_unlink (name);
+		return -1;
+	}
+
+	DarcShmHeader* h = self->hdr;
+	memset (h, 0, sizeof (DarcShmHeader));
+	h->version     = DARC_SHM_VERSION;
+	h->n_channels  = n_channels;
+	h->sample_rate = sample_rate;
+	h->n_frames    = n_frames;
+	h->params      = darc_default_params;
+	h->gmin        = 0;
+	h->gmax        = 0;
+	h->rms         = -100;
+
+	if (sem_init (&h->ready, 1, 0) || sem_init (&h->done, 1, 0)) {
+		munmap (self->hdr, self->len);
+		self->hdr = NULL;
+		shm_unlink (name);
+		return -1;
+	}
+
+	darc_shm_map_channels (self);
+
+	/* publish, a client checks the magic last */
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	memcpy (h->magic, "DarcShm", 8);
+	return 0;
+}
+
+/* attach to an existing segment, used by clients */
+static int
+darc_shm_open (DarcShm* self, const char* name)
+{
+	struct stat st;
+	memset (self, 0, sizeof (DarcShm));
+
+	int fd = shm_open (name, O_RDWR, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat (fd, &st) || (size_t)st.st_size < sizeof (DarcShmHeader)) {
+		close (fd);
+		return -1;
+	}
+
+	self->len = st.st_size;
+	self->hdr = (DarcShmHeader*)mmap (NULL, self->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if (self->hdr == MAP_FAILED) {
+		self->hdr = NULL;
+		return -1;
+	}
+
+	DarcShmHeader* h = self->hdr;
+	if (memcmp (h->magic, "DarcShm", 8)
+	    || h->version != DARC_SHM_VERSION
+	    || h->n_channels < 1 || h->n_channels > MAX_CHANNELS
+	    || darc_shm_size (h->n_channels, h->n_frames) > self->len) {
+		munmap (self->hdr, self->len);
+		self->hdr = NULL;
+		return -1;
+	}
+
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	darc_shm_map_channels (self);
+	return 0;
+}
+
+static void
+darc_shm_close (DarcShm* self)
+{
+	if (self->hdr) {
+		munmap (self->hdr, self->len);
+	}
+	self->hdr = NULL;
+}
+
+/* client: update parameters */
+static void
+darc_shm_set_params (DarcShm* self, const DarcParams* p)
+{
+	DarcShmHeader* h = self->hdr;
+	shm_store (&h->params_seq, h->params_seq + 1);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	h->params = *p;
+	shm_store (&h->params_seq, h->params_seq + 1);
+}
+
+/* engine: read parameters, returns false if unchanged or busy */
+static bool
+darc_shm_get_params (DarcShm* self, uint32_t* seq, DarcParams* p)
+{
+	DarcShmHeader* h  = self->hdr;
+	const uint32_t s1 = shm_load (&h->params_seq);
+	if (s1 == *seq || (s1 & 1)) {
+		return false;
+	}
+	*p = h->params;
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	if (shm_load (&h->params_seq) != s1) {
+		return false;
+	}
+	*seq = s1;
+	return true;
+}
+
+/* sem_wait with a timeout in ms, returns false on timeout or signal */
+static bool
+darc_shm_wait (sem_t* s, int ms)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_REALTIME, &ts);
+	ts.tv_nsec += (long)(ms % 1000) * 1000000;
+	ts.tv_sec += ms / 1000 + ts.tv_nsec / 1000000000;
+	ts.tv_nsec %= 1000000000;
+	return 0 == sem_timedwait (s, &ts);
+}
+
+#endif
@@ -0,0 +1,288 @@
+/* darc.lv2 -- shared memory telemetry
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_TELEMETRY_H
+#define _DARC_TELEMETRY_H
+
+/* A read-only POSIX shared memory segment, published by the JACK clients
+ * without GUI. It holds a header with the DSP load, followed by one
+ * cache-line sized slot per plugin instance (unit) with its meters and
+ * parameters.
+ *
+ * The segment is updated by the control thread of the client, using
+ * values that the process callback writes anyway. Every slot and the
+ * status are protected by a sequence number, which is odd while the
+ * data is being written. Readers copy the data and retry if the sequence
+ * number changed.
+ *
+ * Readers must check magic and version. Fields are only ever appended
+ * to the status and slots, readers use slot_offset and slot_size to
+ * locate the slots.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/darc.h"
+
+#define DARC_TLM_VERSION 1
+#define DARC_TLM_PREFIX "/x42-darc-tlm-"
+
+typedef struct {
+	uint32_t running;    // process callback is active
+	uint32_t xruns;      // reported by JACK
+	uint64_t cycles;     // process callbacks
+	uint64_t frames;     // processed samples
+	uint64_t updated_ns; // CLOCK_REALTIME of the last update
+	float    dsp_load;   // JACK DSP load, percent
+} DarcTlmStatus;
+
+typedef struct {
+	uint32_t instance;        // 1-based
+	uint32_t channels;        // audio channels of this unit
+	float    gmin;            // dB
+	float    gmax;            // dB
+	float    rms;             // dBFS
+	float    ctrl[DARC_GMIN]; // enable .. release
+	float    cycles_spl;      // DSP cycles/sample, only with INSTRUMENT=yes
+	uint32_t resets;          // filter state resets after NaN or inf
+	uint32_t tier;            // DARC_TIER_* selected by the CPU budget governor
+} DarcTlmMeter;
+
+typedef struct {
+	uint32_t     seq;
+	DarcTlmMeter m;
+} __attribute__ ((aligned (64))) DarcTlmSlot;
+
+typedef struct {
+	char     magic[8]; // "DarcTlm"
+	uint32_t version;
+	uint32_t slot_offset; // from the start of the segment
+	uint32_t slot_size;   // stride
+	uint32_t n_slots;
+	uint32_t sample_rate;
+	uint32_t pid;
+	char     client[64]; // JACK client name
+
+	uint32_t      seq;
+	DarcTlmStatus status;
+} DarcTlmHeader;
+
+typedef struct {
+	DarcTlmHeader* hdr;
+	char*          slots;
+	size_t         len;
+} DarcTlm;
+
+#define DARC_TLM_SLOT_OFFSET ((sizeof (DarcTlmHeader) + 63) & ~(size_t)63)
+
+static size_t
+darc_tlm_size (uint32_t n_slots)
+{
+	return DARC_TLM_SLOT_OFFSET + (size_t)n_slots * sizeof (DarcTlmSlot);
+}
+
+/* a segment whose owner is gone, e.g. after a crash */
+static bool
+darc_tlm_stale (const char* name)
+{
+	DarcTlmHeader hdr;
+	bool          stale = false;
+
+	int fd = shm_open (name, O_RDONLY, 0);
+	if (fd < 0) {
+		return false;
+	}
+	if (pread (fd, &hdr, sizeof (hdr), 0) == sizeof (hdr)) {
+		stale = !memcmp (hdr.magic, "DarcTlm", 8) && hdr.pid > 0
+		        && kill ((pid_t)hdr.pid, 0) && errno == ESRCH;
+	}
+	close (fd);
+	return stale;
+}
+
+/* create and initialize a segment, used by the JACK client */
+static int
+darc_tlm_create (DarcTlm* self, const char* name, uint32_t n_slots, uint32_t sample_rate, const char* client)
+{
+	memset (self, 0, sizeof (DarcTlm));
+
+	int fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0 && errno == EEXIST && darc_tlm_stale (name)) {
+		shm_unlink (name);
+		fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	}
+	if (fd < 0) {
+		return -1;
+	}
+
+	self->len = darc_tlm_size (n_slots);
+	if (ftruncate (fd, self->len)) {
+		close (fd);
+		shm_unlink (name);
+		return -1;
+	}
+
+	self->hdr = (DarcTlmHeader*)mmap (NULL, self->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if (self->hdr == MAP_FAILED) {
+		self->hdr = NULL;
+		shm_unlink (name);
+		return -1;
+	}
+
+	DarcTlmHeader* h = self->hdr;
+	h->version       = DARC_TLM_VERSION;
+	h->slot_offset   = DARC_TLM_SLOT_OFFSET;
+	h->slot_size     = sizeof (DarcTlmSlot);
+	h->n_slots       = n_slots;
+	h->sample_rate   = sample_rate;
+	h->pid           = getpid ();
+	strncpy (h->client, client, sizeof (h->client) - 1);
+
+	self->slots = (char*)h + h->slot_offset;
+
+	/* publish, a reader checks the magic first */
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	memcpy (h->magic, "DarcTlm", 8);
+	return 0;
+}
+
+/* attach to an existing segment, read-only */
+static int
+darc_tlm_open (DarcTlm* self, const char* name)
+{
+	struct stat st;
+	memset (self, 0, sizeof (DarcTlm));
+
+	int fd = shm_open (name, O_RDONLY, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat (fd, &st) || (size_t)st.st_size < sizeof (DarcTlmHeader)) {
+		close (fd);
+		return -1;
+	}
+
+	self->len = st.st_size;
+	self->hdr = (DarcTlmHeader*)mmap (NULL, self->len, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if (self->hdr == MAP_FAILED) {
+		self->hdr = NULL;
+		return -1;
+	}
+
+	const DarcTlmHeader* h = self->hdr;
+	if (memcmp (h->magic, "DarcTlm", 8)
+	    || h->version != DARC_TLM_VERSION
+	    || h->slot_offset < sizeof (DarcTlmHeader)
+	    || h->slot_size < sizeof (DarcTlmSlot)
+	    || h->slot_offset + (size_t)h->n_slots * h->slot_size > self->len) {
+		munmap (self->hdr, self->len);
+		self->hdr = NULL;
+		return -1;
+	}
+
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	self->slots = (char*)h + h->slot_offset;
+	return 0;
+}
+
+static void
+darc_tlm_close (DarcTlm* self)
+{
+	if (self->hdr) {
+		munmap (self->hdr, self->len);
+	}
+	self->hdr = NULL;
+}
+
+static inline DarcTlmSlot*
+darc_tlm_slot (const DarcTlm* self, uint32_t i)
+{
+	return (DarcTlmSlot*)(self->slots + (size_t)i * self->hdr->slot_size);
+}
+
+/* seqlock, single writer */
+static inline void
+darc_tlm_seq_write (uint32_t* seq, void* dst, const void* src, size_t len)
+{
+	__atomic_store_n (seq, *seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	memcpy (dst, src, len);
+	__atomic_store_n (seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/* returns false if the data was modified while reading */
+static inline bool
+darc_tlm_seq_read (const uint32_t* seq, void* dst, const void* src, size_t len)
+{
+	for (int i = 0; i < 100; ++i) {
+		const uint32_t s1 = __atomic_load_n (seq, __ATOMIC_ACQUIRE);
+		if (s1 & 1) {
+			continue;
+		}
+		memcpy (dst, src, len);
+		__atomic_thread_fence (__ATOMIC_ACQUIRE);
+		if (__atomic_load_n (seq, __ATOMIC_RELAXED) == s1) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+darc_tlm_set_status (DarcTlm* self, DarcTlmStatus* s)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_REALTIME, &ts);
+	s->updated_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	darc_tlm_seq_write (&self->hdr->seq, &self->hdr->status, s, sizeof (DarcTlmStatus));
+}
+
+static void
+darc_tlm_set_meter (DarcTlm* self, uint32_t i, const DarcTlmMeter* m)
+{
+	DarcTlmSlot* s = darc_tlm_slot (self, i);
+	darc_tlm_seq_write (&s->seq, &s->m, m, sizeof (DarcTlmMeter));
+}
+
+static bool
+darc_tlm_get_status (const DarcTlm* self, DarcTlmStatus* s)
+{
+	return darc_tlm_seq_read (&self->hdr->seq, s, &self->hdr->status, sizeof (DarcTlmStatus));
+}
+
+static bool
+darc_tlm_get_meter (const DarcTlm* self, uint32_t i, DarcTlmMeter* m)
+{
+	const DarcTlmSlot* s = darc_tlm_slot (self, i);
+	return darc_tlm_seq_read (&s->seq, m, &s->m, sizeof (DarcTlmMeter));
+}
+
+#endif
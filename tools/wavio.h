@@ -0,0 +1,396 @@
+/* darc.lv2 -- minimal RIFF/WAVE and raw PCM I/O for the standalone tools
+ *
+ * Copyright (C) 2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DARC_WAVIO_H
+#define _DARC_WAVIO_H
+
+/* Only little-endian hosts are supported. The reader does not require
+ * a seekable file, so that it can be used with pipes (stdin/stdout).
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef enum {
+	WAV_INT16 = 0,
+	WAV_INT24,
+	WAV_INT32,
+	WAV_FLOAT32,
+} WavFormat;
+
+#define WAV_CHUNK 4096 // bytes, conversion buffer
+
+typedef struct {
+	FILE*     f;
+	WavFormat fmt;
+	uint32_t  rate;
+	uint32_t  n_channels;
+	uint32_t  bps;      // bytes per sample
+	uint64_t  n_frames; // 0: unknown (stream)
+	uint64_t  pos;      // current frame
+	long      data_off; // -1: not seekable
+	bool      riff;     // false: raw PCM
+	bool      writing;
+
+	uint8_t buf[WAV_CHUNK];
+} WavFile;
+
+static uint32_t
+wav_bps (WavFormat fmt)
+{
+	switch (fmt) {
+		case WAV_INT16:
+			return 2;
+		case WAV_INT24:
+			return 3;
+		default:
+			break;
+	}
+	return 4;
+}
+
+static bool
+wav_parse_format (const char* str, WavFormat* fmt)
+{
+	if (!strcmp (str, "16")) {
+		*fmt = WAV_INT16;
+	} else if (!strcmp (str, "24")) {
+		*fmt = WAV_INT24;
+	} else if (!strcmp (str, "32")) {
+		*fmt = WAV_INT32;
+	} else if (!strcmp (str, "float")) {
+		*fmt = WAV_FLOAT32;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static uint32_t
+wav_u32 (const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t
+wav_u16 (const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static void
+wav_put32 (uint8_t* p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void
+wav_put16 (uint8_t* p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static bool
+wav_skip (FILE* f, uint32_t len)
+{
+	uint8_t tmp[256];
+	while (len > 0) {
+		size_t n = len > sizeof (tmp) ? sizeof (tmp) : len;
+		if (fread (tmp, 1, n, f) != n) {
+			return false;
+		}
+		len -= n;
+	}
+	return true;
+}
+
+static void
+wav_open_raw (WavFile* self, FILE* f, uint32_t rate, uint32_t n_channels, WavFormat fmt, bool writing)
+{
+	memset (self, 0, sizeof (WavFile));
+	self->f          = f;
+	self->fmt        = fmt;
+	self->rate       = rate;
+	self->n_channels = n_channels;
+	self->bps        = wav_bps (fmt);
+	self->riff       = false;
+	self->writing    = writing;
+	self->data_off   = -1;
+}
+
+static int
+wav_open_read (WavFile* self, FILE* f)
+{
+	uint8_t  hdr[40];
+	uint32_t fmt_tag = 0;
+	uint32_t bits    = 0;
+
+	memset (self, 0, sizeof (WavFile));
+	self->f        = f;
+	self->riff     = true;
+	self->data_off = -1;
+
+	if (fread (hdr, 1, 12, f) != 12 || memcmp (hdr, "RIFF", 4) || memcmp (hdr + 8, "WAVE", 4)) {
+		return -1;
+	}
+
+	for (;;) {
+		if (fread (hdr, 1, 8, f) != 8) {
+			return -1;
+		}
+		uint32_t len = wav_u32 (hdr + 4);
+		if (!memcmp (hdr, "fmt ", 4)) {
+			if (len < 16 || len > sizeof (hdr)) {
+				return -1;
+			}
+			if (fread (hdr, 1, len, f) != len) {
+				return -1;
+			}
+			fmt_tag          = wav_u16 (hdr);
+			self->n_channels = wav_u16 (hdr + 2);
+			self->rate       = wav_u32 (hdr + 4);
+			bits             = wav_u16 (hdr + 14);
+			if (fmt_tag == 0xfffe && len >= 26) {
+				/* WAVE_FORMAT_EXTENSIBLE, sub-format GUID */
+				fmt_tag = wav_u16 (hdr + 24);
+			}
+			if (len & 1) {
+				wav_skip (f, 1);
+			}
+		} else if (!memcmp (hdr, "data", 4)) {
+			if (self->n_channels == 0) {
+				return -1;
+			}
+			if (fmt_tag == 1 && bits == 16) {
+				self->fmt = WAV_INT16;
+			} else if (fmt_tag == 1 && bits == 24) {
+				self->fmt = WAV_INT24;
+			} else if (fmt_tag == 1 && bits == 32) {
+				self->fmt = WAV_INT32;
+			} else if (fmt_tag == 3 && bits == 32) {
+				self->fmt = WAV_FLOAT32;
+			} else {
+				return -1;
+			}
+			self->bps = wav_bps (self->fmt);
+			if (len != 0 && len != 0xffffffff) {
+				self->n_frames = len / (self->bps * self->n_channels);
+			}
+			self->data_off = ftell (f);
+			return 0;
+		} else {
+			if (!wav_skip (f, len + (len & 1))) {
+				return -1;
+			}
+		}
+	}
+}
+
+static void
+wav_write_header (WavFile* self, uint64_t n_frames)
+{
+	uint8_t  hdr[44];
+	uint64_t len = n_frames * self->bps * self->n_channels;
+	if (len == 0 || len > 0xffffffd0) {
+		len = 0xffffffd0; // unknown length, streaming
+	}
+	memcpy (hdr, "RIFF", 4);
+	wav_put32 (hdr + 4, len + 36);
+	memcpy (hdr + 8, "WAVEfmt ", 8);
+	wav_put32 (hdr + 16, 16);
+	wav_put16 (hdr + 20, self->fmt == WAV_FLOAT32 ? 3 : 1);
+	wav_put16 (hdr + 22, self->n_channels);
+	wav_put32 (hdr + 24, self->rate);
+	wav_put32 (hdr + 28, self->rate * self->bps * self->n_channels);
+	wav_put16 (hdr + 32, self->bps * self->n_channels);
+	wav_put16 (hdr + 34, 8 * self->bps);
+	memcpy (hdr + 36, "data", 4);
+	wav_put32 (hdr + 40, len);
+	fwrite (hdr, 1, 44, self->f);
+}
+
+static int
+wav_open_write (WavFile* self, FILE* f, uint32_t rate, uint32_t n_channels, WavFormat fmt)
+{
+	wav_open_raw (self, f, rate, n_channels, fmt, true);
+	self->riff = true;
+	wav_write_header (self, 0);
+	self->data_off = ftell (f);
+	return ferror (f) ? -1 : 0;
+}
+
+/* read up to n_frames interleaved frames, converted to float.
+ * returns the number of frames read, 0 at end of file.
+ */
+static size_t
+wav_read (WavFile* self, float* out, size_t n_frames)
+{
+	const uint32_t frame_bytes = self->bps * self->n_channels;
+	const size_t   chunk       = WAV_CHUNK / frame_bytes;
+	size_t         done        = 0;
+
+	if (self->n_frames > 0 && self->pos + n_frames > self->n_frames) {
+		n_frames = self->n_frames - self->pos;
+	}
+
+	while (done < n_frames) {
+		size_t n = n_frames - done;
+		if (n > chunk) {
+			n = chunk;
+		}
+		n = fread (self->buf, frame_bytes, n, self->f);
+		if (n == 0) {
+			break;
+		}
+
+		const size_t   ns = n * self->n_channels;
+		const uint8_t* p  = self->buf;
+		float*         o  = &out[done * self->n_channels];
+
+		switch (self->fmt) {
+			case WAV_INT16:
+				for (size_t i = 0; i < ns; ++i, p += 2) {
+					o[i] = (int16_t)wav_u16 (p) / 32768.f;
+				}
+				break;
+			case WAV_INT24:
+				for (size_t i = 0; i < ns; ++i, p += 3) {
+					o[i] = (int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.f;
+				}
+				break;
+			case WAV_INT32:
+				for (size_t i = 0; i < ns; ++i, p += 4) {
+					o[i] = (int32_t)wav_u32 (p) / 2147483648.f;
+				}
+				break;
+			case WAV_FLOAT32:
+				memcpy (o, p, ns * sizeof (float));
+				break;
+		}
+		done += n;
+		self->pos += n;
+	}
+	return done;
+}
+
+static inline int32_t
+wav_clip (float v, float scale, float lim)
+{
+	v *= scale;
+	if (v > lim) {
+		return (int32_t)lim;
+	}
+	if (v < -lim - 1.f) {
+		return (int32_t)(-lim - 1.f);
+	}
+	return (int32_t)lrintf (v);
+}
+
+static size_t
+wav_write (WavFile* self, const float* in, size_t n_frames)
+{
+	const uint32_t frame_bytes = self->bps * self->n_channels;
+	const size_t   chunk       = WAV_CHUNK / frame_bytes;
+	size_t         done        = 0;
+
+	while (done < n_frames) {
+		size_t n = n_frames - done;
+		if (n > chunk) {
+			n = chunk;
+		}
+
+		const size_t ns = n * self->n_channels;
+		uint8_t*     p  = self->buf;
+		const float* s  = &in[done * self->n_channels];
+
+		switch (self->fmt) {
+			case WAV_INT16:
+				for (size_t i = 0; i < ns; ++i, p += 2) {
+					wav_put16 (p, wav_clip (s[i], 32768.f, 32767.f));
+				}
+				break;
+			case WAV_INT24:
+				for (size_t i = 0; i < ns; ++i, p += 3) {
+					int32_t v = wav_clip (s[i], 8388608.f, 8388607.f);
+					p[0]      = v;
+					p[1]      = v >> 8;
+					p[2]      = v >> 16;
+				}
+				break;
+			case WAV_INT32:
+				for (size_t i = 0; i < ns; ++i, p += 4) {
+					/* float cannot represent INT32_MAX, clip just below */
+					wav_put32 (p, wav_clip (s[i], 2147483648.f, 2147483520.f));
+				}
+				break;
+			case WAV_FLOAT32:
+				memcpy (p, s, ns * sizeof (float));
+				break;
+		}
+		if (fwrite (self->buf, frame_bytes, n, self->f) != n) {
+			break;
+		}
+		done += n;
+		self->pos += n;
+	}
+	return done;
+}
+
+/* seek to given frame, only for seekable files */
+static int
+wav_seek (WavFile* self, uint64_t frame)
+{
+	if (self->data_off < 0 || (self->n_frames > 0 && frame > self->n_frames)) {
+		return -1;
+	}
+	if (fseek (self->f, self->data_off + frame * self->bps * self->n_channels, SEEK_SET)) {
+		return -1;
+	}
+	self->pos = frame;
+	return 0;
+}
+
+/* finalize the header (if the file is seekable) and close,
+ * returns -1 if any write or the close failed */
+static int
+wav_close (WavFile* self)
+{
+	if (!self->f) {
+		return 0;
+	}
+	if (self->writing && self->riff && self->data_off > 0 && 0 == fseek (self->f, 0, SEEK_SET)) {
+		wav_write_header (self, self->pos);
+	}
+	int rv = ferror (self->f) ? -1 : 0;
+	if (self->f != stdin && self->f != stdout) {
+		rv |= fclose (self->f) ? -1 : 0;
+	} else {
+		rv |= fflush (self->f) ? -1 : 0;
+	}
+	self->f = NULL;
+	return rv;
+}
+
+#endif